@@ -0,0 +1,234 @@
+import argparse
+import random
+from sys import stdout
+
+# Generates well typed .lang programs of a given size, for the
+# benchmarks. The classes form chains of subclasses, the given
+# inheritance depth long, and their methods use the members and
+# call the methods of their superclasses, so name lookups walk the
+# chains. Programs always terminate: loops count up to a constant,
+# calls only go to methods generated before the caller, and a
+# method makes at most one call outside of its loops and branches.
+# The same parameters and seed always give the same program.
+
+class Generator():
+    def __init__(self, classes, depth, methods, statements, nesting, seed):
+        self.classes = classes
+        self.depth = max(1, depth)
+        self.methods = methods
+        self.statements = statements
+        self.nesting = nesting
+        self.random = random.Random(seed)
+        self.lines = []
+
+    def line(self, indent, text):
+        self.lines.append("    " * indent + text)
+
+    def superclass(self, i):
+        return i - 1 if i % self.depth else None
+
+    # Returns the classes whose members and methods class i sees,
+    # itself first.
+    def ancestors(self, i):
+        chain = [i]
+        while self.superclass(chain[-1]) is not None:
+            chain.append(self.superclass(chain[-1]))
+        return chain
+
+    def integerExpression(self, depth):
+        r = self.random.random()
+        if depth <= 0 or r < 0.3:
+            return self.integerLeaf()
+        if r < 0.4:
+            return "-" + self.integerExpression(depth - 1)
+        if r < 0.5:
+            return "(" + self.integerExpression(depth - 1) + ") / " + \
+                str(self.random.randint(1, 9))
+        if r < 0.6 and self.call:
+            return self.callExpression(depth)
+        op = self.random.choice(["+", "-", "*", "+", "-"])
+        return "(" + self.integerExpression(depth - 1) + " " + op + " " + \
+            self.integerExpression(depth - 1) + ")"
+
+    def integerLeaf(self):
+        r = self.random.random()
+        if r < 0.3:
+            return str(self.random.randint(0, 999))
+        if r < 0.45:
+            return "p"
+        if r < 0.75:
+            return "t" + str(self.random.randrange(3))
+        owner = self.random.choice(self.ancestors(self.current))
+        return "x" + str(owner)
+
+    def booleanExpression(self, depth):
+        r = self.random.random()
+        if depth <= 0 or r < 0.2:
+            return self.random.choice(["true", "false", "q", "u0", "u1",
+                "y" + str(self.random.choice(self.ancestors(self.current)))])
+        if r < 0.6:
+            op = self.random.choice([">", ">=", "equals"])
+            return self.integerExpression(depth - 1) + " " + op + " " + \
+                self.integerExpression(depth - 1)
+        if r < 0.7:
+            return "not (" + self.booleanExpression(depth - 1) + ")"
+        op = self.random.choice(["and", "or"])
+        return "(" + self.booleanExpression(depth - 1) + " " + op + " " + \
+            self.booleanExpression(depth - 1) + ")"
+
+    # Calls a method of class current or one of its superclasses
+    # that was generated before the method being generated.
+    def callExpression(self, depth):
+        self.call = False
+        self.called = True
+        owner = self.random.choice(self.callable)
+        return owner + "(" + self.integerExpression(depth - 1) + ", " + \
+            self.booleanExpression(depth - 1) + ")"
+
+    # Adds statements at the given indent until the budget is spent.
+    # Loops and branches get part of the budget for their bodies.
+    def block(self, indent, budget, nested):
+        while budget > 0:
+            r = self.random.random()
+            budget -= 1
+            self.call = not nested and not self.called and bool(self.callable)
+            if r < 0.1 and nested < 2 and budget > 1:
+                inner = self.random.randint(1, budget)
+                budget -= inner
+                self.statementLoop(indent, inner, nested)
+            elif r < 0.25 and nested < 2 and budget > 1:
+                inner = self.random.randint(1, budget)
+                budget -= inner
+                self.line(indent, "if " + self.booleanExpression(self.nesting) + " {")
+                self.block(indent + 1, (inner + 1) // 2, nested + 1)
+                if inner > 1:
+                    self.line(indent, "} else {")
+                    self.block(indent + 1, inner // 2, nested + 1)
+                self.line(indent, "}")
+            elif r < 0.3 and not nested:
+                self.line(indent, "print " + self.integerExpression(self.nesting) + ";")
+            elif r < 0.45:
+                self.line(indent, "u" + str(self.random.randrange(2)) + " = " +
+                          self.booleanExpression(self.nesting) + ";")
+            elif r < 0.6:
+                owner = self.random.choice(self.ancestors(self.current))
+                self.line(indent, "x" + str(owner) + " = " +
+                          self.integerExpression(self.nesting) + ";")
+            else:
+                self.line(indent, "t" + str(self.random.randrange(3)) + " = " +
+                          self.integerExpression(self.nesting) + ";")
+
+    def statementLoop(self, indent, budget, nested):
+        counter = "w" + str(self.loops)
+        self.loops += 1
+        self.line(indent, counter + " = 0;")
+        limit = str(self.random.randint(1, 4))
+        if self.random.random() < 0.5:
+            self.line(indent, "while " + limit + " > " + counter + " {")
+            self.block(indent + 1, budget, nested + 1)
+            self.line(indent + 1, counter + " = " + counter + " + 1;")
+            self.line(indent, "}")
+        else:
+            self.line(indent, "do {")
+            self.block(indent + 1, budget, nested + 1)
+            self.line(indent + 1, counter + " = " + counter + " + 1;")
+            self.line(indent, "} while (" + limit + " > " + counter + ");")
+
+    def method(self, name):
+        self.loops = 0
+        self.called = False
+        start = len(self.lines)
+        self.line(2, "t0 = p;")
+        self.line(2, "t1 = p + 1;")
+        self.line(2, "t2 = 0;")
+        self.line(2, "u0 = q;")
+        self.line(2, "u1 = not q;")
+        self.block(2, self.statements, 0)
+        self.call = False
+        self.line(2, "return " + self.integerExpression(self.nesting) + ";")
+        body = self.lines[start:]
+        del self.lines[start:]
+
+        self.line(1, name + "(integer p, boolean q) -> integer {")
+        self.line(2, "integer t0, t1, t2;")
+        self.line(2, "boolean u0, u1;")
+        if self.loops:
+            self.line(2, "integer " + ", ".join("w" + str(i) for i in range(self.loops)) + ";")
+        self.lines.extend(body)
+        self.line(1, "}")
+        self.line(0, "")
+
+    def generateClass(self, i):
+        superclass = self.superclass(i)
+        if superclass is None:
+            self.line(0, "C" + str(i) + " {")
+        else:
+            self.line(0, "C" + str(i) + " extends C" + str(superclass) + " {")
+        self.line(1, "integer x" + str(i) + ";")
+        self.line(1, "boolean y" + str(i) + ";")
+        self.line(0, "")
+
+        # The constructor sets the members of the whole chain, as
+        # new does not call the constructors of superclasses.
+        self.line(1, "C" + str(i) + "() -> none {")
+        for owner in reversed(self.ancestors(i)):
+            self.line(2, "x" + str(owner) + " = " + str(owner) + ";")
+            self.line(2, "y" + str(owner) + " = true;")
+        self.line(1, "}")
+        self.line(0, "")
+
+        self.current = i
+        self.callable = [name for owner in self.ancestors(i)[1:]
+                         for name in self.names[owner]]
+        for j in range(self.methods):
+            name = "c" + str(i) + "m" + str(j)
+            self.method(name)
+            self.callable.append(name)
+        self.line(0, "}")
+        self.line(0, "")
+
+    def generate(self):
+        self.names = [["c" + str(i) + "m" + str(j) for j in range(self.methods)]
+                      for i in range(self.classes)]
+        for i in range(self.classes):
+            self.generateClass(i)
+
+        # Main calls the last method of the last class of each chain.
+        self.line(0, "Main {")
+        self.line(1, "main() -> none {")
+        leaves = [i for i in range(self.classes)
+                  if i + 1 == self.classes or self.superclass(i + 1) is None]
+        if leaves and self.methods:
+            for i in leaves:
+                self.line(2, "C" + str(i) + " v" + str(i) + ";")
+            for i in leaves:
+                self.line(2, "v" + str(i) + " = new C" + str(i) + "();")
+                self.line(2, "print v" + str(i) + ".c" + str(i) + "m" +
+                          str(self.methods - 1) + "(" + str(i) + ", true);")
+        else:
+            self.line(2, "print 0;")
+        self.line(1, "}")
+        self.line(0, "}")
+        return "\n".join(self.lines) + "\n"
+
+def generate(classes=10, depth=3, methods=4, statements=10, nesting=3, seed=0):
+    return Generator(classes, depth, methods, statements, nesting, seed).generate()
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Generate a .lang program")
+    parser.add_argument("--classes", type=int, default=10)
+    parser.add_argument("--depth", type=int, default=3, help="inheritance depth")
+    parser.add_argument("--methods", type=int, default=4, help="methods per class")
+    parser.add_argument("--statements", type=int, default=10, help="statements per method")
+    parser.add_argument("--nesting", type=int, default=3, help="expression nesting depth")
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("-o", "--output", help="output file (default stdout)")
+    args = parser.parse_args()
+
+    program = generate(args.classes, args.depth, args.methods, args.statements,
+                       args.nesting, args.seed)
+    if args.output:
+        with open(args.output, "w") as file:
+            file.write(program)
+    else:
+        stdout.write(program)
@@ -0,0 +1,197 @@
+import argparse
+import hashlib
+import os
+import shutil
+import tempfile
+import time
+from statistics import median
+from subprocess import Popen, PIPE, DEVNULL, call
+from sys import platform, stderr
+
+# Measures how fast the code the compiler generates runs, on the
+# programs in bench/programs:
+#
+#   python3 bench/runtime.py [--runs 5] [--levels -O0,-O2] [--save]
+#
+# Each program is compiled at every optimization level, linked with
+# tester.c and run --runs times. The median wall time, the
+# instructions executed and the peak RSS are compared against the
+# baseline file: more instructions (by over 1%) or a larger peak RSS
+# (by over the tolerance) than the baseline is reported as a
+# regression. Wall times vary too much from run to run and machine
+# to machine to fail on, so a slower time is only marked, unless
+# --gate-time is given. The output must be the same at every level.
+# --save writes the results as the new baseline; its times only mean
+# something on the machine they were measured on.
+#
+# Instructions are those retired as counted by perf, when it is
+# installed, or else those simulated by langsim (make langsim), which
+# are exact and the same on every machine.
+#
+# The peak RSS is what the kernel reports for the program, which on
+# Linux includes what this script had when it started the program,
+# so it is never less than that.
+
+benchdir = os.path.dirname(os.path.abspath(__file__))
+projectdir = os.path.dirname(benchdir)
+
+def link(command, exe, asm):
+    if command:
+        return call(command.format(exe=exe, asm=asm), shell=True)
+    flags = ["-Wl,-no_pie"] if platform == "darwin" else []
+    return call(["gcc", "-m32"] + flags + ["-o", exe,
+                os.path.join(projectdir, "tester.c"), asm])
+
+# Runs a program once, with its output going to a file, and returns
+# the wall time in seconds and the peak RSS in kilobytes.
+def runOnce(exe, output):
+    with open(output, "w") as outfile:
+        start = time.perf_counter()
+        p = Popen([exe], stdout=outfile)
+        (pid, status, usage) = os.wait4(p.pid, 0)
+        elapsed = time.perf_counter() - start
+        p.returncode = os.waitstatus_to_exitcode(status)
+    if p.returncode != 0:
+        print(exe + " exited with " + str(p.returncode), file=stderr)
+        exit(1)
+    # ru_maxrss is in bytes on macOS.
+    rss = usage.ru_maxrss // 1024 if platform == "darwin" else usage.ru_maxrss
+    return elapsed, rss
+
+# Hashes the output rather than reading it whole, which would add to
+# the peak RSS of the next programs (see above).
+def fileHash(name):
+    digest = hashlib.sha1()
+    with open(name, "rb") as file:
+        for block in iter(lambda: file.read(1 << 16), b""):
+            digest.update(block)
+    return digest.hexdigest()
+
+# Returns the user-space instructions retired by one run, or None
+# without perf.
+def countInstructions(exe):
+    p = Popen(["perf", "stat", "-x,", "-e", "instructions:u", exe],
+              stdout=DEVNULL, stderr=PIPE)
+    (out, err) = p.communicate()
+    for line in err.decode("utf-8").splitlines():
+        fields = line.split(",")
+        if len(fields) > 2 and fields[2].startswith("instructions") and fields[0].isdigit():
+            return int(fields[0])
+    return None
+
+# Returns the instructions langsim executes for the assembly.
+def simulateInstructions(langsim, asm):
+    p = Popen([langsim, "--quiet", asm], stdout=DEVNULL, stderr=PIPE)
+    (out, err) = p.communicate()
+    for line in err.decode("utf-8").splitlines():
+        if line.startswith("Instructions:"):
+            return int(line.split()[1])
+    print(err.decode("utf-8"), file=stderr)
+    return None
+
+def readBaseline(name):
+    baseline = {}
+    if os.path.isfile(name):
+        for line in open(name):
+            fields = line.split()
+            if len(fields) == 5 and fields[0][0] != "#":
+                baseline[(fields[0], fields[1])] = \
+                    [None if field == "-" else float(field) for field in fields[2:]]
+    return baseline
+
+def main():
+    parser = argparse.ArgumentParser(description="Generated code benchmark")
+    parser.add_argument("--lang", default=os.path.join(projectdir, "lang"))
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--levels", default="-O0,-O1,-O2,-Os",
+                        help="comma separated compiler flags to compare")
+    parser.add_argument("--langsim", default=os.path.join(projectdir, "langsim"))
+    parser.add_argument("--link", help="link command, with {exe} and {asm} "
+                        "standing for the program and the assembly")
+    parser.add_argument("--baseline", default=os.path.join(benchdir, "runtime.baseline"))
+    parser.add_argument("--tolerance", type=float, default=0.25,
+                        help="allowed slowdown, as a fraction of the baseline")
+    parser.add_argument("--gate-time", action="store_true",
+                        help="report a slower time as a regression too")
+    parser.add_argument("--save", action="store_true", help="save the results as the baseline")
+    parser.add_argument("programs", nargs="*", help="programs to run (default all)")
+    args = parser.parse_args()
+
+    programs = args.programs or sorted(
+        os.path.join(benchdir, "programs", f)
+        for f in os.listdir(os.path.join(benchdir, "programs")) if f.endswith(".lang"))
+    baseline = readBaseline(args.baseline)
+    results = []
+    regressions = 0
+
+    print("%-12s %-12s %12s %14s %10s" % ("program", "level", "median ms",
+          "instructions", "peak KB"))
+    with tempfile.TemporaryDirectory() as directory:
+        for program in programs:
+            name = os.path.basename(program)[:-5]
+            expected = None
+            for level in args.levels.split(","):
+                asm = os.path.join(directory, name + ".s")
+                exe = os.path.join(directory, name)
+                with open(program) as infile, open(asm, "w") as outfile:
+                    if call([args.lang] + level.split(), stdin=infile, stdout=outfile) != 0:
+                        print(name + " did not compile with " + level, file=stderr)
+                        exit(1)
+                if link(args.link, exe, asm) != 0:
+                    print(name + " did not link", file=stderr)
+                    exit(1)
+
+                output = os.path.join(directory, name + ".out")
+                times = []
+                rss = 0
+                for i in range(args.runs):
+                    (seconds, runRss) = runOnce(exe, output)
+                    times.append(seconds)
+                    rss = max(rss, runRss)
+                milliseconds = 1000 * median(times)
+                if shutil.which("perf"):
+                    instructions = countInstructions(exe)
+                elif os.path.isfile(args.langsim):
+                    instructions = simulateInstructions(args.langsim, asm)
+                else:
+                    instructions = None
+
+                text = fileHash(output)
+                if expected is None:
+                    expected = text
+                elif text != expected:
+                    print(name + " prints something else with " + level, file=stderr)
+                    regressions += 1
+
+                old = baseline.get((name, level), [None, None, None])
+                flags = []
+                slower = old[0] and milliseconds > old[0] * (1 + args.tolerance)
+                if slower and args.gate_time:
+                    flags.append("time")
+                if old[1] and instructions and instructions > old[1] * 1.01:
+                    flags.append("instructions")
+                if old[2] and rss > old[2] * (1 + args.tolerance):
+                    flags.append("rss")
+                regressions += len(flags)
+                print("%-12s %-12s %12.1f %14s %10d%s" % (name, level, milliseconds,
+                      instructions if instructions else "-", rss,
+                      "  REGRESSION (" + ", ".join(flags) + ")" if flags else
+                      "  slower" if slower else ""))
+                if old[0]:
+                    print("%-12s %-12s %12.1f %14s %10d" % ("", "  baseline", old[0],
+                          "%.0f" % old[1] if old[1] else "-", old[2] or 0))
+                results.append((name, level, milliseconds, instructions, rss))
+
+    if args.save:
+        with open(args.baseline, "w") as file:
+            file.write("# program level median-ms instructions peak-KB\n")
+            for (name, level, milliseconds, instructions, rss) in results:
+                file.write("%s %s %.1f %s %d\n" % (name, level, milliseconds,
+                           instructions if instructions else "-", rss))
+        print("Saved " + args.baseline)
+    if regressions:
+        print(str(regressions) + " regressions")
+        exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,132 @@
+import argparse
+import os
+import re
+import tempfile
+from statistics import median
+from subprocess import Popen, PIPE, DEVNULL
+from sys import stderr
+
+from genlang import generate
+
+# Measures how fast the compiler gets through generated programs of
+# several sizes, phase by phase, from the output of --time-report:
+#
+#   python3 bench/throughput.py [--runs 5] [--save]
+#
+# Each program is compiled --runs times and the median time of each
+# phase is reported in source lines per second, with the peak RSS.
+# The results are compared against the baseline file, and a phase
+# slower (or a peak RSS larger) than the baseline by more than the
+# tolerance is reported as a regression, unless it took under 5 ms.
+# --save writes the results as the new baseline. Baselines only mean
+# something on the machine they were measured on.
+
+benchdir = os.path.dirname(os.path.abspath(__file__))
+
+# Name: classes, inheritance depth, methods per class, statements per
+# method, expression nesting depth.
+programs = [
+    ("small", 20, 2, 5, 10, 3),
+    ("medium", 100, 4, 10, 20, 4),
+    ("large", 400, 4, 10, 30, 4),
+    ("deep", 200, 50, 4, 10, 3),
+    ("nested", 50, 2, 4, 10, 8),
+]
+
+# Phases faster than this are too noisy to compare.
+minimumSeconds = 0.005
+
+# Reads the phase times and the peak RSS from a --time-report.
+def readReport(report):
+    times = {}
+    rss = None
+    for line in report.splitlines():
+        fields = line.split()
+        if len(fields) == 4 and re.match(r"^\d+\.\d+$", fields[1]):
+            times[fields[0]] = float(fields[1])
+        elif line.startswith("Peak RSS:"):
+            rss = int(fields[2])
+    return times, rss
+
+def measure(lang, flags, source, runs):
+    times = {}
+    rss = []
+    for i in range(runs):
+        with open(source) as infile:
+            p = Popen([lang, "--time-report"] + flags, stdin=infile,
+                      stdout=DEVNULL, stderr=PIPE)
+            (out, err) = p.communicate()
+        if p.returncode != 0:
+            print(source + " did not compile:", file=stderr)
+            print(err.decode("utf-8"), file=stderr)
+            exit(1)
+        runTimes, runRss = readReport(err.decode("utf-8"))
+        for phase, seconds in runTimes.items():
+            times.setdefault(phase, []).append(seconds)
+        rss.append(runRss)
+    return {phase: median(seconds) for phase, seconds in times.items()}, max(rss)
+
+def readBaseline(name):
+    baseline = {}
+    if os.path.isfile(name):
+        for line in open(name):
+            fields = line.split()
+            if len(fields) == 3 and fields[0][0] != "#":
+                baseline[(fields[0], fields[1])] = float(fields[2])
+    return baseline
+
+def main():
+    parser = argparse.ArgumentParser(description="Compiler throughput benchmark")
+    parser.add_argument("--lang", default=os.path.join(benchdir, "..", "lang"))
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--flags", default="", help="compiler flags, e.g. -O2")
+    parser.add_argument("--baseline", default=os.path.join(benchdir, "throughput.baseline"))
+    parser.add_argument("--tolerance", type=float, default=0.25,
+                        help="allowed slowdown, as a fraction of the baseline")
+    parser.add_argument("--save", action="store_true", help="save the results as the baseline")
+    args = parser.parse_args()
+
+    baseline = readBaseline(args.baseline)
+    results = []
+    regressions = 0
+    with tempfile.TemporaryDirectory() as directory:
+        for (name, classes, depth, methods, statements, nesting) in programs:
+            source = os.path.join(directory, name + ".lang")
+            program = generate(classes, depth, methods, statements, nesting)
+            with open(source, "w") as file:
+                file.write(program)
+            lines = program.count("\n")
+
+            times, rss = measure(args.lang, args.flags.split(), source, args.runs)
+            print(name + ": " + str(lines) + " lines, peak RSS " + str(rss) + " KB")
+            print("  %-12s %14s %14s" % ("phase", "lines/second", "baseline"))
+            for phase, seconds in times.items():
+                speed = lines / seconds if seconds > 0 else 0
+                results.append((name, phase, speed))
+                old = baseline.get((name, phase))
+                flag = ""
+                if old and seconds >= minimumSeconds and \
+                        speed < old * (1 - args.tolerance):
+                    flag = "  REGRESSION"
+                    regressions += 1
+                print("  %-12s %14.0f %14s%s" % (phase, speed,
+                      "%.0f" % old if old else "-", flag))
+            results.append((name, "rss", rss))
+            old = baseline.get((name, "rss"))
+            if old and rss > old * (1 + args.tolerance):
+                print("  peak RSS grew from %.0f KB  REGRESSION" % old)
+                regressions += 1
+            print()
+
+    if args.save:
+        with open(args.baseline, "w") as file:
+            file.write("# program phase lines/second (rss: peak KB)\n")
+            for (name, phase, value) in results:
+                file.write("%s %s %.0f\n" % (name, phase, value))
+        print("Saved " + args.baseline)
+    if regressions:
+        print(str(regressions) + " regressions")
+        exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,136 @@
+#include "cache.hpp"
+#include "interface.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+// Increases when the format of the entries changes.
+#define CACHE_FORMAT 2
+
+CompilationCache::CompilationCache(const std::string& directory,
+                                   long long maxBytes)
+    : directory(directory), maxBytes(maxBytes) {
+  mkdir(directory.c_str(), 0777);
+}
+
+std::string CompilationCache::compilerVersion(const char* argv0) {
+  struct stat info;
+  if (stat("/proc/self/exe", &info) && stat(argv0, &info)) return "";
+  return std::to_string(CACHE_FORMAT) + " " + std::to_string(info.st_size) +
+         " " + std::to_string((long long)info.st_mtime);
+}
+
+// The key is 128 bits: the hashes of the text forwards and
+// backwards.
+std::string CompilationCache::key(const std::string& text) {
+  return contentHash(text) + contentHash(std::string(text.rbegin(), text.rend()));
+}
+
+std::string CompilationCache::entryPath(const std::string& text) {
+  std::string hash = key(text);
+  return directory + "/" + hash.substr(0, 2) + "/" + hash;
+}
+
+// An entry is the lengths of the text and the interface on a line,
+// the text, the interface and the output.
+bool CompilationCache::find(const std::string& text, CacheEntry& entry) {
+  std::string path = entryPath(text);
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  size_t textSize, interfaceSize;
+  if (!(file >> textSize >> interfaceSize) || file.get() != '\n' ||
+      textSize != text.size())
+    return false;
+  std::string entryText(textSize, '\0');
+  if (!file.read(&entryText[0], textSize) || entryText != text) return false;
+  // A damaged length is a miss, not an allocation of that size.
+  struct stat info;
+  if (stat(path.c_str(), &info) ||
+      interfaceSize > (size_t)(info.st_size - file.tellg()))
+    return false;
+  entry.interface.resize(interfaceSize);
+  if (!file.read(&entry.interface[0], interfaceSize)) return false;
+  std::ostringstream output;
+  output << file.rdbuf();
+  entry.output = output.str();
+  utime(path.c_str(), NULL);
+  return true;
+}
+
+void CompilationCache::store(const std::string& text, const CacheEntry& entry) {
+  std::string path = entryPath(text);
+  mkdir(path.substr(0, path.rfind('/')).c_str(), 0777);
+  std::string temporary = path + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream file(temporary, std::ios::binary);
+    file << text.size() << " " << entry.interface.size() << "\n" << text
+         << entry.interface << entry.output;
+    if (!file) {
+      unlink(temporary.c_str());
+      return;
+    }
+  }
+  if (rename(temporary.c_str(), path.c_str())) {
+    unlink(temporary.c_str());
+    return;
+  }
+  if (countStored(text.size() + entry.interface.size() + entry.output.size()))
+    evict();
+}
+
+// The bytes stored since the last eviction are kept in a file of
+// the cache. Compilers storing at the same time may lose each
+// other's counts, which only puts the next eviction off.
+bool CompilationCache::countStored(long long bytes) {
+  std::string path = directory + "/stored";
+  long long stored = 0;
+  std::ifstream(path) >> stored;
+  stored += bytes;
+  bool due = stored > maxBytes / 16;
+  std::ofstream(path) << (due ? 0 : stored) << std::endl;
+  return due;
+}
+
+void CompilationCache::evict() {
+  typedef struct cachefile {
+    std::string path;
+    time_t used;
+    long long size;
+  } CacheFile;
+  std::vector<CacheFile> files;
+  long long total = 0;
+  DIR* top = opendir(directory.c_str());
+  if (!top) return;
+  while (struct dirent* sub = readdir(top)) {
+    if (sub->d_name[0] == '.') continue;
+    std::string subdirectory = directory + "/" + sub->d_name;
+    DIR* entries = opendir(subdirectory.c_str());
+    if (!entries) continue;
+    while (struct dirent* name = readdir(entries)) {
+      if (name->d_name[0] == '.') continue;
+      std::string path = subdirectory + "/" + name->d_name;
+      struct stat info;
+      if (stat(path.c_str(), &info) || !S_ISREG(info.st_mode)) continue;
+      files.push_back(CacheFile{path, info.st_mtime, (long long)info.st_size});
+      total += info.st_size;
+    }
+    closedir(entries);
+  }
+  closedir(top);
+  if (total <= maxBytes) return;
+
+  std::sort(files.begin(), files.end(),
+            [](const CacheFile& a, const CacheFile& b) { return a.used < b.used; });
+  for (const CacheFile& file : files) {
+    if (total <= maxBytes) break;
+    if (!unlink(file.path.c_str())) total -= file.size;
+  }
+}
@@ -0,0 +1,57 @@
+#ifndef __CACHE_HPP
+#define __CACHE_HPP
+
+#include <string>
+
+// The compilation cache (--cache-dir=dir) keeps the output and the
+// interface of compiled programs on disk, by everything the output
+// depends on: the source, the options, the imported interfaces and
+// the compiler itself. A program compiled before is then written
+// out from the cache without being parsed.
+//
+// Each entry is a file named by the hash of that text, under a
+// directory named by the hash's first two digits. The entry keeps
+// the text too, and is only used when it matches, so two texts
+// with the same hash never share an entry. Entries are written to a
+// temporary file and renamed into place, so compilers sharing a
+// cache never see half an entry. A hit updates the modification
+// time of its entry. When the entries grow past the size limit
+// (--cache-size=MB, 256 by default), the least recently used ones
+// are removed. The entries are only added up once a sixteenth of
+// the limit has been stored since the last time, so the cache may
+// go over the limit by that much.
+
+typedef struct cacheentry {
+  std::string output;
+  std::string interface;
+} CacheEntry;
+
+class CompilationCache {
+private:
+  std::string directory;
+  long long maxBytes;
+
+  // Returns the hash of the text the output depends on.
+  static std::string key(const std::string& text);
+  std::string entryPath(const std::string& text);
+  // Adds bytes to what was stored since the last eviction, and
+  // returns whether the entries should be added up again.
+  bool countStored(long long bytes);
+  // Removes the least recently used entries until the rest fit.
+  void evict();
+
+public:
+  CompilationCache(const std::string& directory, long long maxBytes);
+
+  // Returns the version of the running compiler, which is part of
+  // every key: the size and modification time of its executable.
+  // Returns "" when the executable cannot be found, and then the
+  // cache is not used.
+  static std::string compilerVersion(const char* argv0);
+
+  // Find and store the entry for the text the output depends on.
+  bool find(const std::string& text, CacheEntry& entry);
+  void store(const std::string& text, const CacheEntry& entry);
+};
+
+#endif
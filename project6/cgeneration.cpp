@@ -0,0 +1,511 @@
+#include "cgeneration.hpp"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+// The C output starts with this. Arithmetic goes through unsigned
+// integers so that it wraps around at 32 bits instead of being
+// undefined on overflow.
+static const char* prelude =
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "\n"
+    "static inline int lang_add(int a, int b) {\n"
+    "  return (int)((unsigned)a + (unsigned)b);\n"
+    "}\n"
+    "static inline int lang_sub(int a, int b) {\n"
+    "  return (int)((unsigned)a - (unsigned)b);\n"
+    "}\n"
+    "static inline int lang_mul(int a, int b) {\n"
+    "  return (int)((unsigned)a * (unsigned)b);\n"
+    "}\n"
+    "static inline int lang_neg(int a) {\n"
+    "  return (int)(0u - (unsigned)a);\n"
+    "}\n"
+    "static void lang_print(int value) {\n"
+    "  printf(\"%d\\n\", value);\n"
+    "}\n";
+
+// Returns the C name for an identifier of the program. Program
+// identifiers cannot contain underscores, so appending one to the
+// names C reserves cannot clash with another identifier.
+static std::string cname(std::string name) {
+  static const std::set<std::string> reserved = {
+      "auto", "break", "case", "char", "const", "continue", "default",
+      "double", "else", "enum", "extern", "float", "for", "goto", "inline",
+      "int", "long", "register", "restrict", "short", "signed", "sizeof",
+      "static", "struct", "switch", "typedef", "union", "unsigned", "void",
+      "volatile", "EOF", "FILE", "NULL", "assert", "errno", "free",
+      "intptr_t", "main", "malloc", "offsetof", "printf", "size_t", "stderr",
+      "stdin", "stdout", "this"};
+  return reserved.count(name) ? name + "_" : name;
+}
+
+static std::string ctype(BaseType type, std::string className) {
+  if (type == bt_object) return "struct " + cname(className) + "*";
+  if (type == bt_none) return "void";
+  return "int";
+}
+
+// Converts an object to the (super)class a slot expects.
+static std::string convert(std::string value, BaseType type,
+                           std::string className) {
+  if (type != bt_object) return value;
+  return "(" + ctype(type, className) + ")" + value;
+}
+
+static bool hasSideEffects(ExpressionNode* node);
+
+template <typename T>
+static bool operandsHaveSideEffects(ExpressionNode* node) {
+  T* op = dynamic_cast<T*>(node);
+  return op &&
+         (hasSideEffects(op->expression_1) || hasSideEffects(op->expression_2));
+}
+
+// Returns whether an expression calls a method or allocates.
+static bool hasSideEffects(ExpressionNode* node) {
+  if (dynamic_cast<MethodCallNode*>(node) || dynamic_cast<NewNode*>(node))
+    return true;
+  if (auto op = dynamic_cast<NotNode*>(node))
+    return hasSideEffects(op->expression);
+  if (auto op = dynamic_cast<NegationNode*>(node))
+    return hasSideEffects(op->expression);
+  return operandsHaveSideEffects<PlusNode>(node) ||
+         operandsHaveSideEffects<MinusNode>(node) ||
+         operandsHaveSideEffects<TimesNode>(node) ||
+         operandsHaveSideEffects<DivideNode>(node) ||
+         operandsHaveSideEffects<GreaterNode>(node) ||
+         operandsHaveSideEffects<GreaterEqualNode>(node) ||
+         operandsHaveSideEffects<EqualNode>(node) ||
+         operandsHaveSideEffects<AndNode>(node) ||
+         operandsHaveSideEffects<OrNode>(node);
+}
+
+static std::string signature(std::string className, std::string methodName,
+                             MethodInfo& methodInfo,
+                             std::vector<ParameterNode*>* parameters) {
+  // Main.main is the entry point tester.c calls, without an object.
+  if (className == "Main" && methodName == "main")
+    return "int Main_main(void)";
+
+  std::string text = "static " +
+                     ctype(methodInfo.returnType.baseType,
+                           methodInfo.returnType.objectClassName) +
+                     " " + className + "_" + methodName + "(" +
+                     ctype(bt_object, className) + " this";
+  for (auto param : *parameters)
+    text += ", " + ctype(param->type->basetype, param->type->objectClassName) +
+            " " + cname(param->identifier->name);
+  return text + ")";
+}
+
+void CGenerator::line(std::string text) { *out << indent << text << std::endl; }
+
+std::string CGenerator::evaluate(ExpressionNode* node) {
+  node->accept(this);
+  return expression;
+}
+
+std::string CGenerator::temporary(std::string value, BaseType type,
+                                  std::string className) {
+  std::string name = "t_" + std::to_string(currentTemporary++);
+  line(ctype(type, className) + " " + name + " = " + value + ";");
+  return name;
+}
+
+// Returns whether a C expression is a temporary or a literal, which
+// side effects cannot change.
+static bool isStable(const std::string& value) {
+  return value.compare(0, 2, "t_") == 0 ||
+         value.find_first_not_of("0123456789") == std::string::npos;
+}
+
+// Evaluates two operands, left first. If the right one has side
+// effects, the left one is saved before them.
+void CGenerator::operands(ExpressionNode* left, ExpressionNode* right,
+                          std::string& a, std::string& b) {
+  a = evaluate(left);
+  if (hasSideEffects(right) && !isStable(a))
+    a = temporary(a, left->basetype, left->objectClassName);
+  b = evaluate(right);
+}
+
+// Calls a method found in className, leaving its result (if any)
+// in a temporary.
+void CGenerator::call(std::string className, std::string methodName,
+                      std::string object,
+                      std::vector<ExpressionNode*>* arguments) {
+  MethodInfo methodInfo = classTable->at(className).methods->at(methodName);
+  std::vector<ExpressionNode*> args;
+  if (arguments) args.assign(arguments->begin(), arguments->end());
+  std::vector<CompoundType> types(methodInfo.parameters->begin(),
+                                  methodInfo.parameters->end());
+
+  // Arguments are evaluated right to left, so each one is saved
+  // if any argument to its left has side effects.
+  std::vector<bool> sideEffectsBefore(args.size() + 1, false);
+  for (size_t i = 0; i < args.size(); i++)
+    sideEffectsBefore[i + 1] = sideEffectsBefore[i] || hasSideEffects(args[i]);
+  std::vector<std::string> values(args.size());
+  for (size_t i = args.size(); i-- > 0;) {
+    values[i] = evaluate(args[i]);
+    if (sideEffectsBefore[i] && !isStable(values[i]))
+      values[i] = temporary(values[i], args[i]->basetype,
+                            args[i]->objectClassName);
+  }
+
+  std::string text = className + "_" + methodName + "(";
+  bool isMain = className == "Main" && methodName == "main";
+  if (!isMain) text += convert(object, bt_object, className);
+  for (size_t i = 0; i < values.size(); i++)
+    text += ", " + convert(values[i], types[i].baseType,
+                           types[i].objectClassName);
+  text += ")";
+
+  if (isMain || methodInfo.returnType.baseType == bt_none) {
+    line(text + ";");
+    expression = "0";
+  } else {
+    expression = temporary(text, methodInfo.returnType.baseType,
+                           methodInfo.returnType.objectClassName);
+  }
+}
+
+// Returns the C lvalue for a member of an object of className (or
+// of one of its superclasses).
+std::string CGenerator::member(std::string object, std::string className,
+                               std::string name, VariableInfo& var) {
+  std::string path = object + "->";
+  ClassInfo classInfo = classTable->at(className);
+  while (!classInfo.members->count(name)) {
+    path += "super_.";
+    classInfo = classTable->at(classInfo.superClassName);
+  }
+  var = classInfo.members->at(name);
+  return path + cname(name);
+}
+
+// Returns the C lvalue for a local, parameter or member of this.
+std::string CGenerator::variable(std::string name, VariableInfo& var) {
+  if (currentMethodInfo.variables->count(name)) {
+    var = currentMethodInfo.variables->at(name);
+    return cname(name);
+  }
+  return member("this", currentClassName, name, var);
+}
+
+void CGenerator::statements(std::vector<StatementNode*>* list) {
+  indent += "  ";
+  if (list)
+    for (auto stmt : *list) stmt->accept(this);
+  indent.resize(indent.size() - 2);
+}
+
+void CGenerator::visitProgramNode(ProgramNode* node) {
+  *out << prelude << std::endl;
+
+  for (auto classNode : *node->class_list)
+    *out << "struct " << cname(classNode->identifier_1->name) << ";"
+         << std::endl;
+  *out << std::endl;
+
+  // Superclasses are declared before their subclasses, so the
+  // structs can be defined in program order.
+  for (auto classNode : *node->class_list) {
+    std::string className = classNode->identifier_1->name;
+    ClassInfo classInfo = classTable->at(className);
+    *out << "struct " << cname(className) << " {" << std::endl;
+    if (!classInfo.superClassName.empty())
+      *out << "  struct " << cname(classInfo.superClassName) << " super_;"
+           << std::endl;
+
+    std::vector<std::pair<int, std::string> > members;
+    for (auto& member : *classInfo.members)
+      members.push_back(std::make_pair(member.second.offset, member.first));
+    std::sort(members.begin(), members.end());
+    for (auto& member : members) {
+      VariableInfo var = classInfo.members->at(member.second);
+      *out << "  "
+           << (var.size == 1 ? "unsigned char"
+                             : ctype(var.type.baseType,
+                                     var.type.objectClassName))
+           << " " << cname(member.second) << ";" << std::endl;
+    }
+    *out << "};" << std::endl << std::endl;
+  }
+
+  *out << "static struct " << cname("Main") << " lang_main_object;"
+       << std::endl;
+  for (auto classNode : *node->class_list) {
+    if (!classNode->method_list) continue;
+    std::string className = classNode->identifier_1->name;
+    for (auto method : *classNode->method_list)
+      *out << signature(className, method->identifier->name,
+                        classTable->at(className).methods->at(
+                            method->identifier->name),
+                        method->parameter_list)
+           << ";" << std::endl;
+  }
+
+  node->visit_children(this);
+}
+
+void CGenerator::visitClassNode(ClassNode* node) {
+  currentClassName = node->identifier_1->name;
+  currentClassInfo = classTable->at(currentClassName);
+  if (node->method_list)
+    for (auto method : *node->method_list) method->accept(this);
+}
+
+void CGenerator::visitMethodNode(MethodNode* node) {
+  currentMethodName = node->identifier->name;
+  currentMethodInfo = currentClassInfo.methods->at(currentMethodName);
+  currentTemporary = 0;
+
+  *out << std::endl
+       << signature(currentClassName, currentMethodName, currentMethodInfo,
+                    node->parameter_list)
+       << " {" << std::endl;
+  indent = "  ";
+  if (currentClassName == "Main" && currentMethodName == "main") {
+    line(ctype(bt_object, "Main") + " this = &lang_main_object;");
+    node->methodbody->accept(this);
+    line("return 0;");
+  } else {
+    node->methodbody->accept(this);
+  }
+  *out << "}" << std::endl;
+}
+
+// Locals start out zero, where the generated assembly leaves them
+// uninitialized.
+void CGenerator::visitMethodBodyNode(MethodBodyNode* node) {
+  if (node->declaration_list)
+    for (auto declaration : *node->declaration_list)
+      declaration->accept(this);
+  if (node->statement_list)
+    for (auto stmt : *node->statement_list) stmt->accept(this);
+  if (node->returnstatement) node->returnstatement->accept(this);
+}
+
+void CGenerator::visitParameterNode(ParameterNode* node) {}
+
+void CGenerator::visitDeclarationNode(DeclarationNode* node) {
+  for (auto identifier : *node->identifier_list)
+    line(ctype(node->type->basetype, node->type->objectClassName) + " " +
+         cname(identifier->name) + " = 0;");
+}
+
+void CGenerator::visitReturnStatementNode(ReturnStatementNode* node) {
+  std::string value = evaluate(node->expression);
+  line("return " +
+       convert(value, currentMethodInfo.returnType.baseType,
+               currentMethodInfo.returnType.objectClassName) +
+       ";");
+}
+
+void CGenerator::visitAssignmentNode(AssignmentNode* node) {
+  std::string value = evaluate(node->expression);
+  VariableInfo var;
+  std::string target = variable(node->identifier_1->name, var);
+  if (node->identifier_2)
+    target = member(target, var.type.objectClassName,
+                    node->identifier_2->name, var);
+  line(target + " = " +
+       convert(value, var.type.baseType, var.type.objectClassName) + ";");
+}
+
+void CGenerator::visitCallNode(CallNode* node) {
+  node->methodcall->accept(this);
+}
+
+void CGenerator::visitIfElseNode(IfElseNode* node) {
+  std::string condition = evaluate(node->expression);
+  line("if (" + condition + ") {");
+  statements(node->statement_list_1);
+  if (node->statement_list_2 && !node->statement_list_2->empty()) {
+    line("} else {");
+    statements(node->statement_list_2);
+  }
+  line("}");
+}
+
+// A condition with side effects is evaluated inside the loop, in
+// front of its exit test.
+void CGenerator::visitWhileNode(WhileNode* node) {
+  if (!hasSideEffects(node->expression)) {
+    line("while (" + evaluate(node->expression) + ") {");
+    statements(node->statement_list);
+    line("}");
+    return;
+  }
+
+  line("for (;;) {");
+  indent += "  ";
+  line("if (!" + evaluate(node->expression) + ") break;");
+  indent.resize(indent.size() - 2);
+  statements(node->statement_list);
+  line("}");
+}
+
+void CGenerator::visitDoWhileNode(DoWhileNode* node) {
+  if (!hasSideEffects(node->expression)) {
+    line("do {");
+    statements(node->statement_list);
+    line("} while (" + evaluate(node->expression) + ");");
+    return;
+  }
+
+  line("for (;;) {");
+  statements(node->statement_list);
+  indent += "  ";
+  line("if (!" + evaluate(node->expression) + ") break;");
+  indent.resize(indent.size() - 2);
+  line("}");
+}
+
+// Objects print as their address, as in the generated assembly.
+void CGenerator::visitPrintNode(PrintNode* node) {
+  std::string value = evaluate(node->expression);
+  if (node->expression->basetype == bt_object)
+    value = "(int)(intptr_t)" + value;
+  line("lang_print(" + value + ");");
+}
+
+void CGenerator::visitPlusNode(PlusNode* node) {
+  std::string a, b;
+  operands(node->expression_1, node->expression_2, a, b);
+  expression = "lang_add(" + a + ", " + b + ")";
+}
+
+void CGenerator::visitMinusNode(MinusNode* node) {
+  std::string a, b;
+  operands(node->expression_1, node->expression_2, a, b);
+  expression = "lang_sub(" + a + ", " + b + ")";
+}
+
+void CGenerator::visitTimesNode(TimesNode* node) {
+  std::string a, b;
+  operands(node->expression_1, node->expression_2, a, b);
+  expression = "lang_mul(" + a + ", " + b + ")";
+}
+
+void CGenerator::visitDivideNode(DivideNode* node) {
+  std::string a, b;
+  operands(node->expression_1, node->expression_2, a, b);
+  expression = "(" + a + " / " + b + ")";
+}
+
+void CGenerator::visitGreaterNode(GreaterNode* node) {
+  std::string a, b;
+  operands(node->expression_1, node->expression_2, a, b);
+  expression = "(" + a + " > " + b + ")";
+}
+
+void CGenerator::visitGreaterEqualNode(GreaterEqualNode* node) {
+  std::string a, b;
+  operands(node->expression_1, node->expression_2, a, b);
+  expression = "(" + a + " >= " + b + ")";
+}
+
+// Objects of different classes compare as plain addresses.
+void CGenerator::visitEqualNode(EqualNode* node) {
+  std::string a, b;
+  operands(node->expression_1, node->expression_2, a, b);
+  if (node->expression_1->basetype == bt_object) {
+    a = "(void*)" + a;
+    b = "(void*)" + b;
+  }
+  expression = "(" + a + " == " + b + ")";
+}
+
+// Both operands of and/or are evaluated, as in the assembly.
+void CGenerator::visitAndNode(AndNode* node) {
+  std::string a, b;
+  operands(node->expression_1, node->expression_2, a, b);
+  expression = "(" + a + " & " + b + ")";
+}
+
+void CGenerator::visitOrNode(OrNode* node) {
+  std::string a, b;
+  operands(node->expression_1, node->expression_2, a, b);
+  expression = "(" + a + " | " + b + ")";
+}
+
+void CGenerator::visitNotNode(NotNode* node) {
+  expression = "(" + evaluate(node->expression) + " ^ 1)";
+}
+
+void CGenerator::visitNegationNode(NegationNode* node) {
+  expression = "lang_neg(" + evaluate(node->expression) + ")";
+}
+
+void CGenerator::visitMethodCallNode(MethodCallNode* node) {
+  // Pattern: foo()
+  std::string className = currentClassName;
+  std::string methodName = node->identifier_1->name;
+  std::string object = "this";
+
+  // Pattern: foo.bar()
+  if (node->identifier_2) {
+    VariableInfo var;
+    object = variable(node->identifier_1->name, var);
+    className = var.type.objectClassName;
+    methodName = node->identifier_2->name;
+  }
+
+  ClassInfo classInfo = classTable->at(className);
+  while (!classInfo.methods->count(methodName)) {
+    className = classInfo.superClassName;
+    classInfo = classTable->at(className);
+  }
+  call(className, methodName, object, node->expression_list);
+}
+
+void CGenerator::visitMemberAccessNode(MemberAccessNode* node) {
+  VariableInfo var;
+  std::string object = variable(node->identifier_1->name, var);
+  expression =
+      member(object, var.type.objectClassName, node->identifier_2->name, var);
+}
+
+void CGenerator::visitVariableNode(VariableNode* node) {
+  VariableInfo var;
+  expression = variable(node->identifier->name, var);
+}
+
+void CGenerator::visitIntegerLiteralNode(IntegerLiteralNode* node) {
+  expression = std::to_string(node->integer->value);
+}
+
+void CGenerator::visitBooleanLiteralNode(BooleanLiteralNode* node) {
+  expression = std::to_string(node->integer->value);
+}
+
+// As in the assembly, the object is allocated before the arguments
+// are evaluated, and they are only evaluated if the class itself
+// declares a constructor.
+void CGenerator::visitNewNode(NewNode* node) {
+  std::string className = node->identifier->name;
+  std::string object =
+      temporary("malloc(sizeof(struct " + cname(className) + "))", bt_object,
+                className);
+  if (classTable->at(className).methods->count(className))
+    call(className, className, object, node->expression_list);
+  expression = object;
+}
+
+void CGenerator::visitIntegerTypeNode(IntegerTypeNode* node) {}
+
+void CGenerator::visitBooleanTypeNode(BooleanTypeNode* node) {}
+
+void CGenerator::visitObjectTypeNode(ObjectTypeNode* node) {}
+
+void CGenerator::visitNoneNode(NoneNode* node) {}
+
+void CGenerator::visitIdentifierNode(IdentifierNode* node) {}
+
+void CGenerator::visitIntegerNode(IntegerNode* node) {}
@@ -0,0 +1,96 @@
+#ifndef __CGEN_HPP
+#define __CGEN_HPP
+
+#include "ast.hpp"
+#include "typecheck.hpp"
+#include "options.hpp"
+
+#include <iostream>
+#include <string>
+
+// This defines the CGenerator visitor, which translates the AST
+// into C (--emit=c) for an optimizing C compiler to build. Each
+// class becomes a struct with the layout in the class table (its
+// superclass as the first member, super_), and each method a
+// function Class_method taking this and its parameters. The
+// result links with tester.c like the generated assembly.
+//
+// The C keeps the semantics of the generated assembly: 32-bit
+// wrapping arithmetic, arguments evaluated right to left and
+// both operands of every operator evaluated left to right. Calls
+// and allocations are hoisted into temporaries (t_N) in the
+// order the assembly makes them, with any operand evaluated
+// before them saved first.
+class CGenerator : public Visitor {
+private:
+  std::string indent;
+  int currentTemporary;
+
+  // The C expression for the last expression visited.
+  std::string expression;
+
+  void line(std::string text);
+  std::string evaluate(ExpressionNode* node);
+  std::string temporary(std::string value, BaseType type,
+                        std::string className);
+  void operands(ExpressionNode* left, ExpressionNode* right, std::string& a,
+                std::string& b);
+  void call(std::string className, std::string methodName,
+            std::string object, std::vector<ExpressionNode*>* arguments);
+  std::string variable(std::string name, VariableInfo& var);
+  std::string member(std::string object, std::string className,
+                     std::string name, VariableInfo& var);
+  void statements(std::vector<StatementNode*>* list);
+
+public:
+  // Set by the main file, as for the CodeGenerator.
+  ClassTable* classTable;
+  CompilerOptions options;
+  std::ostream* out;
+
+  std::string currentClassName;
+  std::string currentMethodName;
+  ClassInfo currentClassInfo;
+  MethodInfo currentMethodInfo;
+
+  CGenerator() : currentTemporary(0), out(&std::cout) {}
+
+  virtual void visitProgramNode(ProgramNode* node);
+  virtual void visitClassNode(ClassNode* node);
+  virtual void visitMethodNode(MethodNode* node);
+  virtual void visitMethodBodyNode(MethodBodyNode* node);
+  virtual void visitParameterNode(ParameterNode* node);
+  virtual void visitDeclarationNode(DeclarationNode* node);
+  virtual void visitReturnStatementNode(ReturnStatementNode* node);
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitIfElseNode(IfElseNode* node);
+  virtual void visitWhileNode(WhileNode* node);
+  virtual void visitDoWhileNode(DoWhileNode* node);
+  virtual void visitPrintNode(PrintNode* node);
+  virtual void visitPlusNode(PlusNode* node);
+  virtual void visitMinusNode(MinusNode* node);
+  virtual void visitTimesNode(TimesNode* node);
+  virtual void visitDivideNode(DivideNode* node);
+  virtual void visitGreaterNode(GreaterNode* node);
+  virtual void visitGreaterEqualNode(GreaterEqualNode* node);
+  virtual void visitEqualNode(EqualNode* node);
+  virtual void visitAndNode(AndNode* node);
+  virtual void visitOrNode(OrNode* node);
+  virtual void visitNotNode(NotNode* node);
+  virtual void visitNegationNode(NegationNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+  virtual void visitIntegerLiteralNode(IntegerLiteralNode* node);
+  virtual void visitBooleanLiteralNode(BooleanLiteralNode* node);
+  virtual void visitNewNode(NewNode* node);
+  virtual void visitIntegerTypeNode(IntegerTypeNode* node);
+  virtual void visitBooleanTypeNode(BooleanTypeNode* node);
+  virtual void visitObjectTypeNode(ObjectTypeNode* node);
+  virtual void visitNoneNode(NoneNode* node);
+  virtual void visitIdentifierNode(IdentifierNode* node);
+  virtual void visitIntegerNode(IntegerNode* node);
+};
+
+#endif
@@ -1,44 +1,799 @@
 #include "codegeneration.hpp"
+#include "incremental.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cctype>
+#include <functional>
+#include <iterator>
+#include <thread>
+
+// Members packed into a single byte (see --compact-layout) are
+// loaded with zero extension and stored from the low byte of %eax.
+static std::string loadMember(const VariableInfo& var) {
+  return var.size == 1 ? "movzbl " : "movl ";
+}
+
+static std::string storeMember(const VariableInfo& var) {
+  return var.size == 1 ? "movb %al, " : "mov %eax, ";
+}
+
+// Returns the code of a method without comments or line numbers,
+// and with its labels (which are named after it) renamed to be the
+// same in every method. Labels are numbered in the order they are made,
+// so two methods with the same result behave the same.
+static std::string normalize(const std::string& symbol,
+                             const std::string& code) {
+  std::string prefix = ".L" + symbol + "_";
+  std::istringstream lines(code);
+  std::string line, result;
+  while (std::getline(lines, line)) {
+    size_t start = line.find_first_not_of(' ');
+    if (start == std::string::npos || line[start] == '#' ||
+        line.compare(start, 4, ".loc") == 0)
+      continue;
+    size_t at = 0;
+    while ((at = line.find(prefix, at)) != std::string::npos) {
+      line.replace(at, prefix.size(), ".L_");
+      at += 3;
+    }
+    result += line + "\n";
+  }
+  return result;
+}
+
+// Calls f on every statement in a list, including the ones
+// nested inside if/else and loop bodies.
+static void forEachStatement(std::vector<StatementNode*>* statements,
+                             const std::function<void(StatementNode*)>& f) {
+  if (!statements) return;
+  for (auto stmt : *statements) {
+    f(stmt);
+    if (auto ifElse = dynamic_cast<IfElseNode*>(stmt)) {
+      forEachStatement(ifElse->statement_list_1, f);
+      forEachStatement(ifElse->statement_list_2, f);
+    } else if (auto loop = dynamic_cast<WhileNode*>(stmt)) {
+      forEachStatement(loop->statement_list, f);
+    } else if (auto loop = dynamic_cast<DoWhileNode*>(stmt)) {
+      forEachStatement(loop->statement_list, f);
+    }
+  }
+}
+
+static int countStatements(std::vector<StatementNode*>* statements) {
+  int count = 0;
+  forEachStatement(statements, [&](StatementNode*) { count++; });
+  return count;
+}
+
+// Parameters which are assigned to in the method body cannot be
+// replaced by their initial value.
+static bool assignsVariable(std::vector<StatementNode*>* statements,
+                            const std::string& name) {
+  bool assigned = false;
+  forEachStatement(statements, [&](StatementNode* stmt) {
+    auto assignment = dynamic_cast<AssignmentNode*>(stmt);
+    if (assignment && !assignment->identifier_2 &&
+        assignment->identifier_1->name == name)
+      assigned = true;
+  });
+  return assigned;
+}
+
+// Evaluates an expression made up of literals and the constant
+// parameters of the current clone, with the same 32-bit results
+// the generated code would compute. Division by zero (and the
+// overflowing INT_MIN / -1) is left to trap at run time.
+bool CodeGenerator::foldConstant(ExpressionNode* node, int& value) {
+  int a, b;
+  if (auto literal = dynamic_cast<IntegerLiteralNode*>(node)) {
+    value = literal->integer->value;
+    return true;
+  }
+  if (auto literal = dynamic_cast<BooleanLiteralNode*>(node)) {
+    value = literal->integer->value;
+    return true;
+  }
+  if (auto variable = dynamic_cast<VariableNode*>(node)) {
+    auto constant = constantParameters.find(variable->identifier->name);
+    if (constant == constantParameters.end()) return false;
+    value = constant->second;
+    return true;
+  }
+  if (auto op = dynamic_cast<NotNode*>(node)) {
+    if (!foldConstant(op->expression, a)) return false;
+    value = a ^ 1;
+    return true;
+  }
+  if (auto op = dynamic_cast<NegationNode*>(node)) {
+    if (!foldConstant(op->expression, a)) return false;
+    value = (int)(0u - (unsigned)a);
+    return true;
+  }
+  if (auto op = dynamic_cast<PlusNode*>(node)) {
+    if (!foldConstant(op->expression_1, a) || !foldConstant(op->expression_2, b))
+      return false;
+    value = (int)((unsigned)a + (unsigned)b);
+    return true;
+  }
+  if (auto op = dynamic_cast<MinusNode*>(node)) {
+    if (!foldConstant(op->expression_1, a) || !foldConstant(op->expression_2, b))
+      return false;
+    value = (int)((unsigned)a - (unsigned)b);
+    return true;
+  }
+  if (auto op = dynamic_cast<TimesNode*>(node)) {
+    if (!foldConstant(op->expression_1, a) || !foldConstant(op->expression_2, b))
+      return false;
+    value = (int)((unsigned)a * (unsigned)b);
+    return true;
+  }
+  if (auto op = dynamic_cast<DivideNode*>(node)) {
+    if (!foldConstant(op->expression_1, a) || !foldConstant(op->expression_2, b))
+      return false;
+    if (b == 0 || (a == INT_MIN && b == -1)) return false;
+    value = a / b;
+    return true;
+  }
+  if (auto op = dynamic_cast<GreaterNode*>(node)) {
+    if (!foldConstant(op->expression_1, a) || !foldConstant(op->expression_2, b))
+      return false;
+    value = a > b;
+    return true;
+  }
+  if (auto op = dynamic_cast<GreaterEqualNode*>(node)) {
+    if (!foldConstant(op->expression_1, a) || !foldConstant(op->expression_2, b))
+      return false;
+    value = a >= b;
+    return true;
+  }
+  if (auto op = dynamic_cast<EqualNode*>(node)) {
+    if (!foldConstant(op->expression_1, a) || !foldConstant(op->expression_2, b))
+      return false;
+    value = a == b;
+    return true;
+  }
+  if (auto op = dynamic_cast<AndNode*>(node)) {
+    if (!foldConstant(op->expression_1, a) || !foldConstant(op->expression_2, b))
+      return false;
+    value = a & b;
+    return true;
+  }
+  if (auto op = dynamic_cast<OrNode*>(node)) {
+    if (!foldConstant(op->expression_1, a) || !foldConstant(op->expression_2, b))
+      return false;
+    value = a | b;
+    return true;
+  }
+  return false;
+}
+
+// Inside a specialized clone, pushes the value of any expression
+// which folds to a constant instead of computing it.
+bool CodeGenerator::emitFolded(ExpressionNode* node) {
+  int value;
+  if (constantParameters.empty() || !foldConstant(node, value)) return false;
+  *out << "# FOLDED" << std::endl;
+  *out << "  push $" << value << std::endl;
+  return true;
+}
+
+// Decides whether a call should go to a specialized clone of
+// its callee, requesting the clone if it has not been generated
+// or requested before. Returns the symbol to call, and marks which of the
+// arguments the clone has folded in (and so are not pushed).
+std::string CodeGenerator::specialize(MethodCallNode* node,
+                                      std::string className,
+                                      std::string methodName,
+                                      std::vector<bool>& isConstant) {
+  std::string symbol = className + "_" + methodName;
+  isConstant.assign(node->expression_list->size(), false);
+  if (!options.specialize || !methodNodes.count(symbol)) return symbol;
+  if (incremental)
+    dependencies.insert("method " + className + " " + methodName);
+
+  // Only clone small methods, unless the call is in a loop or the
+  // profile has the callee hot. Calls in methods which the profile
+  // has never called are left alone.
+  MethodNode* method = methodNodes.at(symbol);
+  std::vector<StatementNode*>* body = method->methodbody->statement_list;
+  if (loopDepth == 0 && !(profile && hotMethod(profile, symbol)) &&
+      countStatements(body) > options.specializeStatementLimit)
+    return symbol;
+  std::string caller = currentClassName + "_" + currentMethodName;
+  if (profile && !callCount(profile, caller)) return symbol;
+
+  Specialization clone{className, methodName, symbol + "__c", method, {}, {}};
+  bool anyConstant = false;
+  auto param = method->parameter_list->begin();
+  for (auto arg : *node->expression_list) {
+    std::string name = (*param++)->identifier->name;
+    int value = 0;
+    bool constant = foldConstant(arg, value) && !assignsVariable(body, name);
+    anyConstant |= constant;
+    clone.isConstant.push_back(constant);
+    clone.values.push_back(value);
+
+    if (clone.values.size() > 1) clone.symbol += "_";
+    if (!constant)
+      clone.symbol += "x";
+    else if (value < 0)
+      clone.symbol += "m" + std::to_string(-(long long)value);
+    else
+      clone.symbol += std::to_string(value);
+  }
+  if (!anyConstant) return symbol;
+
+  bool pending = false;
+  for (auto& request : pendingSpecializations)
+    pending |= request.symbol == clone.symbol;
+  if (!pending && !specializedSymbols.count(clone.symbol)) {
+    if (incremental) dependencies.insert("clones");
+    if ((int)pendingSpecializations.size() >= cloneBudget) return symbol;
+    pendingSpecializations.push_back(clone);
+  }
+  isConstant = clone.isConstant;
+  return clone.symbol;
+}
+
+// Writes precomputed output to stdout with a single call.
+void CodeGenerator::emitWrite(std::string output) {
+  if (output.empty()) return;
+  std::string label = newLabel("output");
+
+  *out << "# PRECOMPUTED OUTPUT" << std::endl;
+  *out << "  .data" << std::endl;
+  *out << label << ":" << std::endl;
+  size_t line = 0;
+  while (line < output.size()) {
+    size_t end = output.find('\n', line);
+    if (end == std::string::npos) end = output.size() - 1;
+    *out << "  .ascii \"" << output.substr(line, end - line) << "\\n\""
+         << std::endl;
+    line = end + 1;
+  }
+  *out << "  .text" << std::endl;
+  *out << "  push $" << output.size() << std::endl;
+  *out << "  push $" << label << std::endl;
+  *out << "  push $1" << std::endl;
+  *out << "  call write" << std::endl;
+  *out << "  add $12, %esp" << std::endl;
+}
+
+// Leaves the address of the memo table entry for the arguments at
+// argumentOffset(%esp) in %ecx. An entry is a valid flag, the
+// arguments and the result.
+void CodeGenerator::emitMemoEntry(int parameters, int argumentOffset,
+                                  std::string table) {
+  *out << "  mov " << argumentOffset << "(%esp), %eax" << std::endl;
+  for (int i = 1; i < parameters; i++) {
+    *out << "  imul $31, %eax" << std::endl;
+    *out << "  add " << argumentOffset + 4 * i << "(%esp), %eax"
+         << std::endl;
+  }
+  *out << "  and $" << options.memoTableSize - 1 << ", %eax" << std::endl;
+  *out << "  imul $" << 4 * (parameters + 2) << ", %eax, %ecx"
+       << std::endl;
+  *out << "  add $" << table << ", %ecx" << std::endl;
+}
+
+// Emits the memoizing entry point of a pure method, which returns
+// the result from its table if the arguments match and otherwise
+// calls the method body (at symbol__body) and records the result.
+void CodeGenerator::emitMemoLookup(std::string symbol, int parameters) {
+  std::string table = "memo_" + symbol;
+  std::string missLabel = newLabel("miss");
+  int entrySize = 4 * (parameters + 2);
+
+  *out << "# MEMOIZED" << std::endl;
+  *out << "  .lcomm " << table << ", "
+       << options.memoTableSize * entrySize << std::endl;
+
+  // Arguments start at 8(%esp), after the return address and this.
+  emitMemoEntry(parameters, 8, table);
+  *out << "  cmpl $1, (%ecx)" << std::endl;
+  *out << "  jne " << missLabel << std::endl;
+  for (int i = 0; i < parameters; i++) {
+    *out << "  mov " << 8 + 4 * i << "(%esp), %edx" << std::endl;
+    *out << "  cmp " << 4 + 4 * i << "(%ecx), %edx" << std::endl;
+    *out << "  jne " << missLabel << std::endl;
+  }
+  *out << "  mov " << entrySize - 4 << "(%ecx), %eax" << std::endl;
+  *out << "  ret" << std::endl;
+
+  // Each push moves the next word to copy into the same slot.
+  *out << missLabel << ":" << std::endl;
+  for (int i = 0; i <= parameters; i++)
+    *out << "  push " << 4 + 4 * parameters << "(%esp)" << std::endl;
+  *out << "  call " << symbol << "__body" << std::endl;
+  *out << "  add $" << 4 * (parameters + 1) << ", %esp" << std::endl;
+
+  *out << "  push %eax" << std::endl;
+  emitMemoEntry(parameters, 12, table);
+  *out << "  movl $1, (%ecx)" << std::endl;
+  for (int i = 0; i < parameters; i++) {
+    *out << "  mov " << 12 + 4 * i << "(%esp), %edx" << std::endl;
+    *out << "  mov %edx, " << 4 + 4 * i << "(%ecx)" << std::endl;
+  }
+  *out << "  pop %eax" << std::endl;
+  *out << "  mov %eax, " << entrySize - 4 << "(%ecx)" << std::endl;
+  *out << "  ret" << std::endl;
+  *out << symbol << "__body:" << std::endl;
+}
+
+// Writes out the generated methods and the helper routines they
+// call. With -Os, a method whose code is identical to an earlier
+// one becomes an alias of it.
+void CodeGenerator::emitMethods() {
+  std::map<std::string, std::string> canonical;
+  std::vector<std::pair<std::string, std::string> > aliases;
+
+  // Methods which were never called in the profile go after the
+  // rest, clones along with the methods they were made from.
+  if (profile) {
+    std::stable_partition(
+        generatedMethods.begin(), generatedMethods.end(),
+        [&](const GeneratedMethod& method) {
+          return callCount(profile, method.symbol.substr(
+                                        0, method.symbol.find("__"))) > 0;
+        });
+  }
+
+  for (auto& method : generatedMethods) {
+    if (options.optimizeSize) {
+      std::string key = normalize(method.symbol, method.code);
+      if (canonical.count(key)) {
+        aliases.push_back(std::make_pair(method.symbol, canonical[key]));
+        continue;
+      }
+      canonical[key] = method.symbol;
+    }
+    if (options.separateCompilation)
+      *out << "  .globl " << method.symbol << std::endl;
+    *out << "  .type " << method.symbol << ", @function" << std::endl;
+    *out << method.symbol << ':' << std::endl;
+    *out << method.code;
+    *out << "  .size " << method.symbol << ", .-" << method.symbol
+         << std::endl;
+    // The output is as large as all the methods together.
+    std::string().swap(method.code);
+  }
+
+  if (!aliases.empty()) *out << "# IDENTICAL CODE FOLDING" << std::endl;
+  for (auto& alias : aliases) {
+    if (options.separateCompilation)
+      *out << "  .globl " << alias.first << std::endl;
+    *out << "  .type " << alias.first << ", @function" << std::endl;
+    *out << "  .set " << alias.first << ", " << alias.second << std::endl;
+  }
+
+  for (auto& helper : thunks) {
+    *out << "  .type " << helper.first << ", @function" << std::endl;
+    *out << helper.first << ':' << std::endl;
+    *out << helper.second;
+    *out << "  .size " << helper.first << ", .-" << helper.first
+         << std::endl;
+  }
+}
+
+// Registers a shared helper routine, returning its name.
+std::string CodeGenerator::thunk(std::string name, std::string code) {
+  thunks[name] = code;
+  methodThunks.insert(name);
+  return name;
+}
+
+// Compares the top two values on the stack, replacing them with
+// 1 if the jump would be taken and 0 otherwise.
+void CodeGenerator::emitComparison(std::string jump, std::string thunkName) {
+  if (options.optimizeSize) {
+    std::string set = "set" + jump.substr(1);
+    // The thunk returns normally, so calls and returns stay paired
+    // for the return predictor, and the caller pushes the result.
+    *out << "  call "
+         << thunk(thunkName,
+                  "  movl 8(%esp), %eax\n"
+                  "  cmpl 4(%esp), %eax\n"
+                  "  " + set + " %al\n"
+                  "  movzbl %al, %eax\n"
+                  "  ret $8\n")
+         << std::endl;
+    *out << "  push %eax" << std::endl;
+    return;
+  }
+
+  std::string tLabel = newLabel("true");
+  std::string eLabel = newLabel("compared");
+
+  *out << "  pop %ebx" << std::endl;
+  *out << "  pop %eax" << std::endl;
+  *out << "  cmp %ebx, %eax" << std::endl;
+  *out << "  " << jump << " " << tLabel << std::endl;
+  *out << "  push $0" << std::endl;
+  *out << "  jmp " << eLabel << std::endl;
+  *out << tLabel << ":" << std::endl;
+  *out << "  push $1" << std::endl;
+  *out << eLabel << ":" << std::endl;
+}
+
+// Numbers the entries of the profile table: each method, followed
+// by its branches in the order profiledBranches gives them. The
+// timers of the methods are numbered in the same order.
+void CodeGenerator::numberProfileEntries(ProgramNode* node) {
+  for (auto classNode : *node->class_list) {
+    if (!classNode->method_list) continue;
+    for (auto method : *classNode->method_list) {
+      std::string symbol =
+          classNode->identifier_1->name + "_" + method->identifier->name;
+      timerNumbers[method->methodbody] = timerNames.size();
+      timerNames.push_back(symbol);
+      profileEntries[method->methodbody] = profileNames.size();
+      profileNames.push_back(symbol);
+      int number = 0;
+      for (auto branch : profiledBranches(method)) {
+        profileEntries[branch] = profileNames.size();
+        profileNames.push_back(symbol + " " + std::to_string(number++));
+      }
+    }
+  }
+}
+
+// Returns the address of a counter of a profile entry. Entries are
+// laid out as in profile_runtime.c: the name, whether the entry is
+// a branch and two counters.
+std::string CodeGenerator::profileCounter(ASTNode* node, int counter) {
+  return "__lang_profile_entries+" +
+         std::to_string(16 * profileEntries.at(node) + 8 + 4 * counter);
+}
+
+// Counts a branch whose condition was just popped into %eax (0 or
+// 1): how often it was taken, and how often it was evaluated.
+void CodeGenerator::emitBranchCount(StatementNode* node) {
+  if (!options.profileGenerate) return;
+  *out << "  add %eax, " << profileCounter(node, 0) << std::endl;
+  *out << "  addl $1, " << profileCounter(node, 1) << std::endl;
+}
+
+void CodeGenerator::emitProfileTable() {
+  *out << "# PROFILE COUNTERS" << std::endl;
+  *out << "  .data" << std::endl;
+  *out << "  .globl __lang_profile_size" << std::endl;
+  *out << "__lang_profile_size:" << std::endl;
+  *out << "  .long " << profileNames.size() << std::endl;
+  *out << "  .globl __lang_profile_entries" << std::endl;
+  *out << "__lang_profile_entries:" << std::endl;
+  for (size_t i = 0; i < profileNames.size(); i++) {
+    bool isBranch = profileNames[i].find(' ') != std::string::npos;
+    *out << "  .long __lang_profile_name_" << i << ", " << isBranch
+         << ", 0, 0" << std::endl;
+  }
+  for (size_t i = 0; i < profileNames.size(); i++)
+    *out << "__lang_profile_name_" << i << ": .asciz \"" << profileNames[i]
+         << "\"" << std::endl;
+  *out << "  .text" << std::endl;
+}
+
+// Emits the names of the methods by the number of their timer.
+void CodeGenerator::emitTimerTable() {
+  *out << "# PROFILE TIMERS" << std::endl;
+  *out << "  .data" << std::endl;
+  *out << "  .globl __lang_timer_size" << std::endl;
+  *out << "__lang_timer_size:" << std::endl;
+  *out << "  .long " << timerNames.size() << std::endl;
+  *out << "  .globl __lang_timer_names" << std::endl;
+  *out << "__lang_timer_names:" << std::endl;
+  for (size_t i = 0; i < timerNames.size(); i++)
+    *out << "  .long __lang_timer_name_" << i << std::endl;
+  for (size_t i = 0; i < timerNames.size(); i++)
+    *out << "__lang_timer_name_" << i << ": .asciz \"" << timerNames[i]
+         << "\"" << std::endl;
+  *out << "  .text" << std::endl;
+}
+
+// Allocates an object through the runtime, which counts it in the
+// record of its allocation site (see profile_runtime.c): the link
+// to the next site, the objects and bytes allocated there, and the
+// class, method and source line.
+void CodeGenerator::emitAllocationSite(std::string className, int size,
+                                       int line) {
+  std::string site = newLabel("site");
+  std::string classLabel = newLabel("class");
+  std::string methodLabel = newLabel("method");
+
+  *out << "  .data" << std::endl;
+  *out << site << ":" << std::endl;
+  *out << "  .long 0, 0, 0, 0, " << classLabel << ", " << methodLabel << ", "
+       << line << std::endl;
+  *out << classLabel << ": .asciz \"" << className << "\"" << std::endl;
+  *out << methodLabel << ": .asciz \"" << currentClassName << "_"
+       << currentMethodName << "\"" << std::endl;
+  *out << "  .text" << std::endl;
+  *out << "  push $" << site << std::endl;
+  *out << "  push $" << size << std::endl;
+  *out << "  call __lang_allocate" << std::endl;
+  *out << "  add $8, %esp" << std::endl;
+}
+
+// Returns how often a branch was taken and not taken in the
+// profile, or zero counts if there is none.
+BranchCount CodeGenerator::branchCount(StatementNode* node) {
+  BranchCount count = {0, 0};
+  if (!profile) return count;
+  auto branch = profile->branches.find(profileNames[profileEntries.at(node)]);
+  if (branch != profile->branches.end()) count = branch->second;
+  return count;
+}
+
+// With -g, marks the code which follows as coming from the line
+// of a node.
+void CodeGenerator::emitLine(ASTNode* node) {
+  if (!options.debugLines || node->lineno == currentLine) return;
+  currentLine = node->lineno;
+  *out << "  .loc 1 " << currentLine << std::endl;
+}
+
+// Generates a method, or a clone of one, into its own buffer.
+GeneratedMethod CodeGenerator::generateMethod(const Specialization& method) {
+  // Cleared first, so the method depends on the layout of its own
+  // class, which its member accesses take their offsets from.
+  pendingSpecializations.clear();
+  methodThunks.clear();
+  dependencies.clear();
+  currentClassName = method.className;
+  currentClassInfo = lookupClass(currentClassName);
+  currentMethodName = method.methodName;
+  currentMethodInfo = currentClassInfo.methods->at(currentMethodName);
+  currentSymbol = method.symbol;
+  currentLabel = 0;
+  currentLine = 0;
+  if (incremental)
+    dependencies.insert("method " + currentClassName + " " + currentMethodName);
+
+  std::ostream* output = out;
+  std::ostringstream code;
+  out = &code;
+  // The return type is on the line of the method's header.
+  emitLine(method.method->type);
+  if (method.isConstant.empty()) {
+    int parameters = currentMethodInfo.parameters->size();
+    if (options.memoize && currentMethodInfo.pure && parameters)
+      emitMemoLookup(method.symbol, parameters);
+    visit_children(method.method);
+  } else {
+    // The parameters still passed at run time move down into the
+    // slots of the ones which were folded in.
+    currentMethodInfo.variables =
+        std::make_shared<VariableTable>(*currentMethodInfo.variables);
+    int parameterOffset = 12;
+    int index = 0;
+    for (auto param : *method.method->parameter_list) {
+      std::string name = param->identifier->name;
+      if (method.isConstant[index]) {
+        constantParameters[name] = method.values[index];
+      } else {
+        (*currentMethodInfo.variables)[name].offset = parameterOffset;
+        parameterOffset += 4;
+      }
+      index++;
+    }
+
+    *out << "# SPECIALIZATION OF " << method.className << "_"
+         << method.methodName << std::endl;
+    dispatch(method.method->methodbody);
+    constantParameters.clear();
+  }
+  out = output;
+  GeneratedMethod result{method.symbol, code.str(), pendingSpecializations,
+                         {}, methodThunks};
+  for (auto& name : dependencies) result.dependencies[name];
+  return result;
+}
+
+// Returns the class table entry of a class, recording that the
+// method being generated depends on it.
+const ClassInfo& CodeGenerator::lookupClass(const std::string& className) {
+  if (incremental) dependencies.insert("class " + className);
+  return classTable->at(className);
+}
+
+// Generates a round of methods, appending them to the generated
+// methods in order, and replaces the round with the clones they
+// requested. Every method of a round sees the same clones as
+// already generated, and gets an equal share of what is left of
+// the clone limit (the first ones one more), so what it calls
+// does not depend on which thread generates it or when.
+void CodeGenerator::generateRound(std::vector<Specialization>& round) {
+  std::vector<GeneratedMethod> results(round.size());
+  int left = std::max(0, options.specializeCloneLimit -
+                             (int)specializedSymbols.size());
+  std::vector<int> budgets(round.size());
+  for (size_t i = 0; i < round.size(); i++)
+    budgets[i] = left / (int)round.size() + ((int)i < left % (int)round.size());
+  // With --incremental, only the methods which changed are
+  // generated, and the rest taken from the last compilation.
+  std::vector<bool> reused(round.size(), false);
+  std::vector<size_t> pending;
+  for (size_t i = 0; i < round.size(); i++) {
+    cloneBudget = budgets[i];
+    if (incremental) reused[i] = incremental->reuse(round[i], this, results[i]);
+    if (!reused[i]) pending.push_back(i);
+  }
+  int threads = options.jobs > 0 ? options.jobs
+                                 : std::thread::hardware_concurrency();
+  threads = std::max(1, std::min(threads, (int)pending.size()));
+
+  std::atomic<size_t> next(0);
+  std::vector<CodeGenerator> workers(threads);
+  auto work = [&](CodeGenerator* worker) {
+    for (size_t i = next++; i < pending.size(); i = next++) {
+      worker->cloneBudget = budgets[pending[i]];
+      results[pending[i]] = worker->generateMethod(round[pending[i]]);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (auto& worker : workers) {
+    worker.classTable = classTable;
+    worker.options = options;
+    worker.methodNodes = methodNodes;
+    worker.specializedSymbols = specializedSymbols;
+    worker.evaluation = evaluation;
+    worker.profileEntries = profileEntries;
+    worker.profileNames = profileNames;
+    worker.timerNumbers = timerNumbers;
+    worker.profile = profile;
+    worker.incremental = incremental;
+    if (&worker != &workers.back()) pool.push_back(std::thread(work, &worker));
+  }
+  work(&workers.back());
+  for (auto& thread : pool) thread.join();
+
+  round.clear();
+  for (auto& worker : workers)
+    thunks.insert(worker.thunks.begin(), worker.thunks.end());
+  // The digests are taken before the clones of this round are added.
+  for (size_t i : pending) {
+    cloneBudget = budgets[i];
+    if (incremental) incremental->record(results[i], this);
+  }
+  for (auto& method : results) {
+    for (auto& clone : method.clones) {
+      if (specializedSymbols.insert(clone.symbol).second)
+        round.push_back(clone);
+    }
+    method.clones.clear();
+    generatedMethods.push_back(method);
+  }
+}
 
 // CodeGenerator Visitor Functions: These are the functions
 // you will complete to generate the x86 assembly code. Not
 // all functions must have code, many may be left empty.
 
+void CodeGenerator::beginProgram() {
+  if (options.debugLines) {
+    *out << "  .file \"" << sourceFile << "\"" << std::endl;
+    *out << "  .file 1 \"" << sourceFile << "\"" << std::endl;
+  }
+  *out << "  .data" << std::endl;
+  *out << "  printstr: .asciz \"%d\\n\"" << std::endl;
+  *out << "  .text" << std::endl;
+  *out << "  .globl Main_main" << std::endl;
+}
+
+// Adds the methods of a class to a round, indexing them by symbol.
+void CodeGenerator::addMethods(ClassNode* node,
+                               std::vector<Specialization>& round) {
+  if (!node->method_list) return;
+  std::string className = node->identifier_1->name;
+  for (auto method : *node->method_list) {
+    std::string methodName = method->identifier->name;
+    std::string symbol = className + "_" + methodName;
+    methodNodes[symbol] = method;
+    round.push_back({className, methodName, symbol, method, {}, {}});
+  }
+}
+
+void CodeGenerator::generateClass(ClassNode* node) {
+  std::vector<Specialization> round;
+  addMethods(node, round);
+  while (!round.empty()) generateRound(round);
+  if (!node->method_list) return;
+  for (auto method : *node->method_list)
+    methodNodes.erase(node->identifier_1->name + "_" + method->identifier->name);
+}
+
+void CodeGenerator::endProgram() {
+  emitMethods();
+  if (options.profileGenerate) emitProfileTable();
+  if (options.profileTimers) emitTimerTable();
+}
+
 void CodeGenerator::visitProgramNode(ProgramNode* node) {
-  std::cout << "  .data" << std::endl;
-  std::cout << "  printstr: .asciz \"%d\\n\"" << std::endl;
-  std::cout << "  .text" << std::endl;
-  std::cout << "  .globl Main_main" << std::endl;
+  beginProgram();
+
+  // The whole program ran at compile time.
+  if (evaluation && evaluation->complete) {
+    *out << "  .type Main_main, @function" << std::endl;
+    *out << "Main_main:" << std::endl;
+    currentSymbol = "Main_main";
+    emitWrite(evaluation->output);
+    *out << "  ret" << std::endl;
+    *out << "  .size Main_main, .-Main_main" << std::endl;
+    return;
+  }
+
+  if (options.profileGenerate || options.profileTimers || profile)
+    numberProfileEntries(node);
 
-  node->visit_children(this);
+  std::vector<Specialization> round;
+  for (auto classNode : *node->class_list) addMethods(classNode, round);
+  while (!round.empty()) generateRound(round);
+  endProgram();
 }
 
 void CodeGenerator::visitClassNode(ClassNode* node) {
   currentClassName = node->identifier_1->name;
-  currentClassInfo = classTable->at(currentClassName);
-  node->visit_children(this);
+  currentClassInfo = lookupClass(currentClassName);
+  visit_children(node);
 }
 
 void CodeGenerator::visitMethodNode(MethodNode* node) {
-  currentMethodName = node->identifier->name;
-  currentMethodInfo = currentClassInfo.methods->at(currentMethodName);
-  std::cout << currentClassName << '_' << currentMethodName << ':' << std::endl;
-  node->visit_children(this);
+  std::string className = currentClassName;
+  std::string methodName = node->identifier->name;
+  generatedMethods.push_back(generateMethod(
+      {className, methodName, className + "_" + methodName, node, {}, {}}));
 }
 
 // CHECK - B
 void CodeGenerator::visitMethodBodyNode(MethodBodyNode* node) {
-  std::cout << "# METHOD BODY" << std::endl;
-  std::cout << "  push %ebp" << std::endl;
-  std::cout << "  mov %esp, %ebp" << std::endl;
-  std::cout << "  sub $" << currentMethodInfo.localsSize << ", %esp"
-            << std::endl;
-
-  node->visit_children(this);
-  std::cout << "  add $" << currentMethodInfo.localsSize <<", %esp" << std::endl;
-	std::cout << "  pop %ebp" << std::endl;
-  // std::cout << "  leave" << std::endl;  // Restore stack and base pointers
-  std::cout << "  ret" << std::endl;
+  *out << "# METHOD BODY" << std::endl;
+  if (options.profileGenerate)
+    *out << "  addl $1, " << profileCounter(node, 0) << std::endl;
+  if (options.profileTimers) {
+    *out << "  push $" << timerNumbers.at(node) << std::endl;
+    *out << "  call __lang_profile_enter" << std::endl;
+    *out << "  add $4, %esp" << std::endl;
+  }
+  *out << "  push %ebp" << std::endl;
+  *out << "  mov %esp, %ebp" << std::endl;
+  if (!options.optimizeSize || currentMethodInfo.localsSize)
+    *out << "  sub $" << currentMethodInfo.localsSize << ", %esp"
+         << std::endl;
+
+  // Pick Main.main up after the statements which ran at compile
+  // time, with their output written and their results restored.
+  if (evaluation && evaluation->foldedStatements &&
+      currentClassName == "Main" && currentMethodName == "main") {
+    emitWrite(evaluation->output);
+    for (auto local : evaluation->locals) {
+      int offset = currentMethodInfo.variables->at(local.first).offset;
+      *out << "  movl $" << local.second << ", " << offset << "(%ebp)"
+           << std::endl;
+    }
+    auto stmt = node->statement_list->begin();
+    std::advance(stmt, evaluation->foldedStatements);
+    for (; stmt != node->statement_list->end(); ++stmt) dispatch(*stmt);
+    if (node->returnstatement) dispatch(node->returnstatement);
+  } else {
+    visit_children(node);
+  }
+  if (options.profileTimers) {
+    *out << "  push %eax" << std::endl;
+    *out << "  call __lang_profile_exit" << std::endl;
+    *out << "  pop %eax" << std::endl;
+  }
+  if (!options.optimizeSize || currentMethodInfo.localsSize)
+    *out << "  add $" << currentMethodInfo.localsSize << ", %esp" << std::endl;
+	*out << "  pop %ebp" << std::endl;
+  // *out << "  leave" << std::endl;  // Restore stack and base pointers
+  *out << "  ret" << std::endl;
+
+  if (!coldCode.empty()) {
+    *out << "# COLD CODE" << std::endl;
+    *out << coldCode;
+    coldCode.clear();
+  }
 }
 
 void CodeGenerator::visitParameterNode(ParameterNode* node) {}
@@ -46,17 +801,19 @@ void CodeGenerator::visitParameterNode(ParameterNode* node) {}
 void CodeGenerator::visitDeclarationNode(DeclarationNode* node) {}
 
 void CodeGenerator::visitReturnStatementNode(ReturnStatementNode* node) {
-  node->visit_children(this);
-  std::cout << "# RETURN" << std::endl;
-  std::cout << "  pop %eax" << std::endl;
+  emitLine(node);
+  visit_children(node);
+  *out << "# RETURN" << std::endl;
+  *out << "  pop %eax" << std::endl;
 }
 
 void CodeGenerator::visitAssignmentNode(AssignmentNode* node) {
-  node->visit_children(this);
-  std::cout << "# ASSIGNMENT TO: "
-            << node->identifier_1->name
-            << (node->identifier_2 ? "." + node->identifier_2->name : "")
-            << std::endl;
+  emitLine(node);
+  visit_children(node);
+  *out << "# ASSIGNMENT TO: "
+       << node->identifier_1->name
+       << (node->identifier_2 ? "." + node->identifier_2->name : "")
+       << std::endl;
 
   int offset = 0;
   ClassInfo id2Class;
@@ -66,271 +823,316 @@ void CodeGenerator::visitAssignmentNode(AssignmentNode* node) {
     VariableInfo var = currentMethodInfo.variables->at(node->identifier_1->name);
     offset = var.offset;
     if (node->identifier_2) {
-      std::cout << "  mov "<< offset <<"(%ebp), %ecx" << std::endl;
-			id2Class = classTable->at(var.type.objectClassName);
+      *out << "  mov "<< offset <<"(%ebp), %ecx" << std::endl;
+			id2Class = lookupClass(var.type.objectClassName);
     } else {
-      std::cout << "  pop %eax" << std::endl;
-			std::cout << "  mov %eax, "<< offset << "(%ebp)" << std::endl;
+      *out << "  pop %eax" << std::endl;
+			*out << "  mov %eax, "<< offset << "(%ebp)" << std::endl;
     }
   }
 
   // identifier_1 is a member variable
   else {
     // Find class for identifier_1
-    ClassInfo classInfo = classTable->at(currentClassName);
+    ClassInfo classInfo = lookupClass(currentClassName);
     while (!classInfo.members->count(node->identifier_1->name)) {
-      classInfo = classTable->at(classInfo.superClassName);
+      classInfo = lookupClass(classInfo.superClassName);
     }
     // Calculate offset based on superclasses
     VariableInfo var = classInfo.members->at(node->identifier_1->name);
     offset = var.offset;
 		while (!classInfo.superClassName.empty()) {
-      classInfo = classTable->at(classInfo.superClassName);
+      classInfo = lookupClass(classInfo.superClassName);
 			offset += classInfo.membersSize;
 		}
     if (node->identifier_2) {
-      id2Class = classTable->at(var.type.objectClassName);
-			std::cout << "  mov 8(%ebp), %ebx" << std::endl;
-			std::cout << "  mov " << offset << "(%ebx), %ecx" << std::endl;
+      id2Class = lookupClass(var.type.objectClassName);
+			*out << "  mov 8(%ebp), %ebx" << std::endl;
+			*out << "  mov " << offset << "(%ebx), %ecx" << std::endl;
 		}
 		else {
-			std::cout << "  pop %eax" << std::endl;
-			std::cout << "  mov 8(%ebp), %ebx" << std::endl;
-			std::cout << "  mov %eax, " << offset << "(%ebx)" << std::endl;
+			*out << "  pop %eax" << std::endl;
+			*out << "  mov 8(%ebp), %ebx" << std::endl;
+			*out << "  " << storeMember(var) << offset << "(%ebx)" << std::endl;
 		}
   }
 
   if (node->identifier_2) {
     while (!id2Class.members->count(node->identifier_2->name)) {
-      id2Class = classTable->at(id2Class.superClassName);
+      id2Class = lookupClass(id2Class.superClassName);
     }
     VariableInfo var = id2Class.members->at(node->identifier_2->name);
     offset = var.offset;
 
     // Calculate offset based on superclasses
 		while (!id2Class.superClassName.empty()) {
-      id2Class = classTable->at(id2Class.superClassName);
+      id2Class = lookupClass(id2Class.superClassName);
 			offset += id2Class.membersSize;
 		}
 
-    std::cout << "  pop %eax" << std::endl;
-		std::cout << "  mov %eax, "<< offset << "(%ecx)" << std::endl;
+    *out << "  pop %eax" << std::endl;
+		*out << "  " << storeMember(var) << offset << "(%ecx)" << std::endl;
   }
 }
 
 void CodeGenerator::visitCallNode(CallNode* node) {
-  node->visit_children(this);
-  std::cout << "# CALL NODE" << std::endl;
-  std::cout << "  add $4, %esp" << std::endl;
+  emitLine(node);
+  visit_children(node);
+  *out << "# CALL NODE" << std::endl;
+  *out << "  add $4, %esp" << std::endl;
 }
 
 void CodeGenerator::visitIfElseNode(IfElseNode* node) {
-  node->expression->accept(this);
-  std::string elseLabel = "label_" + std::to_string(nextLabel());
-  std::string endLabel = "label_" + std::to_string(nextLabel());
-
-  std::cout << "# IF ELSE" << std::endl;
-
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  cmp $1, %eax" << std::endl;
-  std::cout << "  jne " << elseLabel << std::endl;
+  int value;
+  if (!constantParameters.empty() && foldConstant(node->expression, value)) {
+    *out << "# IF ELSE (FOLDED)" << std::endl;
+    std::vector<StatementNode*>* taken =
+        value ? node->statement_list_1 : node->statement_list_2;
+    if (taken)
+      for (auto stmt : *taken) dispatch(stmt);
+    return;
+  }
 
-  if (node->statement_list_1)
-    for (auto stmt : *(node->statement_list_1)) stmt->accept(this);
+  emitLine(node->expression);
+  dispatch(node->expression);
+
+  // The branch which ran more often in the profile falls through,
+  // and one which never ran is moved out of line.
+  BranchCount count = branchCount(node);
+  bool elseFirst = count.notTaken > count.taken;
+  std::string secondLabel = newLabel(elseFirst ? "then" : "else");
+  std::string endLabel = newLabel("endif");
+  std::vector<StatementNode*>* first =
+      elseFirst ? node->statement_list_2 : node->statement_list_1;
+  std::vector<StatementNode*>* second =
+      elseFirst ? node->statement_list_1 : node->statement_list_2;
+  bool secondCold = (elseFirst ? count.taken : count.notTaken) == 0 &&
+                    count.taken + count.notTaken > 0 && second &&
+                    !second->empty();
+
+  *out << "# IF ELSE" << std::endl;
+
+  *out << "  pop %eax" << std::endl;
+  emitBranchCount(node);
+  *out << "  cmp $1, %eax" << std::endl;
+  *out << "  " << (elseFirst ? "je " : "jne ") << secondLabel << std::endl;
+
+  if (first)
+    for (auto stmt : *first) dispatch(stmt);
+
+  if (secondCold) {
+    *out << endLabel << ":" << std::endl;
+    std::ostream* output = out;
+    std::ostringstream code;
+    out = &code;
+    *out << secondLabel << ":" << std::endl;
+    currentLine = 0;
+    for (auto stmt : *second) dispatch(stmt);
+    *out << "  jmp " << endLabel << std::endl;
+    out = output;
+    coldCode += code.str();
+    currentLine = 0;
+    return;
+  }
 
-  std::cout << "  jmp " << endLabel << std::endl;
-  std::cout << elseLabel << ":" << std::endl;
+  *out << "  jmp " << endLabel << std::endl;
+  *out << secondLabel << ":" << std::endl;
 
-  if (node->statement_list_2)
-    for (auto stmt : *(node->statement_list_2)) stmt->accept(this);
+  if (second)
+    for (auto stmt : *second) dispatch(stmt);
 
-  std::cout << endLabel << ":" << std::endl;
+  *out << endLabel << ":" << std::endl;
 }
 
 void CodeGenerator::visitWhileNode(WhileNode* node) {
-  std::string startLabel = "label_" + std::to_string(nextLabel());
-  std::string exitLabel = "label_" + std::to_string(nextLabel());
-
-  std::cout << "# WHILE" << std::endl;
-  std::cout << startLabel << ":" << std::endl;
-  node->expression->accept(this);
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  cmp $1, %eax" << std::endl;
-  std::cout << "  jne " << exitLabel << std::endl;
+  int value;
+  if (!constantParameters.empty() && foldConstant(node->expression, value) &&
+      !value) {
+    *out << "# WHILE (FOLDED)" << std::endl;
+    return;
+  }
 
-  for (auto stmt : *(node->statement_list)) stmt->accept(this);
+  std::string startLabel = newLabel("while");
+  std::string exitLabel = newLabel("endwhile");
+
+  // Loops which ran at least four times each time they were entered
+  // in the profile test their condition twice per jump back.
+  BranchCount count = branchCount(node);
+  int copies = count.taken > 0 && count.taken >= 4 * count.notTaken &&
+                       countStatements(node->statement_list) <=
+                           options.unrollStatementLimit
+                   ? 2
+                   : 1;
+
+  *out << "# WHILE" << std::endl;
+  *out << startLabel << ":" << std::endl;
+  for (int copy = 0; copy < copies; copy++) {
+    if (copy) *out << "# UNROLLED" << std::endl;
+    emitLine(node->expression);
+    dispatch(node->expression);
+    *out << "  pop %eax" << std::endl;
+    emitBranchCount(node);
+    *out << "  cmp $1, %eax" << std::endl;
+    *out << "  jne " << exitLabel << std::endl;
+
+    loopDepth++;
+    for (auto stmt : *(node->statement_list)) dispatch(stmt);
+    loopDepth--;
+  }
 
-  std::cout << "  jmp " << startLabel << std::endl;
-  std::cout << exitLabel << ":" << std::endl;
+  *out << "  jmp " << startLabel << std::endl;
+  *out << exitLabel << ":" << std::endl;
 }
 
 void CodeGenerator::visitPrintNode(PrintNode* node) {
-  node->visit_children(this);
+  emitLine(node);
+  visit_children(node);
 
-  std::cout << "# PRINT" << std::endl;
+  *out << "# PRINT" << std::endl;
 
-  std::cout << "  push $printstr" << std::endl;
-  std::cout << "  call printf" << std::endl;
-  std::cout << "  add $8, %esp" << std::endl;
+  *out << "  push $printstr" << std::endl;
+  *out << "  call printf" << std::endl;
+  *out << "  add $8, %esp" << std::endl;
 }
 
 void CodeGenerator::visitDoWhileNode(DoWhileNode* node) {
-  std::string startLabel = "label_" + std::to_string(nextLabel());
-  std::string exitLabel = "label_" + std::to_string(nextLabel());
+  int value;
+  if (!constantParameters.empty() && foldConstant(node->expression, value) &&
+      !value) {
+    *out << "# DO WHILE (FOLDED)" << std::endl;
+    for (auto stmt : *(node->statement_list)) dispatch(stmt);
+    return;
+  }
+
+  std::string startLabel = newLabel("do");
+  std::string exitLabel = newLabel("enddo");
 
-  std::cout << "# DO WHILE" << std::endl;
+  *out << "# DO WHILE" << std::endl;
 
-  std::cout << startLabel << ":" << std::endl;
+  *out << startLabel << ":" << std::endl;
 
-  for (auto stmt : *(node->statement_list)) stmt->accept(this);
-  node->expression->accept(this);
+  loopDepth++;
+  for (auto stmt : *(node->statement_list)) dispatch(stmt);
+  loopDepth--;
+  emitLine(node->expression);
+  dispatch(node->expression);
 
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  cmp $1, %eax" << std::endl;
-  std::cout << "  je " << startLabel << std::endl;
-  std::cout << exitLabel << ":" << std::endl;
+  *out << "  pop %eax" << std::endl;
+  emitBranchCount(node);
+  *out << "  cmp $1, %eax" << std::endl;
+  *out << "  je " << startLabel << std::endl;
+  *out << exitLabel << ":" << std::endl;
 }
 
 void CodeGenerator::visitPlusNode(PlusNode* node) {
-  node->visit_children(this);
-  std::cout << "# PLUS" << std::endl;
-  std::cout << "  pop %ebx" << std::endl;
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  add %ebx, %eax" << std::endl;
-  std::cout << "  push %eax" << std::endl;
+  if (emitFolded(node)) return;
+  visit_children(node);
+  *out << "# PLUS" << std::endl;
+  *out << "  pop %ebx" << std::endl;
+  *out << "  pop %eax" << std::endl;
+  *out << "  add %ebx, %eax" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 void CodeGenerator::visitMinusNode(MinusNode* node) {
-  node->visit_children(this);
-  std::cout << "# MINUS" << std::endl;
-  std::cout << "  pop %ebx" << std::endl;
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  sub %ebx, %eax" << std::endl;
-  std::cout << "  push %eax" << std::endl;
+  if (emitFolded(node)) return;
+  visit_children(node);
+  *out << "# MINUS" << std::endl;
+  *out << "  pop %ebx" << std::endl;
+  *out << "  pop %eax" << std::endl;
+  *out << "  sub %ebx, %eax" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 void CodeGenerator::visitTimesNode(TimesNode* node) {
-  node->visit_children(this);
-  std::cout << "# TIMES" << std::endl;
-  std::cout << "  pop %ebx" << std::endl;
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  imul %ebx, %eax" << std::endl;
-  std::cout << "  push %eax" << std::endl;
+  if (emitFolded(node)) return;
+  visit_children(node);
+  *out << "# TIMES" << std::endl;
+  *out << "  pop %ebx" << std::endl;
+  *out << "  pop %eax" << std::endl;
+  *out << "  imul %ebx, %eax" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 void CodeGenerator::visitDivideNode(DivideNode* node) {
-  node->visit_children(this);
-  std::cout << "# DIVIDE" << std::endl;
-  std::cout << "  pop %ebx" << std::endl;
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  cdq" << std::endl;
-  std::cout << "  idiv %ebx" << std::endl;
-  std::cout << "  push %eax" << std::endl;
+  if (emitFolded(node)) return;
+  visit_children(node);
+  *out << "# DIVIDE" << std::endl;
+  *out << "  pop %ebx" << std::endl;
+  *out << "  pop %eax" << std::endl;
+  *out << "  cdq" << std::endl;
+  *out << "  idiv %ebx" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 void CodeGenerator::visitGreaterNode(GreaterNode* node) {
-  node->visit_children(this);
-  std::string tLabel = "label_" + std::to_string(nextLabel());
-  std::string eLabel = "label_" + std::to_string(nextLabel());
-
-  std::cout << "# GREATER" << std::endl;
-  std::cout << "  pop %ebx" << std::endl;
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  cmp %ebx, %eax" << std::endl;
-  std::cout << "  jg " << tLabel << std::endl;
-  std::cout << "  push $0" << std::endl;
-  std::cout << "  jmp " << eLabel << std::endl;
-  std::cout << tLabel << ":" << std::endl;
-  std::cout << "  push $1" << std::endl;
-  std::cout << eLabel << ":" << std::endl;
+  if (emitFolded(node)) return;
+  visit_children(node);
+  *out << "# GREATER" << std::endl;
+  emitComparison("jg", "__lang_greater");
 }
 
 void CodeGenerator::visitGreaterEqualNode(GreaterEqualNode* node) {
-  node->visit_children(this);
-  std::string tLabel = "label_" + std::to_string(nextLabel());
-  std::string eLabel = "label_" + std::to_string(nextLabel());
-
-  std::cout << "# GREATER EQUAL" << std::endl;
-
-  std::cout << "  pop %ebx" << std::endl;
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  cmp %ebx, %eax" << std::endl;
-  std::cout << "  jge " << tLabel << std::endl;
-  std::cout << "  push $0" << std::endl;
-  std::cout << "  jmp " << eLabel << std::endl;
-  std::cout << tLabel << ":" << std::endl;
-  std::cout << "  push $1" << std::endl;
-  std::cout << eLabel << ":" << std::endl;
+  if (emitFolded(node)) return;
+  visit_children(node);
+  *out << "# GREATER EQUAL" << std::endl;
+  emitComparison("jge", "__lang_greater_equal");
 }
 
 void CodeGenerator::visitEqualNode(EqualNode* node) {
-  node->visit_children(this);
-  std::string tLabel = "label_" + std::to_string(nextLabel());
-  std::string eLabel = "label_" + std::to_string(nextLabel());
-
-  std::cout << "# EQUAL" << std::endl;
-
-  std::cout << "  pop %ebx" << std::endl;
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  cmp %ebx, %eax" << std::endl;
-  std::cout << "  je " << tLabel << std::endl;
-  std::cout << "  push $0" << std::endl;
-  std::cout << "  jmp " << eLabel << std::endl;
-  std::cout << tLabel << ":" << std::endl;
-  std::cout << "  push $1" << std::endl;
-  std::cout << eLabel << ":" << std::endl;
+  if (emitFolded(node)) return;
+  visit_children(node);
+  *out << "# EQUAL" << std::endl;
+  emitComparison("je", "__lang_equal");
 }
 
 void CodeGenerator::visitAndNode(AndNode* node) {
-  node->visit_children(this);
+  if (emitFolded(node)) return;
+  visit_children(node);
 
-  std::cout << "# AND" << std::endl;
+  *out << "# AND" << std::endl;
 
-  std::cout << "  pop %ebx" << std::endl;
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  and %ebx, %eax" << std::endl;
-  std::cout << "  push %eax" << std::endl;
+  *out << "  pop %ebx" << std::endl;
+  *out << "  pop %eax" << std::endl;
+  *out << "  and %ebx, %eax" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 void CodeGenerator::visitOrNode(OrNode* node) {
-  node->visit_children(this);
+  if (emitFolded(node)) return;
+  visit_children(node);
 
-  std::cout << "# OR" << std::endl;
+  *out << "# OR" << std::endl;
 
-  std::cout << "  pop %ebx" << std::endl;
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  or %ebx, %eax" << std::endl;
-  std::cout << "  push %eax" << std::endl;
+  *out << "  pop %ebx" << std::endl;
+  *out << "  pop %eax" << std::endl;
+  *out << "  or %ebx, %eax" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 void CodeGenerator::visitNotNode(NotNode* node) {
-  node->visit_children(this);
+  if (emitFolded(node)) return;
+  visit_children(node);
 
-  std::cout << "# NOT" << std::endl;
+  *out << "# NOT" << std::endl;
 
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  xor $1, %eax" << std::endl;
-  std::cout << "  push %eax" << std::endl;
+  *out << "  pop %eax" << std::endl;
+  *out << "  xor $1, %eax" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 void CodeGenerator::visitNegationNode(NegationNode* node) {
-  node->visit_children(this);
+  if (emitFolded(node)) return;
+  visit_children(node);
 
-  std::cout << "# NEGATION" << std::endl;
+  *out << "# NEGATION" << std::endl;
 
-  std::cout << "  pop %eax" << std::endl;
-  std::cout << "  neg %eax" << std::endl;
-  std::cout << "  push %eax" << std::endl;
+  *out << "  pop %eax" << std::endl;
+  *out << "  neg %eax" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 void CodeGenerator::visitMethodCallNode(MethodCallNode* node) {
-  node->expression_list->reverse();
-  node->visit_children(this);
-
-  std::cout << "# CALLING METHOD "
-            << (node->identifier_2 ? node->identifier_2->name + "." : "")
-            << node->identifier_1->name << std::endl;
-
   // Pattern: foo()
   std::string className = currentClassName;
   ClassInfo classInfo = currentClassInfo;
@@ -345,7 +1147,7 @@ void CodeGenerator::visitMethodCallNode(MethodCallNode* node) {
             ->at(node->identifier_1->name);
 
     className = var.type.objectClassName;
-    classInfo = classTable->at(className);
+    classInfo = lookupClass(className);
     methodName = node->identifier_2->name;
     offset = var.offset;
   }
@@ -353,18 +1155,35 @@ void CodeGenerator::visitMethodCallNode(MethodCallNode* node) {
   // Search class and superclasses for method.
   while (!classInfo.methods->count(methodName)) {
     className = classInfo.superClassName;
-    classInfo = classTable->at(className);
+    classInfo = lookupClass(className);
+  }
+
+  std::vector<bool> isConstant;
+  std::string symbol = specialize(node, className, methodName, isConstant);
+
+  // Push arguments right to left, leaving out the ones a
+  // specialized callee has folded in.
+  int index = node->expression_list->size();
+  int pushed = 0;
+  for (auto arg = node->expression_list->rbegin();
+       arg != node->expression_list->rend(); ++arg) {
+    if (isConstant[--index]) continue;
+    dispatch(*arg);
+    pushed++;
   }
 
-  std::cout << "  push " << offset << "(%ebp)" << std::endl;
-  std::cout << "  call " << className << "_" << methodName << std::endl;
-  std::cout << "  add $" << 4 * (node->expression_list->size() + 1 ) << ", %esp"
-            << std::endl;
-  std::cout << "  push %eax" << std::endl;
+  *out << "# CALLING METHOD "
+       << (node->identifier_2 ? node->identifier_2->name + "." : "")
+       << node->identifier_1->name << std::endl;
+
+  *out << "  push " << offset << "(%ebp)" << std::endl;
+  *out << "  call " << symbol << std::endl;
+  *out << "  add $" << 4 * (pushed + 1) << ", %esp" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 void CodeGenerator::visitMemberAccessNode(MemberAccessNode* node) {
-  std::cout << "  # ACCESSING MEMBER: " << node->identifier_1->name << "." << node->identifier_2->name << std::endl;
+  *out << "  # ACCESSING MEMBER: " << node->identifier_1->name << "." << node->identifier_2->name << std::endl;
 
   int offset = 0;
   ClassInfo id2Class;
@@ -373,55 +1192,56 @@ void CodeGenerator::visitMemberAccessNode(MemberAccessNode* node) {
   if (currentMethodInfo.variables->count(node->identifier_1->name)) {
     VariableInfo var = currentMethodInfo.variables->at(node->identifier_1->name);
     offset = var.offset;
-    std::cout << "  mov "<< offset <<"(%ebp), %ecx" << std::endl;
-		id2Class = classTable->at(var.type.objectClassName);
+    *out << "  mov "<< offset <<"(%ebp), %ecx" << std::endl;
+		id2Class = lookupClass(var.type.objectClassName);
   }
 
   // identifier_1 is a member variable
   else {
     // Find class for identifier_1
-    ClassInfo classInfo = classTable->at(currentClassName);
+    ClassInfo classInfo = lookupClass(currentClassName);
     while (!classInfo.members->count(node->identifier_1->name)) {
-      classInfo = classTable->at(classInfo.superClassName);
+      classInfo = lookupClass(classInfo.superClassName);
     }
 
     // Calculate offset based on superclasses
     VariableInfo var = classInfo.members->at(node->identifier_1->name);
     offset = var.offset;
 		while (!classInfo.superClassName.empty()) {
-      classInfo = classTable->at(classInfo.superClassName);
+      classInfo = lookupClass(classInfo.superClassName);
 			offset += classInfo.membersSize;
 		}
 
-    id2Class = classTable->at(var.type.objectClassName);
-		std::cout << "  mov 8(%ebp), %ebx" << std::endl;
-		std::cout << "  mov " << offset << "(%ebx), %ecx" << std::endl;
+    id2Class = lookupClass(var.type.objectClassName);
+		*out << "  mov 8(%ebp), %ebx" << std::endl;
+		*out << "  mov " << offset << "(%ebx), %ecx" << std::endl;
   }
 
   while (!id2Class.members->count(node->identifier_2->name)) {
-    id2Class = classTable->at(id2Class.superClassName);
+    id2Class = lookupClass(id2Class.superClassName);
   }
   VariableInfo var = id2Class.members->at(node->identifier_2->name);
   offset = var.offset;
 
   // Calculate offset based on superclasses
 	while (!id2Class.superClassName.empty()) {
-    id2Class = classTable->at(id2Class.superClassName);
+    id2Class = lookupClass(id2Class.superClassName);
 		offset += id2Class.membersSize;
 	}
 
-	std::cout << "  mov "<< offset << "(%ecx), %eax" << std::endl;
-  std::cout << "  push %eax" << std::endl;
+	*out << "  " << loadMember(var) << offset << "(%ecx), %eax" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 // CHECK - A
 void CodeGenerator::visitVariableNode(VariableNode* node) {
-  std::cout << "# LOAD VARIABLE " << node->identifier->name << std::endl;
+  if (emitFolded(node)) return;
+  *out << "# LOAD VARIABLE " << node->identifier->name << std::endl;
 
   // Local Variable
   if (currentMethodInfo.variables->count(node->identifier->name)) {
     int offset = currentMethodInfo.variables->at(node->identifier->name).offset;
-    std::cout << "   movl " << offset << "(%ebp), %eax" << std::endl;
+    *out << "   movl " << offset << "(%ebp), %eax" << std::endl;
   }
 
   // Member Variable
@@ -429,32 +1249,44 @@ void CodeGenerator::visitVariableNode(VariableNode* node) {
     ClassInfo classInfo = currentClassInfo;
     // Find member in class heirarchy
     while (!classInfo.members->count(node->identifier->name)) {
-      classInfo = classTable->at(classInfo.superClassName);
+      classInfo = lookupClass(classInfo.superClassName);
     }
 
     // Offset within member class
-    int offset = classInfo.members->at(node->identifier->name).offset;
+    VariableInfo var = classInfo.members->at(node->identifier->name);
+    int offset = var.offset;
     // Offset of other super classes
     while (!classInfo.superClassName.empty()) {
-      classInfo = classTable->at(classInfo.superClassName);
+      classInfo = lookupClass(classInfo.superClassName);
       offset += classInfo.membersSize;
     }
 
-    std::cout << "  movl " << "8(%ebp), %eax" << std::endl;
-    std::cout << "  movl " << offset << "(%eax), %eax" << std::endl;
+    // Past 127 the offset takes four bytes, and the load is
+    // longer than a call to a shared copy of it.
+    if (options.optimizeSize && offset > 127) {
+      std::string name = "__lang_this_" + std::to_string(offset) +
+                         (var.size == 1 ? "b" : "");
+      *out << "  call "
+           << thunk(name, "  movl 8(%ebp), %eax\n  " + loadMember(var) +
+                              std::to_string(offset) + "(%eax), %eax\n  ret\n")
+           << std::endl;
+    } else {
+      *out << "  movl " << "8(%ebp), %eax" << std::endl;
+      *out << "  " << loadMember(var) << offset << "(%eax), %eax" << std::endl;
+    }
   }
 
-  std::cout << "  push %eax" << std::endl;
+  *out << "  push %eax" << std::endl;
 }
 
 void CodeGenerator::visitIntegerLiteralNode(IntegerLiteralNode* node) {
-  std::cout << "# INTEGER" << std::endl;
-  std::cout << "  push $" << node->integer->value << std::endl;
+  *out << "# INTEGER" << std::endl;
+  *out << "  push $" << node->integer->value << std::endl;
 }
 
 void CodeGenerator::visitBooleanLiteralNode(BooleanLiteralNode* node) {
-  std::cout << "# BOOLEAN" << std::endl;
-  std::cout << "  push $" << node->integer->value << std::endl;
+  *out << "# BOOLEAN" << std::endl;
+  *out << "  push $" << node->integer->value << std::endl;
 }
 
 // CHECK - A
@@ -462,35 +1294,41 @@ void CodeGenerator::visitNewNode(NewNode* node) {
   int stackOffset =
       node->expression_list ? 4 * (node->expression_list->size() + 1) : 4;
 
-  ClassInfo classInfo = classTable->at(node->identifier->name);
+  ClassInfo classInfo = lookupClass(node->identifier->name);
   bool hasConstructor = classInfo.methods->count(node->identifier->name);
   int size = classInfo.membersSize;
 	while (!classInfo.superClassName.empty()) {
-    classInfo = classTable->at(classInfo.superClassName);
+    classInfo = lookupClass(classInfo.superClassName);
 		size += classInfo.membersSize;
 	}
 
-  std::cout << "# NEW" << std::endl;
+  *out << "# NEW" << std::endl;
 
-  std::cout << "  push $" << size << std::endl;
-  std::cout << "  call malloc" << std::endl;
-  std::cout << "  add $4, %esp" << std::endl;
-  std::cout << "  push %eax" << std::endl;
+  if (options.profileAllocations) {
+    emitAllocationSite(node->identifier->name, size, node->lineno);
+  } else {
+    *out << "  push $" << size << std::endl;
+    *out << "  call malloc" << std::endl;
+    *out << "  add $4, %esp" << std::endl;
+  }
+  *out << "  push %eax" << std::endl;
 
   if (hasConstructor) {
-    if (node->expression_list) node->expression_list->reverse();
-    node->visit_children(this);
+    if (node->expression_list)
+      for (auto arg = node->expression_list->rbegin();
+           arg != node->expression_list->rend(); ++arg)
+        dispatch(*arg);
 
-    std::cout << "  mov "
-              << (node->expression_list
+    *out << "  mov "
+         << (node->expression_list
                       ? std::to_string(node->expression_list->size() * 4)
                       : "")
-              << "(%esp), %eax" << std::endl;
+         << "(%esp), %eax" << std::endl;
 
-    std::cout << "  push %eax" << std::endl;
-    std::cout << "  call " << node->identifier->name << "_"
-              << node->identifier->name << std::endl;
-    std::cout << "  add $" << stackOffset << ", %esp" << std::endl;
+    *out << "  push %eax" << std::endl;
+    *out << "  call " << node->identifier->name << "_"
+         << node->identifier->name << std::endl;
+    *out << "  add $" << stackOffset << ", %esp" << std::endl;
   }
 }
 
@@ -3,6 +3,46 @@
 
 #include "ast.hpp"
 #include "typecheck.hpp"
+#include "options.hpp"
+#include "evaluator.hpp"
+#include "profile.hpp"
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+
+// Defines a clone of a method specialized on the constant
+// arguments of a call site. The symbol encodes the constants
+// (e.g. Class_method__c10_1), with "x" for any argument which
+// is still passed at run time.
+typedef struct specialization {
+  std::string className;
+  std::string methodName;
+  std::string symbol;
+  MethodNode* method;
+  std::vector<bool> isConstant;
+  std::vector<int> values;
+} Specialization;
+
+// Defines the code generated for one method (or specialized
+// clone), everything after its label, and the clones it calls
+// which had not been generated before. Methods are generated
+// into their own buffers and written out together at the end
+// of the program, which lets them be compared and reordered.
+typedef struct generatedmethod {
+  std::string symbol;
+  std::string code;
+  std::vector<Specialization> clones;
+  // With --incremental, what the code was generated from (see
+  // incremental.hpp), by name with its digest, and the helper
+  // routines it calls.
+  std::map<std::string, std::string> dependencies;
+  std::set<std::string> thunkNames;
+} GeneratedMethod;
+
+class IncrementalState;
 
 // This defines the CodeGenerator visitor, which will visit
 // the AST and generate x86 assembly code. You will do all
@@ -13,10 +53,21 @@
 // which means the symbol table will already be completely
 // constructed when generating code. You will need to use
 // the symbol table when generating code.
-class CodeGenerator : public Visitor {
+class CodeGenerator final : public Visitor, public StaticVisitor<CodeGenerator> {
 private:
+  // Labels are named after their method and what they mark, and
+  // numbered from zero in each method (.LClass_method_while_N), so
+  // the code of a method does not depend on the methods generated
+  // before it. With -g, the source line last given by .loc.
   int currentLabel;
+  std::string currentSymbol;
+  int currentLine;
 public:
+  // The stream code is currently being written to: the output
+  // (std::cout unless the main file sets it), or the buffer of
+  // the method being generated.
+  std::ostream* out;
+
   // This member is the ClassTable pointer for the symbol
   // table. The main file sets this appropraitely to the
   // root of the symbol table constructed by the TypeCheck
@@ -38,12 +89,108 @@ public:
   std::string currentMethodName;
   ClassInfo currentClassInfo;
   MethodInfo currentMethodInfo;
-  
-  int nextLabel() {
-    return currentLabel++;
+
+  // The options the compiler was invoked with, and the name of
+  // the source file (for -g). The main file sets these along with
+  // the class table.
+  CompilerOptions options;
+  std::string sourceFile;
+
+  // The methods generated so far, in order, and the helper
+  // routines (see -Os) which they call.
+  std::vector<GeneratedMethod> generatedMethods;
+  std::map<std::string, std::string> thunks;
+  std::set<std::string> methodThunks;
+
+  void emitMethods();
+  std::string thunk(std::string name, std::string code);
+  void emitComparison(std::string jump, std::string thunkName);
+
+  // These members drive function specialization. Method nodes
+  // are indexed by symbol so clones can be generated after the
+  // rest of the program, and while a clone is being generated
+  // its constant parameters are folded wherever they are used.
+  // The clones requested by the method being generated are kept
+  // apart from the ones generated before, and only added to them
+  // once all the methods of a round are done. cloneBudget is how
+  // many new clones the method may request (see generateRound).
+  std::map<std::string, MethodNode*> methodNodes;
+  std::set<std::string> specializedSymbols;
+  std::vector<Specialization> pendingSpecializations;
+  std::map<std::string, int> constantParameters;
+  int loopDepth;
+  int cloneBudget;
+
+  // The result of evaluating Main.main ahead of time, if the
+  // main file ran the Evaluator (NULL otherwise).
+  EvaluationResult* evaluation;
+  void emitWrite(std::string output);
+
+  // Profiling. Each method body and branch has an entry in the
+  // table of counters (see --profile-generate), and each method
+  // body a number for its timer (see --profile). With --profile-use
+  // the main file sets the profile (NULL otherwise). Code which
+  // never ran in the profile is collected in coldCode, and written
+  // after the rest of the method.
+  std::map<ASTNode*, int> profileEntries;
+  std::vector<std::string> profileNames;
+  std::map<ASTNode*, int> timerNumbers;
+  std::vector<std::string> timerNames;
+  Profile* profile;
+  std::string coldCode;
+  void numberProfileEntries(ProgramNode* node);
+  std::string profileCounter(ASTNode* node, int counter);
+  void emitBranchCount(StatementNode* node);
+  void emitProfileTable();
+  void emitTimerTable();
+  void emitAllocationSite(std::string className, int size, int line);
+  BranchCount branchCount(StatementNode* node);
+
+  void emitMemoEntry(int parameters, int argumentOffset, std::string table);
+  void emitMemoLookup(std::string symbol, int parameters);
+
+  bool foldConstant(ExpressionNode* node, int& value);
+  bool emitFolded(ExpressionNode* node);
+  std::string specialize(MethodCallNode* node, std::string className,
+                         std::string methodName, std::vector<bool>& isConstant);
+
+  // Methods are generated in rounds: first the methods of the
+  // program, then the clones they call, then the clones those
+  // call, and so on. The methods of a round are shared out among
+  // options.jobs threads, each with its own generator.
+  GeneratedMethod generateMethod(const Specialization& method);
+  void generateRound(std::vector<Specialization>& round);
+
+  // With --incremental, the methods of the last compilation (NULL
+  // otherwise), which generateRound takes unchanged methods from.
+  // The classes and callees a method looks up are recorded as it
+  // is generated.
+  IncrementalState* incremental;
+  std::set<std::string> dependencies;
+  const ClassInfo& lookupClass(const std::string& className);
+
+  // Begin and end the code of a program. visitProgramNode generates
+  // all its methods in between, and a compilation which hands over
+  // the classes one at a time as they are parsed (see compiler.cpp)
+  // generates the methods of each class with generateClass, which
+  // does not keep the class's tree. Methods are still written out
+  // together at the end, so the output is the same either way as
+  // long as nothing needs the whole tree: specialization, profiles
+  // and ahead-of-time evaluation do.
+  void beginProgram();
+  void addMethods(ClassNode* node, std::vector<Specialization>& round);
+  void generateClass(ClassNode* node);
+  void endProgram();
+
+  std::string newLabel(std::string kind) {
+    return ".L" + currentSymbol + "_" + kind + "_" +
+           std::to_string(currentLabel++);
   }
+  void emitLine(ASTNode* node);
   
-  CodeGenerator() : currentLabel(0) {}
+  CodeGenerator()
+      : currentLabel(0), currentLine(0), out(&std::cout), loopDepth(0),
+        cloneBudget(0), evaluation(NULL), profile(NULL), incremental(NULL) {}
   
   // All the visitor functions. You will need to write
   // appropriate implementation in codegeneration.cpp.
@@ -0,0 +1,303 @@
+#include "compiler.hpp"
+#include "codegeneration.hpp"
+#include "cgeneration.hpp"
+#include "evaluator.hpp"
+#include "interface.hpp"
+#include "purity.hpp"
+#include "x86asm.hpp"
+#include "parser.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <sstream>
+
+static void beginPhase(TimeReport* report, const std::string& phase) {
+    if (report) report->begin(phase);
+}
+
+// Whether each method can be generated without the others:
+// profiles number the whole program, and ahead-of-time evaluation
+// runs it.
+static bool methodsIndependent(const CompilerOptions& options,
+                               const CompileContext& context) {
+    return !options.aotEvaluate && !context.profile &&
+           !options.profileGenerate && !options.profileTimers;
+}
+
+static void useIncremental(CodeGenerator* codegen,
+                           const CompilerOptions& options,
+                           const CompileContext& context) {
+    if (!context.incremental || !methodsIndependent(options, context))
+        return;
+    context.incremental->lines =
+        options.debugLines || options.profileAllocations;
+    codegen->incremental = context.incremental;
+}
+
+// Type checks and generates the code of a parsed program into
+// result.
+static void generate(ProgramNode* program, const CompilerOptions& options,
+                     const CompileContext& context, CompileResult& result) {
+    TimeReport* report = context.timeReport;
+    beginPhase(report, "typecheck");
+    TypeCheck typecheck;
+    typecheck.options = options;
+    if (context.imports) typecheck.imports = *context.imports;
+    program->accept(&typecheck);
+    ClassTable* classTable = typecheck.classTable;
+    // Uncomment the following line to print the class table after it is generated
+    //print(*classTable);
+    if (report) report->countSymbols(classTable, program);
+
+    std::ostringstream code;
+    if (options.emit == emit_c) {
+        beginPhase(report, "codegen");
+        CGenerator cgen;
+        cgen.classTable = classTable;
+        cgen.options = options;
+        cgen.out = &code;
+        program->accept(&cgen);
+        beginPhase(report, "output");
+        result.output = code.str();
+        result.interface = writeInterface(classTable, program);
+        return;
+    }
+    if (options.memoize) {
+        beginPhase(report, "purity");
+        PurityCheck purity;
+        purity.classTable = classTable;
+        program->accept(&purity);
+    }
+    CodeGenerator codegen;
+    codegen.classTable = classTable;
+    codegen.options = options;
+    codegen.profile = context.profile;
+    codegen.sourceFile = context.sourceFile;
+
+    EvaluationResult evaluation;
+    if (options.aotEvaluate) {
+        beginPhase(report, "evaluate");
+        Evaluator evaluator(classTable, options.aotStepBudget,
+                            options.aotMemoryBudget);
+        evaluation = evaluator.evaluate(program);
+        if (evaluation.complete || options.aotFoldPrefix)
+            codegen.evaluation = &evaluation;
+    }
+    useIncremental(&codegen, options, context);
+    beginPhase(report, "codegen");
+    codegen.out = &code;
+    program->accept(&codegen);
+    beginPhase(report, "output");
+    if (options.emit == emit_object)
+        result.output = assemble(code.str());
+    else
+        result.output = code.str();
+    result.interface = writeInterface(classTable, program);
+}
+
+// Type checks and generates the code of a program one class at a
+// time, as the parser hands them over (see CompilerOptions::streaming).
+// The nodes of each class are deleted once its methods are
+// generated, and the next class is parsed into their memory.
+class ClassPipeline {
+private:
+    const CompilerOptions& options;
+    const CompileContext& context;
+    ASTArena& arena;
+    ASTArena::Mark start;
+    TypeCheck typecheck;
+    PurityCheck purity;
+    CodeGenerator codegen;
+    std::ostringstream code;
+    std::vector<std::string> classNames;
+
+public:
+    // The first error, rethrown by finish. The classes after it are
+    // only parsed, as a syntax error in them comes first.
+    std::exception_ptr error;
+
+    ClassPipeline(const CompilerOptions& options,
+                  const CompileContext& context, ASTArena& arena);
+    void addClass(ClassNode* node);
+    void finish(CompileResult& result);
+};
+
+ClassPipeline::ClassPipeline(const CompilerOptions& options,
+                             const CompileContext& context, ASTArena& arena)
+    : options(options), context(context), arena(arena), start(arena.mark()) {
+    typecheck.options = options;
+    if (context.imports) typecheck.imports = *context.imports;
+    typecheck.beginProgram();
+    purity.classTable = typecheck.classTable;
+    codegen.classTable = typecheck.classTable;
+    codegen.options = options;
+    codegen.sourceFile = context.sourceFile;
+    codegen.out = &code;
+    useIncremental(&codegen, options, context);
+    codegen.beginProgram();
+}
+
+void ClassPipeline::addClass(ClassNode* node) {
+    TimeReport* report = context.timeReport;
+    if (report) report->countNodes(node);
+    if (!error) {
+        try {
+            beginPhase(report, "typecheck");
+            node->accept(&typecheck);
+            std::string className = node->identifier_1->name;
+            classNames.push_back(className);
+            if (report) report->countSymbols(typecheck.classTable, className);
+            // The methods of a class only call those of the classes
+            // before it, which are already marked.
+            if (options.memoize) {
+                beginPhase(report, "purity");
+                std::vector<ClassNode*> classes(1, node);
+                purity.checkClasses(&classes);
+            }
+            beginPhase(report, "codegen");
+            codegen.generateClass(node);
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    arena.release(start);
+    beginPhase(report, "parse");
+}
+
+void ClassPipeline::finish(CompileResult& result) {
+    if (error) std::rethrow_exception(error);
+    TimeReport* report = context.timeReport;
+    beginPhase(report, "typecheck");
+    typecheck.endProgram();
+    beginPhase(report, "codegen");
+    codegen.endProgram();
+    beginPhase(report, "output");
+    if (options.emit == emit_object)
+        result.output = assemble(code.str());
+    else
+        result.output = code.str();
+    code.str("");
+    result.interface = writeInterface(typecheck.classTable, classNames);
+}
+
+bool setOption(CompilerOptions& options, const std::string& argument) {
+    const char* arg = argument.c_str();
+    if (!strncmp(arg, "-j", 2)) {
+        options.jobs = atoi(arg + 2);
+    } else if (!strcmp(arg, "--compact-layout")) {
+        options.compactLayout = true;
+    } else if (!strcmp(arg, "--specialize")) {
+        options.specialize = true;
+    } else if (!strcmp(arg, "--aot-eval")) {
+        options.aotEvaluate = true;
+    } else if (!strcmp(arg, "--aot-prefix")) {
+        options.aotEvaluate = true;
+        options.aotFoldPrefix = true;
+    } else if (!strncmp(arg, "--aot-steps=", 12)) {
+        options.aotStepBudget = atoll(arg + 12);
+    } else if (!strncmp(arg, "--aot-memory=", 13)) {
+        options.aotMemoryBudget = atoll(arg + 13);
+    } else if (!strcmp(arg, "--memoize")) {
+        options.memoize = true;
+    } else if (!strncmp(arg, "--memo-size=", 12)) {
+        options.memoTableSize = 1;
+        while (options.memoTableSize < atoi(arg + 12))
+            options.memoTableSize *= 2;
+    } else if (!strcmp(arg, "--emit=asm")) {
+        options.emit = emit_assembly;
+    } else if (!strcmp(arg, "--emit=obj")) {
+        options.emit = emit_object;
+    } else if (!strcmp(arg, "--emit=c")) {
+        options.emit = emit_c;
+    } else if (!strcmp(arg, "--profile")) {
+        options.profileTimers = true;
+    } else if (!strcmp(arg, "--profile-alloc")) {
+        options.profileAllocations = true;
+    } else if (!strcmp(arg, "--profile-generate")) {
+        options.profileGenerate = true;
+    } else if (!strcmp(arg, "--no-stream")) {
+        options.streaming = false;
+    } else if (!strcmp(arg, "-g")) {
+        options.debugLines = true;
+    } else if (!strcmp(arg, "-Os")) {
+        options.optimizeSize = true;
+    } else if (!strncmp(arg, "-O", 2)) {
+        options.optimizationLevel = atoi(arg + 2);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string checkOptions(CompilerOptions& options) {
+    if (options.optimizationLevel >= 1) options.specialize = true;
+    if (options.optimizationLevel >= 2) options.memoize = true;
+    if (options.optimizeSize) {
+        options.specialize = false;
+        options.memoize = false;
+    }
+    // Profiles must see the program run, and every call: a memo
+    // hit returns before the method is counted or timed.
+    if (options.profileGenerate || options.profileTimers ||
+        options.profileAllocations) {
+        if (options.emit == emit_c)
+            return "Profiling needs assembly or an object";
+        options.aotEvaluate = false;
+        options.memoize = false;
+    }
+    return "";
+}
+
+CompileResult compile(const std::string& source,
+                      const CompilerOptions& options) {
+    return compile(source, options, CompileContext());
+}
+
+CompileResult compile(const std::string& source,
+                      const CompilerOptions& options,
+                      const CompileContext& context) {
+    CompileResult result;
+    TimeReport* report = context.timeReport;
+    // Holds the tree until the compilation is over.
+    ASTArena arena;
+    ParseState state;
+    std::unique_ptr<ClassPipeline> pipeline;
+    if (options.streaming && methodsIndependent(options, context) &&
+        !options.specialize && options.emit != emit_c) {
+        pipeline.reset(new ClassPipeline(options, context, arena));
+        state.classParsed = [&](ClassNode* node) { pipeline->addClass(node); };
+    }
+    beginPhase(report, "parse");
+    bool parsed = parseProgram(source, state);
+    result.lines = state.lines;
+    if (report) {
+        report->end();
+        report->lines += state.lines;
+        if (state.root) report->countNodes(state.root);
+    }
+    if (!parsed) {
+        result.error = state.error;
+        return result;
+    }
+
+    try {
+        if (pipeline)
+            pipeline->finish(result);
+        else
+            generate((ProgramNode*)state.root, options, context, result);
+    } catch (const CompileError& error) {
+        result.output.clear();
+        result.interface.clear();
+        result.error = error.what();
+    } catch (const std::exception& error) {
+        // A bug in the compiler, which fails this compilation only.
+        result.output.clear();
+        result.interface.clear();
+        result.error = std::string("Internal compiler error: ") + error.what();
+    }
+    if (report) report->end();
+    result.success = result.error.empty();
+    return result;
+}
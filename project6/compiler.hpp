@@ -0,0 +1,68 @@
+#ifndef __COMPILER_HPP
+#define __COMPILER_HPP
+
+#include "incremental.hpp"
+#include "options.hpp"
+#include "profile.hpp"
+#include "timereport.hpp"
+#include "typecheck.hpp"
+
+#include <string>
+
+// The compiler as a library. compile() keeps no state of its own
+// between calls and reports errors in its result instead of
+// exiting, so a process can compile any number of programs, on as
+// many threads as it likes. The main file is a command line around
+// it.
+
+// Defines what compiling a program produced. When it failed, error
+// holds the first error (a syntax error with its line, a type
+// error, an error in an import or the profile, or an internal
+// error of the compiler) and output is empty.
+typedef struct compileresult {
+  bool success = false;
+  // The assembly, object or C source, as options.emit asks.
+  std::string output;
+  // The interface of the program's classes (see interface.hpp).
+  std::string interface;
+  std::string error;
+  int lines = 0;
+} CompileResult;
+
+// Defines what a program is compiled with besides its source and
+// the options. The imports and the profile are only read, so they
+// can be shared by compilations on several threads; a time report
+// cannot.
+typedef struct compilecontext {
+  // The classes of the other source files of a separate
+  // compilation, read from their interfaces.
+  const ClassTable* imports = NULL;
+  // The profile for --profile-use.
+  Profile* profile = NULL;
+  // The name of the source file, for -g and --profile-alloc.
+  std::string sourceFile = "<stdin>";
+  // Where to add the times of the phases, for --time-report.
+  TimeReport* timeReport = NULL;
+  // The methods of the last compilation, for --incremental. It is
+  // updated with those of this one, so it cannot be shared either.
+  IncrementalState* incremental = NULL;
+} CompileContext;
+
+// Sets the option a command line argument names, for all options
+// but --profile-use and those of the main file itself. Returns false
+// if the argument is not one.
+bool setOption(CompilerOptions& options, const std::string& argument);
+
+// Checks that options go together, once all of them are set: turns
+// the optimization level into the optimizations it includes, and
+// adjusts those which give way to others. Returns the error if they
+// do not go together.
+std::string checkOptions(CompilerOptions& options);
+
+CompileResult compile(const std::string& source,
+                      const CompilerOptions& options);
+CompileResult compile(const std::string& source,
+                      const CompilerOptions& options,
+                      const CompileContext& context);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef __ERROR_HPP
+#define __ERROR_HPP
+
+#include <stdexcept>
+#include <string>
+
+// Errors in a program (type errors) and in the files it is compiled
+// with (interfaces, profiles, and the assembly for --emit=obj) are
+// thrown as a CompileError holding the message. compile() (see
+// compiler.hpp) catches them and returns the message, so that a
+// failed compilation does not end the process.
+class CompileError : public std::runtime_error {
+public:
+  explicit CompileError(const std::string& message)
+      : std::runtime_error(message) {}
+};
+
+#endif
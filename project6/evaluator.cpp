@@ -0,0 +1,420 @@
+#include "evaluator.hpp"
+
+#include <climits>
+
+// Calls nested deeper than this are assumed not to terminate.
+static const int maxCallDepth = 1000;
+
+Evaluator::Evaluator(ClassTable* classTable, long long stepBudget,
+                     long long memoryBudget)
+    : locals(NULL),
+      depth(0),
+      steps(0),
+      memory(0),
+      classTable(classTable),
+      stepBudget(stepBudget),
+      memoryBudget(memoryBudget) {
+  thisObject = {false, 0};
+}
+
+EvaluationResult Evaluator::evaluate(ProgramNode* program) {
+  EvaluationResult result{false, "", 0, {}};
+
+  for (auto classNode : *program->class_list) {
+    if (!classNode->method_list) continue;
+    for (auto method : *classNode->method_list)
+      methodNodes[classNode->identifier_1->name + "_" +
+                  method->identifier->name] = method;
+  }
+
+  if (!methodNodes.count("Main_main")) return result;
+  MethodBodyNode* body = methodNodes.at("Main_main")->methodbody;
+  std::map<std::string, Value> frame;
+  locals = &frame;
+  currentClassName = "Main";
+  currentMethodInfo = classTable->at("Main").methods->at("main");
+
+  try {
+    int statements = 0;
+    for (auto stmt : *body->statement_list) {
+      dispatch(stmt);
+      statements++;
+
+      // The prefix can only be folded where the generated code
+      // can pick up from it, which it cannot if it would need
+      // the objects referenced by Main.main's locals.
+      bool foldable = true;
+      for (auto& local : frame) {
+        VariableInfo var = currentMethodInfo.variables->at(local.first);
+        if (local.second.defined && var.type.baseType == bt_object)
+          foldable = false;
+      }
+      if (!foldable) continue;
+
+      result.foldedStatements = statements;
+      result.output = output;
+      result.locals.clear();
+      for (auto& local : frame)
+        if (local.second.defined)
+          result.locals[local.first] = local.second.integer;
+    }
+
+    if (body->returnstatement) {
+      dispatch(body->returnstatement);
+      pop();
+    }
+    result.complete = true;
+    result.output = output;
+  } catch (Stop&) {
+  }
+
+  return result;
+}
+
+void Evaluator::step() {
+  if (++steps > stepBudget) throw Stop();
+}
+
+Value Evaluator::pop() {
+  Value value = stack.back();
+  stack.pop_back();
+  return value;
+}
+
+void Evaluator::push(bool defined, int integer) {
+  stack.push_back({defined, integer});
+}
+
+int Evaluator::popDefined() {
+  Value value = pop();
+  if (!value.defined) throw Stop();
+  return value.integer;
+}
+
+// Finds a member in a class or its superclasses, returning its
+// offset within the whole object.
+int Evaluator::memberOffset(std::string className, std::string memberName,
+                            VariableInfo& var) {
+  ClassInfo classInfo = classTable->at(className);
+  while (!classInfo.members->count(memberName))
+    classInfo = classTable->at(classInfo.superClassName);
+
+  var = classInfo.members->at(memberName);
+  int offset = var.offset;
+  while (!classInfo.superClassName.empty()) {
+    classInfo = classTable->at(classInfo.superClassName);
+    offset += classInfo.membersSize;
+  }
+  return offset;
+}
+
+// Looks a name up the same way the generated code does: locals
+// and parameters first, then members of the current object.
+Value& Evaluator::variable(std::string name, VariableInfo& var) {
+  if (currentMethodInfo.variables->count(name)) {
+    var = currentMethodInfo.variables->at(name);
+    return (*locals)[name];
+  }
+  int offset = memberOffset(currentClassName, name, var);
+  if (!thisObject.defined) throw Stop();
+  return heap[thisObject.integer][offset];
+}
+
+Value Evaluator::call(std::string className, std::string methodName,
+                      Value object, std::vector<ExpressionNode*>* arguments) {
+  ClassInfo classInfo = classTable->at(className);
+  while (!classInfo.methods->count(methodName)) {
+    className = classInfo.superClassName;
+    classInfo = classTable->at(className);
+  }
+  // Methods of other source files cannot be evaluated.
+  if (!methodNodes.count(className + "_" + methodName)) throw Stop();
+  MethodNode* method = methodNodes.at(className + "_" + methodName);
+
+  // Arguments are evaluated right to left, as in the generated code.
+  std::vector<Value> values(arguments ? arguments->size() : 0);
+  int index = values.size();
+  if (arguments)
+    for (auto arg = arguments->rbegin(); arg != arguments->rend(); ++arg) {
+      dispatch(*arg);
+      values[--index] = pop();
+    }
+
+  if (++depth > maxCallDepth) throw Stop();
+
+  std::map<std::string, Value>* callerLocals = locals;
+  Value callerObject = thisObject;
+  std::string callerClassName = currentClassName;
+  MethodInfo callerMethodInfo = currentMethodInfo;
+
+  std::map<std::string, Value> frame;
+  for (auto param : *method->parameter_list)
+    frame[param->identifier->name] = values[index++];
+  locals = &frame;
+  thisObject = object;
+  currentClassName = className;
+  currentMethodInfo = classInfo.methods->at(methodName);
+
+  dispatch(method->methodbody);
+  Value result = pop();
+
+  locals = callerLocals;
+  thisObject = callerObject;
+  currentClassName = callerClassName;
+  currentMethodInfo = callerMethodInfo;
+  depth--;
+
+  return result;
+}
+
+void Evaluator::visitProgramNode(ProgramNode* node) {}
+
+void Evaluator::visitClassNode(ClassNode* node) {}
+
+void Evaluator::visitMethodNode(MethodNode* node) {}
+
+// Leaves the return value on the stack. Without a return statement
+// %eax holds whatever the last instruction left there.
+void Evaluator::visitMethodBodyNode(MethodBodyNode* node) {
+  for (auto stmt : *node->statement_list) dispatch(stmt);
+  if (node->returnstatement)
+    dispatch(node->returnstatement);
+  else
+    push(false, 0);
+}
+
+void Evaluator::visitParameterNode(ParameterNode* node) {}
+
+void Evaluator::visitDeclarationNode(DeclarationNode* node) {}
+
+void Evaluator::visitReturnStatementNode(ReturnStatementNode* node) {
+  step();
+  dispatch(node->expression);
+}
+
+void Evaluator::visitAssignmentNode(AssignmentNode* node) {
+  step();
+  dispatch(node->expression);
+  Value value = pop();
+
+  VariableInfo var;
+  Value& target = variable(node->identifier_1->name, var);
+  if (!node->identifier_2) {
+    target = value;
+    return;
+  }
+
+  if (!target.defined) throw Stop();
+  int offset = memberOffset(var.type.objectClassName,
+                            node->identifier_2->name, var);
+  heap[target.integer][offset] = value;
+}
+
+void Evaluator::visitCallNode(CallNode* node) {
+  step();
+  dispatch(node->methodcall);
+  pop();
+}
+
+void Evaluator::visitIfElseNode(IfElseNode* node) {
+  step();
+  dispatch(node->expression);
+  std::vector<StatementNode*>* taken =
+      popDefined() == 1 ? node->statement_list_1 : node->statement_list_2;
+  if (taken)
+    for (auto stmt : *taken) dispatch(stmt);
+}
+
+void Evaluator::visitWhileNode(WhileNode* node) {
+  for (;;) {
+    step();
+    dispatch(node->expression);
+    if (popDefined() != 1) break;
+    for (auto stmt : *node->statement_list) dispatch(stmt);
+  }
+}
+
+void Evaluator::visitDoWhileNode(DoWhileNode* node) {
+  do {
+    step();
+    for (auto stmt : *node->statement_list) dispatch(stmt);
+    dispatch(node->expression);
+  } while (popDefined() == 1);
+}
+
+// Objects print as their address, which is only known at run time.
+void Evaluator::visitPrintNode(PrintNode* node) {
+  step();
+  dispatch(node->expression);
+  int value = popDefined();
+  if (node->expression->basetype == bt_object) throw Stop();
+  output += std::to_string(value) + "\n";
+}
+
+void Evaluator::visitPlusNode(PlusNode* node) {
+  step();
+  visit_children(node);
+  unsigned b = popDefined();
+  unsigned a = popDefined();
+  push(true, (int)(a + b));
+}
+
+void Evaluator::visitMinusNode(MinusNode* node) {
+  step();
+  visit_children(node);
+  unsigned b = popDefined();
+  unsigned a = popDefined();
+  push(true, (int)(a - b));
+}
+
+void Evaluator::visitTimesNode(TimesNode* node) {
+  step();
+  visit_children(node);
+  unsigned b = popDefined();
+  unsigned a = popDefined();
+  push(true, (int)(a * b));
+}
+
+// idiv traps on these, so the program would crash.
+void Evaluator::visitDivideNode(DivideNode* node) {
+  step();
+  visit_children(node);
+  int b = popDefined();
+  int a = popDefined();
+  if (b == 0 || (a == INT_MIN && b == -1)) throw Stop();
+  push(true, a / b);
+}
+
+void Evaluator::visitGreaterNode(GreaterNode* node) {
+  step();
+  visit_children(node);
+  int b = popDefined();
+  int a = popDefined();
+  push(true, a > b);
+}
+
+void Evaluator::visitGreaterEqualNode(GreaterEqualNode* node) {
+  step();
+  visit_children(node);
+  int b = popDefined();
+  int a = popDefined();
+  push(true, a >= b);
+}
+
+void Evaluator::visitEqualNode(EqualNode* node) {
+  step();
+  visit_children(node);
+  int b = popDefined();
+  int a = popDefined();
+  push(true, a == b);
+}
+
+void Evaluator::visitAndNode(AndNode* node) {
+  step();
+  visit_children(node);
+  int b = popDefined();
+  int a = popDefined();
+  push(true, a & b);
+}
+
+void Evaluator::visitOrNode(OrNode* node) {
+  step();
+  visit_children(node);
+  int b = popDefined();
+  int a = popDefined();
+  push(true, a | b);
+}
+
+void Evaluator::visitNotNode(NotNode* node) {
+  step();
+  visit_children(node);
+  push(true, popDefined() ^ 1);
+}
+
+void Evaluator::visitNegationNode(NegationNode* node) {
+  step();
+  visit_children(node);
+  push(true, (int)(0u - (unsigned)popDefined()));
+}
+
+void Evaluator::visitMethodCallNode(MethodCallNode* node) {
+  step();
+
+  // Pattern: foo()
+  if (!node->identifier_2) {
+    stack.push_back(call(currentClassName, node->identifier_1->name,
+                         thisObject, node->expression_list));
+    return;
+  }
+
+  // Pattern: foo.bar(). The generated code only supports local
+  // receivers (a member receiver is read as if it were a local).
+  if (!currentMethodInfo.variables->count(node->identifier_1->name))
+    throw Stop();
+  VariableInfo var = currentMethodInfo.variables->at(node->identifier_1->name);
+  Value object = (*locals)[node->identifier_1->name];
+  if (!object.defined) throw Stop();
+  stack.push_back(call(var.type.objectClassName, node->identifier_2->name,
+                       object, node->expression_list));
+}
+
+void Evaluator::visitMemberAccessNode(MemberAccessNode* node) {
+  step();
+  VariableInfo var;
+  Value object = variable(node->identifier_1->name, var);
+  if (!object.defined) throw Stop();
+  int offset = memberOffset(var.type.objectClassName,
+                            node->identifier_2->name, var);
+  stack.push_back(heap[object.integer][offset]);
+}
+
+void Evaluator::visitVariableNode(VariableNode* node) {
+  step();
+  VariableInfo var;
+  stack.push_back(variable(node->identifier->name, var));
+}
+
+void Evaluator::visitIntegerLiteralNode(IntegerLiteralNode* node) {
+  step();
+  push(true, node->integer->value);
+}
+
+void Evaluator::visitBooleanLiteralNode(BooleanLiteralNode* node) {
+  step();
+  push(true, node->integer->value);
+}
+
+// Mirrors the generated code: the constructor (if the class itself
+// declares one) runs on the freshly allocated, uninitialized object.
+void Evaluator::visitNewNode(NewNode* node) {
+  step();
+  std::string className = node->identifier->name;
+  ClassInfo classInfo = classTable->at(className);
+  bool hasConstructor = classInfo.methods->count(className);
+  int size = classInfo.membersSize;
+  while (!classInfo.superClassName.empty()) {
+    classInfo = classTable->at(classInfo.superClassName);
+    size += classInfo.membersSize;
+  }
+
+  memory += size;
+  if (memory > memoryBudget) throw Stop();
+  heap.push_back(std::map<int, Value>());
+  Value object = {true, (int)heap.size() - 1};
+
+  if (hasConstructor)
+    call(className, className, object, node->expression_list);
+  stack.push_back(object);
+}
+
+void Evaluator::visitIntegerTypeNode(IntegerTypeNode* node) {}
+
+void Evaluator::visitBooleanTypeNode(BooleanTypeNode* node) {}
+
+void Evaluator::visitObjectTypeNode(ObjectTypeNode* node) {}
+
+void Evaluator::visitNoneNode(NoneNode* node) {}
+
+void Evaluator::visitIdentifierNode(IdentifierNode* node) {}
+
+void Evaluator::visitIntegerNode(IntegerNode* node) {}
@@ -0,0 +1,128 @@
+#ifndef __EVALUATOR_HPP
+#define __EVALUATOR_HPP
+
+#include "ast.hpp"
+#include "typecheck.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Defines a value during evaluation. Integers and booleans hold
+// their value, objects hold an index into the evaluator's heap.
+// Values which the compiled program would read from uninitialized
+// memory are not defined, and stop the evaluation.
+typedef struct value {
+  bool defined;
+  int integer;
+} Value;
+
+// Defines the result of evaluating Main.main ahead of time. If
+// the evaluation ran to completion, the output is everything the
+// program prints. Otherwise it is what the first foldedStatements
+// statements of Main.main print, and locals holds the values they
+// leave in Main.main's integer and boolean local variables.
+typedef struct evaluationresult {
+  bool complete;
+  std::string output;
+  int foldedStatements;
+  std::map<std::string, int> locals;
+} EvaluationResult;
+
+// This defines the Evaluator visitor, which runs a type checked
+// program at compile time with the same semantics as the code
+// generated for it (32-bit wrapping arithmetic, arguments evaluated
+// right to left, both sides of and/or evaluated). Programs take no
+// input, so a terminating program always prints the same output.
+//
+// Evaluation stops when it runs past the step or memory budget, or
+// hits anything whose result depends on the machine: reading an
+// uninitialized variable, dividing by zero, printing an object.
+class Evaluator final : public Visitor, public StaticVisitor<Evaluator> {
+private:
+  // Thrown (internally) to stop the evaluation.
+  struct Stop {};
+
+  // The per-object member storage, indexed by byte offset.
+  std::vector<std::map<int, Value> > heap;
+  std::vector<Value> stack;
+
+  // The frame of the method being evaluated.
+  std::map<std::string, Value>* locals;
+  Value thisObject;
+  std::string currentClassName;
+  MethodInfo currentMethodInfo;
+  int depth;
+
+  long long steps;
+  long long memory;
+
+  void step();
+  Value pop();
+  void push(bool defined, int integer);
+  int popDefined();
+  int memberOffset(std::string className, std::string memberName,
+                   VariableInfo& var);
+  Value& variable(std::string name, VariableInfo& var);
+  Value call(std::string className, std::string methodName, Value object,
+             std::vector<ExpressionNode*>* arguments);
+
+public:
+  ClassTable* classTable;
+  std::map<std::string, MethodNode*> methodNodes;
+
+  // The budget for the evaluation: the number of statements and
+  // expressions evaluated, and the number of bytes allocated.
+  long long stepBudget;
+  long long memoryBudget;
+
+  // The output printed so far.
+  std::string output;
+
+  Evaluator(ClassTable* classTable, long long stepBudget,
+            long long memoryBudget);
+
+  // Evaluates Main.main one statement at a time. The result covers
+  // the longest prefix of statements which finished within budget
+  // and left no objects in Main.main's locals.
+  EvaluationResult evaluate(ProgramNode* program);
+
+  virtual void visitProgramNode(ProgramNode* node);
+  virtual void visitClassNode(ClassNode* node);
+  virtual void visitMethodNode(MethodNode* node);
+  virtual void visitMethodBodyNode(MethodBodyNode* node);
+  virtual void visitParameterNode(ParameterNode* node);
+  virtual void visitDeclarationNode(DeclarationNode* node);
+  virtual void visitReturnStatementNode(ReturnStatementNode* node);
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitIfElseNode(IfElseNode* node);
+  virtual void visitWhileNode(WhileNode* node);
+  virtual void visitDoWhileNode(DoWhileNode* node);
+  virtual void visitPrintNode(PrintNode* node);
+  virtual void visitPlusNode(PlusNode* node);
+  virtual void visitMinusNode(MinusNode* node);
+  virtual void visitTimesNode(TimesNode* node);
+  virtual void visitDivideNode(DivideNode* node);
+  virtual void visitGreaterNode(GreaterNode* node);
+  virtual void visitGreaterEqualNode(GreaterEqualNode* node);
+  virtual void visitEqualNode(EqualNode* node);
+  virtual void visitAndNode(AndNode* node);
+  virtual void visitOrNode(OrNode* node);
+  virtual void visitNotNode(NotNode* node);
+  virtual void visitNegationNode(NegationNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+  virtual void visitIntegerLiteralNode(IntegerLiteralNode* node);
+  virtual void visitBooleanLiteralNode(BooleanLiteralNode* node);
+  virtual void visitNewNode(NewNode* node);
+  virtual void visitIntegerTypeNode(IntegerTypeNode* node);
+  virtual void visitBooleanTypeNode(BooleanTypeNode* node);
+  virtual void visitObjectTypeNode(ObjectTypeNode* node);
+  virtual void visitNoneNode(NoneNode* node);
+  virtual void visitIdentifierNode(IdentifierNode* node);
+  virtual void visitIntegerNode(IntegerNode* node);
+};
+
+#endif
@@ -57,9 +57,11 @@ parser = argparse.ArgumentParser(description="Generate AST code. Read definition
 parser.add_argument("-o", metavar="name", type=str, default="ast", help="Basename to use for output files")
 parser.add_argument("-i", metavar="file", type=str, default="lang.def", help="Input def file")
 parser.add_argument("-v", action="store_true", help="Verbose command line output")
+parser.add_argument("--arena", action="store_true", help="Allocate nodes from blocks owned by their ASTArena")
 args = parser.parse_args()
 
 verbose = args.v
+arena = args.arena
 
 # Handle input and output files
 inputfilename = args.i
@@ -150,8 +152,8 @@ except IOError as e:
 writeline(headerfile, "#ifndef __AST_HPP")
 writeline(headerfile, "#define __AST_HPP")
 writeline(headerfile, "")
+writeline(headerfile, "#include <cstddef>")
 writeline(headerfile, "#include <iostream>")
-writeline(headerfile, "#include <list>")
 writeline(headerfile, "#include <vector>")
 writeline(headerfile, "#include <stack>")
 writeline(headerfile, "#include <string>")
@@ -160,6 +162,9 @@ writeline(headerfile, "")
 writeline(headerfile, "// Enumaration of all base types in the language")
 writeline(headerfile, "typedef enum {bt_boolean, bt_integer, bt_none, bt_object} BaseType;")
 writeline(headerfile, "")
+writeline(headerfile, "// Enumeration of the kinds of AST nodes, one for each node class")
+writeline(headerfile, "typedef enum {" + ", ".join(["nk_" + node.name.lower() for node in nodes] + ["nk_identifier", "nk_integer"]) + "} NodeKind;")
+writeline(headerfile, "")
 writeline(headerfile, "// Forward declarations of AST Node classes")
 for node in nodes:
     writeline(headerfile, "class " + node.name + "Node;")
@@ -189,7 +194,7 @@ for node in nodes:
         newtype = child.name + "Node*"
         newname = child.name.lower()
         if (child.list):
-            newtype = "std::list<" + child.name + "Node*" + ">*"
+            newtype = "std::vector<" + child.name + "Node*" + ">*"
             newname = child.name.lower() + "_list"
         if ((newtype, newname) not in types):
             types.append((newtype, newname))
@@ -216,6 +221,56 @@ writeline(headerfile, "  virtual void visitIdentifierNode(IdentifierNode* node)
 writeline(headerfile, "  virtual void visitIntegerNode(IntegerNode* node) = 0;")
 writeline(headerfile, "};")
 writeline(headerfile, "")
+writeline(headerfile, "// The line the scanner on this thread is on, which new nodes record.")
+writeline(headerfile, "//   The scanner sets it after every token it reads")
+writeline(headerfile, "extern thread_local int currentLineno;")
+writeline(headerfile, "")
+writeline(headerfile, "class ASTNode;")
+writeline(headerfile, "")
+writeline(headerfile, "// Owns the nodes made on a thread while it is the current arena there,")
+writeline(headerfile, "//   and deletes them all when it goes away. Arenas nest: each is current")
+writeline(headerfile, "//   from its construction until its destruction. Nodes made while no arena")
+writeline(headerfile, "//   is current are never deleted")
+if (arena):
+    writeline(headerfile, "//   Nodes are laid out one after another in large blocks, so a tree is")
+    writeline(headerfile, "//   close together in memory and freeing it frees a few blocks")
+else:
+    writeline(headerfile, "//   Each node is allocated on its own (genast.py --arena lays them out")
+    writeline(headerfile, "//   in blocks instead)")
+writeline(headerfile, "class ASTArena {")
+writeline(headerfile, "public:")
+writeline(headerfile, "  // How much of an arena is in use")
+writeline(headerfile, "  typedef struct arenamark {")
+writeline(headerfile, "    size_t nodes;")
+writeline(headerfile, "    size_t block;")
+writeline(headerfile, "    size_t used;")
+writeline(headerfile, "  } Mark;")
+writeline(headerfile, "")
+writeline(headerfile, "  ASTArena();")
+writeline(headerfile, "  ~ASTArena();")
+writeline(headerfile, "")
+writeline(headerfile, "  Mark mark();")
+writeline(headerfile, "  // Deletes the nodes made since the mark, and reuses their memory")
+writeline(headerfile, "  void release(Mark mark);")
+writeline(headerfile, "")
+writeline(headerfile, "  // Allocates a node in the current arena")
+writeline(headerfile, "  static void* allocate(size_t size);")
+writeline(headerfile, "")
+writeline(headerfile, "private:")
+writeline(headerfile, "  static thread_local ASTArena* current;")
+writeline(headerfile, "  ASTArena* previous;")
+writeline(headerfile, "  // The nodes in the order they were made")
+writeline(headerfile, "  std::vector<ASTNode*> nodes;")
+if (arena):
+    writeline(headerfile, "  // The blocks, the one being filled and how much of it is used")
+    writeline(headerfile, "  std::vector<char*> blocks;")
+    writeline(headerfile, "  size_t block;")
+    writeline(headerfile, "  size_t used;")
+writeline(headerfile, "")
+writeline(headerfile, "  ASTArena(const ASTArena&);")
+writeline(headerfile, "  ASTArena& operator=(const ASTArena&);")
+writeline(headerfile, "};")
+writeline(headerfile, "")
 writeline(headerfile, "// Define abstract base class for all AST Nodes")
 writeline(headerfile, "//   (this also serves to define the visitable objects)")
 writeline(headerfile, "class ASTNode {")
@@ -225,6 +280,23 @@ writeline(headerfile, "  BaseType basetype;")
 writeline(headerfile, "  // All AST nodes have a member which stores the class name, applicable if the base type")
 writeline(headerfile, "  // is object. Otherwise this field may be unused")
 writeline(headerfile, "  std::string objectClassName;")
+writeline(headerfile, "  // All AST nodes record the source line the lexer was on when they were")
+writeline(headerfile, "  // made, the line of the last token read")
+writeline(headerfile, "  int lineno;")
+writeline(headerfile, "  // All AST nodes record which class they are, which StaticVisitor switches on")
+writeline(headerfile, "  NodeKind kind;")
+writeline(headerfile, "")
+writeline(headerfile, "  ASTNode();")
+writeline(headerfile, "  // Nodes belong to their arena, so deleting a node only deletes its lists")
+writeline(headerfile, "  //   of children, not the children")
+writeline(headerfile, "  virtual ~ASTNode() {}")
+writeline(headerfile, "")
+writeline(headerfile, "  static void* operator new(size_t size) { return ASTArena::allocate(size); }")
+if (arena):
+    writeline(headerfile, "  // The memory of a node goes with its arena")
+    writeline(headerfile, "  static void operator delete(void* node) {}")
+else:
+    writeline(headerfile, "  static void operator delete(void* node) { ::operator delete(node); }")
 writeline(headerfile, "")
 writeline(headerfile, "  // All AST nodes provide visit children and accept methods")
 writeline(headerfile, "  virtual void visit_children(Visitor* v) = 0;")
@@ -243,7 +315,7 @@ writeline(headerfile, "public:")
 writeline(headerfile, "  std::string name;")
 writeline(headerfile, "  virtual void visit_children(Visitor* v) { /* No Children */ }")
 writeline(headerfile, "  virtual void accept(Visitor* v) { v->visitIdentifierNode(this); }")
-writeline(headerfile, "  IdentifierNode(std::string name) { this->name = name; }")
+writeline(headerfile, "  IdentifierNode(std::string name) { this->kind = nk_identifier; this->name = name; }")
 writeline(headerfile, "")
 writeline(headerfile, "};")
 writeline(headerfile, "")
@@ -255,7 +327,7 @@ writeline(headerfile, "")
 writeline(headerfile, "  virtual void visit_children(Visitor* v) {/* No Children */ }")
 writeline(headerfile, "  virtual void accept(Visitor* v) { v->visitIntegerNode(this); }")
 writeline(headerfile, "")
-writeline(headerfile, "  IntegerNode(int value) { this->value = value; }")
+writeline(headerfile, "  IntegerNode(int value) { this->kind = nk_integer; this->value = value; }")
 writeline(headerfile, "};")
 writeline(headerfile, "")
 writeline(headerfile, "// Define all other AST nodes")
@@ -289,7 +361,7 @@ for node in nodes:
         if (not child.list):
             members.append(child.name + "Node* " + child.name.lower() + number)
         else:
-            members.append("std::list<" + child.name + "Node*" + ">* " + child.name.lower() + "_list" + number)
+            members.append("std::vector<" + child.name + "Node*" + ">* " + child.name.lower() + "_list" + number)
     
     for member in members:
         writeline(headerfile, "  " + member + ";")
@@ -297,9 +369,75 @@ for node in nodes:
     if (len(members) > 0):
         writeline(headerfile, "")
         writeline(headerfile, "  " + node.name + "Node(" + (", ".join(members)) + ");")
+    else:
+        writeline(headerfile, "")
+        writeline(headerfile, "  " + node.name + "Node() { this->kind = nk_" + node.name.lower() + "; }")
+    if (any(child.list for child in node.children)):
+        writeline(headerfile, "  virtual ~" + node.name + "Node();")
     writeline(headerfile, "};")
     writeline(headerfile, "")
 
+writeline(headerfile, "// Define a visitor dispatched without virtual calls: Derived (the class")
+writeline(headerfile, "//   deriving from StaticVisitor<Derived>) defines visit functions for the")
+writeline(headerfile, "//   nodes it handles, and dispatch switches on the kind of a node to call")
+writeline(headerfile, "//   them. Nodes it does not handle have their children visited. If Derived")
+writeline(headerfile, "//   is also a Visitor, making it final lets the compiler inline its visit")
+writeline(headerfile, "//   functions into dispatch")
+writeline(headerfile, "template <class Derived>")
+writeline(headerfile, "class StaticVisitor {")
+writeline(headerfile, "public:")
+writeline(headerfile, "  void dispatch(ASTNode* node) {")
+writeline(headerfile, "    Derived* self = static_cast<Derived*>(this);")
+writeline(headerfile, "    switch (node->kind) {")
+for name in [node.name for node in nodes] + ["Identifier", "Integer"]:
+    writeline(headerfile, "    case nk_" + name.lower() + ":")
+    writeline(headerfile, "      self->visit" + name + "Node(static_cast<" + name + "Node*>(node));")
+    writeline(headerfile, "      break;")
+writeline(headerfile, "    }")
+writeline(headerfile, "  }")
+writeline(headerfile, "")
+writeline(headerfile, "  // Dispatch on each child of a node, in order (like visit_children)")
+for node in nodes:
+    if (len(node.children) == 0):
+        writeline(headerfile, "  void visit_children(" + node.name + "Node* node) {}")
+        continue
+    writeline(headerfile, "  void visit_children(" + node.name + "Node* node) {")
+    dupnames = {}
+    childnames = []
+    for child in node.children:
+        if (child.name in childnames):
+            dupnames[child.name] = 1
+        else:
+            childnames.append(child.name)
+    for child in node.children:
+        number = ""
+        if (child.name in dupnames.keys()):
+            number = "_" + str(dupnames[child.name])
+            dupnames[child.name] = dupnames[child.name] + 1
+        if (child.list):
+            member = "node->" + child.name.lower() + "_list" + number
+            writeline(headerfile, "    if (" + member + ") {")
+            writeline(headerfile, "      for(std::vector<" + child.name + "Node*>::iterator iter = " + member + "->begin();")
+            writeline(headerfile, "          iter != " + member + "->end(); iter++) {")
+            writeline(headerfile, "        dispatch(*iter);")
+            writeline(headerfile, "      }")
+            writeline(headerfile, "    }")
+        elif (child.optional):
+            member = "node->" + child.name.lower() + number
+            writeline(headerfile, "    if (" + member + ") {")
+            writeline(headerfile, "      dispatch(" + member + ");")
+            writeline(headerfile, "    }")
+        else:
+            writeline(headerfile, "    dispatch(node->" + child.name.lower() + number + ");")
+    writeline(headerfile, "  }")
+writeline(headerfile, "  void visit_children(IdentifierNode* node) {}")
+writeline(headerfile, "  void visit_children(IntegerNode* node) {}")
+writeline(headerfile, "")
+writeline(headerfile, "  // Visit functions for the nodes Derived does not handle")
+for name in [node.name for node in nodes] + ["Identifier", "Integer"]:
+    writeline(headerfile, "  void visit" + name + "Node(" + name + "Node* node) { visit_children(node); }")
+writeline(headerfile, "};")
+writeline(headerfile, "")
 writeline(headerfile, "// Define the provided Print visitor, which will print the AST,")
 writeline(headerfile, "//   this is an example of a concrete visitor which visit the tree")
 writeline(headerfile, "class Print : public Visitor {")
@@ -332,7 +470,80 @@ writeline(codefile, "#include \"" + headerfilename + "\"")
 writeline(codefile, "// For node constructors, all children are taken as")
 writeline(codefile, "//   parameters, and must be passed in. Optional children")
 writeline(codefile, "//   may be NULL pointers. List children are pointers to")
-writeline(codefile, "//    std::lists of the appropriate type (pointer to some node type).")
+writeline(codefile, "//    std::vectors of the appropriate type (pointer to some node type).")
+writeline(codefile, "")
+writeline(codefile, "thread_local int currentLineno = 1;")
+writeline(codefile, "")
+writeline(codefile, "// Constructor for the AST node base class")
+writeline(codefile, "ASTNode::ASTNode() : lineno(currentLineno) {}")
+writeline(codefile, "")
+writeline(codefile, "thread_local ASTArena* ASTArena::current = NULL;")
+writeline(codefile, "")
+if (arena):
+    writeline(codefile, "// The size of the blocks nodes are allocated from")
+    writeline(codefile, "#define ARENA_BLOCK_SIZE (64 << 10)")
+    writeline(codefile, "")
+    writeline(codefile, "ASTArena::ASTArena() : previous(current), block(0), used(0) {")
+else:
+    writeline(codefile, "ASTArena::ASTArena() : previous(current) {")
+writeline(codefile, "  current = this;")
+writeline(codefile, "}")
+writeline(codefile, "")
+writeline(codefile, "ASTArena::~ASTArena() {")
+writeline(codefile, "  release(Mark());")
+if (arena):
+    writeline(codefile, "  for (size_t i = 0; i < this->blocks.size(); i++)")
+    writeline(codefile, "    delete[] this->blocks[i];")
+writeline(codefile, "  current = this->previous;")
+writeline(codefile, "}")
+writeline(codefile, "")
+writeline(codefile, "ASTArena::Mark ASTArena::mark() {")
+writeline(codefile, "  Mark mark = Mark();")
+writeline(codefile, "  mark.nodes = this->nodes.size();")
+if (arena):
+    writeline(codefile, "  mark.block = this->block;")
+    writeline(codefile, "  mark.used = this->used;")
+writeline(codefile, "  return mark;")
+writeline(codefile, "}")
+writeline(codefile, "")
+writeline(codefile, "// Nodes are deleted in the reverse of the order they were made in")
+writeline(codefile, "void ASTArena::release(Mark mark) {")
+writeline(codefile, "  while (this->nodes.size() > mark.nodes) {")
+if (arena):
+    writeline(codefile, "    this->nodes.back()->~ASTNode();")
+else:
+    writeline(codefile, "    delete this->nodes.back();")
+writeline(codefile, "    this->nodes.pop_back();")
+writeline(codefile, "  }")
+if (arena):
+    writeline(codefile, "  this->block = mark.block;")
+    writeline(codefile, "  this->used = mark.used;")
+writeline(codefile, "}")
+writeline(codefile, "")
+writeline(codefile, "void* ASTArena::allocate(size_t size) {")
+writeline(codefile, "  ASTArena* arena = current;")
+if (arena):
+    writeline(codefile, "  if (!arena)")
+    writeline(codefile, "    return ::operator new(size);")
+    writeline(codefile, "  // Every node starts on a boundary suitable for any member")
+    writeline(codefile, "  size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);")
+    writeline(codefile, "  if (arena->blocks.empty() || arena->used + size > ARENA_BLOCK_SIZE) {")
+    writeline(codefile, "    // Move on to the next block, which is kept from before a release")
+    writeline(codefile, "    if (!arena->blocks.empty())")
+    writeline(codefile, "      arena->block++;")
+    writeline(codefile, "    if (arena->block == arena->blocks.size())")
+    writeline(codefile, "      arena->blocks.push_back(new char[ARENA_BLOCK_SIZE]);")
+    writeline(codefile, "    arena->used = 0;")
+    writeline(codefile, "  }")
+    writeline(codefile, "  void* node = arena->blocks[arena->block] + arena->used;")
+    writeline(codefile, "  arena->used += size;")
+    writeline(codefile, "  arena->nodes.push_back(static_cast<ASTNode*>(node));")
+else:
+    writeline(codefile, "  void* node = ::operator new(size);")
+    writeline(codefile, "  if (arena)")
+    writeline(codefile, "    arena->nodes.push_back(static_cast<ASTNode*>(node));")
+writeline(codefile, "  return node;")
+writeline(codefile, "}")
 for node in nodes:
     writeline(codefile, "")
     writeline(codefile, "// Visit Children method for " + node.name + " AST node")
@@ -354,12 +565,12 @@ for node in nodes:
         
         if (child.list):
             writeline(codefile, "  if (this->" + child.name.lower() + "_list" + number + ") {")
-            writeline(codefile, "    for(std::list<" + child.name + "Node*" + ">::iterator iter = this->" + child.name.lower() + "_list" + number + "->begin();")
+            writeline(codefile, "    for(std::vector<" + child.name + "Node*" + ">::iterator iter = this->" + child.name.lower() + "_list" + number + "->begin();")
             writeline(codefile, "        iter != this->" + child.name.lower() + "_list" + number + "->end(); iter++) {")
             writeline(codefile, "      (*iter)->accept(v);")
             writeline(codefile, "    }")
             writeline(codefile, "  }")
-            members.append(("std::list<" + child.name + "Node*" + ">*", child.name.lower() + "_list" + number))
+            members.append(("std::vector<" + child.name + "Node*" + ">*", child.name.lower() + "_list" + number))
         elif (child.optional):
             writeline(codefile, "  if (this->" + child.name.lower() + number + ") {")
             writeline(codefile, "    this->" + child.name.lower() + number + "->accept(v);")
@@ -374,10 +585,20 @@ for node in nodes:
         writeline(codefile, "")
         writeline(codefile, "// Constructor for " + node.name + " AST node")
         writeline(codefile, "" + node.name + "Node::" + node.name + "Node(" + (", ".join(map(lambda x: x[0] + " " + x[1], members))) + ") {")
+        writeline(codefile, "  this->kind = nk_" + node.name.lower() + ";")
         for member in members:
             writeline(codefile, "  this->" + member[1] + " = " + member[1] + ";")
         writeline(codefile, "}")
 
+    lists = [member for member in members if member[0].startswith("std::vector")]
+    if (len(lists) > 0):
+        writeline(codefile, "")
+        writeline(codefile, "// Destructor for " + node.name + " AST node")
+        writeline(codefile, "" + node.name + "Node::~" + node.name + "Node() {")
+        for member in lists:
+            writeline(codefile, "  delete this->" + member[1] + ";")
+        writeline(codefile, "}")
+
 writeline(codefile, "")
 writeline(codefile, "// Definitions for print functions")
 writeline(codefile, "// Push Level adds a new level to the printed tree (for a node with children)")
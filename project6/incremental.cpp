@@ -0,0 +1,350 @@
+#include "incremental.hpp"
+#include "interface.hpp"
+
+#include <cstdlib>
+#include <sstream>
+
+// Increases when the format of the state changes.
+#define INCREMENTAL_FORMAT 1
+
+// Writes out a tree as text, for its digest. Each node is its name
+// and its children in parentheses, so two trees have the same text
+// only if they are the same.
+class TreeText : public Visitor {
+public:
+  std::string text;
+  bool lines;
+
+  void open(const char* name, ASTNode* node) {
+    text += '(';
+    text += name;
+    if (lines) text += ' ' + std::to_string(node->lineno);
+  }
+
+  virtual void visitProgramNode(ProgramNode* node);
+  virtual void visitClassNode(ClassNode* node);
+  virtual void visitMethodNode(MethodNode* node);
+  virtual void visitMethodBodyNode(MethodBodyNode* node);
+  virtual void visitParameterNode(ParameterNode* node);
+  virtual void visitDeclarationNode(DeclarationNode* node);
+  virtual void visitReturnStatementNode(ReturnStatementNode* node);
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitIfElseNode(IfElseNode* node);
+  virtual void visitWhileNode(WhileNode* node);
+  virtual void visitDoWhileNode(DoWhileNode* node);
+  virtual void visitPrintNode(PrintNode* node);
+  virtual void visitPlusNode(PlusNode* node);
+  virtual void visitMinusNode(MinusNode* node);
+  virtual void visitTimesNode(TimesNode* node);
+  virtual void visitDivideNode(DivideNode* node);
+  virtual void visitGreaterNode(GreaterNode* node);
+  virtual void visitGreaterEqualNode(GreaterEqualNode* node);
+  virtual void visitEqualNode(EqualNode* node);
+  virtual void visitAndNode(AndNode* node);
+  virtual void visitOrNode(OrNode* node);
+  virtual void visitNotNode(NotNode* node);
+  virtual void visitNegationNode(NegationNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+  virtual void visitIntegerLiteralNode(IntegerLiteralNode* node);
+  virtual void visitBooleanLiteralNode(BooleanLiteralNode* node);
+  virtual void visitNewNode(NewNode* node);
+  virtual void visitIntegerTypeNode(IntegerTypeNode* node);
+  virtual void visitBooleanTypeNode(BooleanTypeNode* node);
+  virtual void visitObjectTypeNode(ObjectTypeNode* node);
+  virtual void visitNoneNode(NoneNode* node);
+  virtual void visitIdentifierNode(IdentifierNode* node);
+  virtual void visitIntegerNode(IntegerNode* node);
+};
+
+// No other node has two lists of the same kind of children next
+// to each other, or an optional child next to a list of its kind.
+#define TREE_NODE(Name)                                \
+  void TreeText::visit##Name##Node(Name##Node* node) { \
+    open(#Name, node);                                 \
+    node->visit_children(this);                        \
+    text += ')';                                       \
+  }
+
+TREE_NODE(Program)
+TREE_NODE(Class)
+TREE_NODE(Method)
+TREE_NODE(MethodBody)
+TREE_NODE(Parameter)
+TREE_NODE(Declaration)
+TREE_NODE(ReturnStatement)
+TREE_NODE(Assignment)
+TREE_NODE(Call)
+TREE_NODE(While)
+TREE_NODE(DoWhile)
+TREE_NODE(Print)
+TREE_NODE(Plus)
+TREE_NODE(Minus)
+TREE_NODE(Times)
+TREE_NODE(Divide)
+TREE_NODE(Greater)
+TREE_NODE(GreaterEqual)
+TREE_NODE(Equal)
+TREE_NODE(And)
+TREE_NODE(Or)
+TREE_NODE(Not)
+TREE_NODE(Negation)
+TREE_NODE(MethodCall)
+TREE_NODE(MemberAccess)
+TREE_NODE(Variable)
+TREE_NODE(IntegerLiteral)
+TREE_NODE(BooleanLiteral)
+TREE_NODE(New)
+TREE_NODE(IntegerType)
+TREE_NODE(BooleanType)
+TREE_NODE(ObjectType)
+TREE_NODE(None)
+
+#undef TREE_NODE
+
+void TreeText::visitIfElseNode(IfElseNode* node) {
+  open("IfElse", node);
+  node->expression->accept(this);
+  text += "(then";
+  for (auto statement : *node->statement_list_1) statement->accept(this);
+  text += ')';
+  if (node->statement_list_2) {
+    text += "(else";
+    for (auto statement : *node->statement_list_2) statement->accept(this);
+    text += ')';
+  }
+  text += ')';
+}
+
+void TreeText::visitIdentifierNode(IdentifierNode* node) {
+  open("Identifier", node);
+  text += ' ' + node->name + ')';
+}
+
+void TreeText::visitIntegerNode(IntegerNode* node) {
+  open("Integer", node);
+  text += ' ' + std::to_string(node->value) + ')';
+}
+
+static std::string typeText(const CompoundType& type) {
+  return std::to_string(type.baseType) + ' ' + type.objectClassName;
+}
+
+static std::string variablesText(const VariableTable* variables) {
+  std::string text;
+  for (auto& variable : *variables) {
+    text += variable.first + ' ' + typeText(variable.second.type) + ' ' +
+            std::to_string(variable.second.offset) + ' ' +
+            std::to_string(variable.second.size) + '\n';
+  }
+  return text;
+}
+
+static std::string signatureText(const MethodInfo& method) {
+  std::string text = typeText(method.returnType) + '(';
+  for (auto& parameter : *method.parameters)
+    text += typeText(parameter) + ',';
+  return text + ')';
+}
+
+// The state is a sequence of fields, each a line with a name and
+// the length of its value, followed by that many bytes.
+static void writeField(std::ostringstream& out, const std::string& name,
+                       const std::string& value) {
+  out << name << ' ' << value.size() << '\n' << value;
+}
+
+static bool readField(const std::string& text, size_t& position,
+                      std::string& name, std::string& value) {
+  size_t space = text.find(' ', position);
+  size_t end = text.find('\n', position);
+  if (space == std::string::npos || end == std::string::npos || space > end)
+    return false;
+  name = text.substr(position, space - position);
+  char* last;
+  unsigned long long size = strtoull(text.c_str() + space + 1, &last, 10);
+  if (last != text.c_str() + end || size > text.size() - end - 1)
+    return false;
+  value = text.substr(end + 1, size);
+  position = end + 1 + size;
+  return true;
+}
+
+// A clone is its class, method and symbol and which arguments it
+// folds in, with their values.
+static std::string cloneText(const Specialization& clone) {
+  std::string text = clone.className + ' ' + clone.methodName + ' ' +
+                     clone.symbol;
+  for (size_t i = 0; i < clone.isConstant.size(); i++) {
+    text += ' ' + std::to_string((int)clone.isConstant[i]) + ' ' +
+            std::to_string(clone.values[i]);
+  }
+  return text;
+}
+
+static Specialization readClone(const std::string& text) {
+  std::istringstream in(text);
+  Specialization clone;
+  clone.method = NULL;
+  in >> clone.className >> clone.methodName >> clone.symbol;
+  int constant, value;
+  while (in >> constant >> value) {
+    clone.isConstant.push_back(constant);
+    clone.values.push_back(value);
+  }
+  return clone;
+}
+
+void IncrementalState::read(const std::string& text) {
+  std::string header = "lang incremental " +
+                       std::to_string(INCREMENTAL_FORMAT) + "\n";
+  if (text.compare(0, header.size(), header)) return;
+  size_t position = header.size();
+  std::string name, value;
+  if (!readField(text, position, name, value) || name != "options" ||
+      value != optionsKey)
+    return;
+
+  GeneratedMethod* method = NULL;
+  while (readField(text, position, name, value)) {
+    if (name == "method") {
+      method = &previous[value];
+      method->symbol = value;
+    } else if (name == "helper") {
+      size_t end = value.find('\n');
+      if (end == std::string::npos) break;
+      previousThunks[value.substr(0, end)] = value.substr(end + 1);
+    } else if (!method) {
+      break;
+    } else if (name == "depends") {
+      size_t space = value.find(' ');
+      if (space == std::string::npos) break;
+      method->dependencies[value.substr(space + 1)] = value.substr(0, space);
+    } else if (name == "clone") {
+      method->clones.push_back(readClone(value));
+    } else if (name == "thunk") {
+      method->thunkNames.insert(value);
+    } else if (name == "code") {
+      method->code = value;
+    } else {
+      break;
+    }
+  }
+  if (position != text.size()) {
+    // Rather nothing than part of a state.
+    previous.clear();
+    previousThunks.clear();
+  }
+}
+
+std::string IncrementalState::write() {
+  std::ostringstream out;
+  out << "lang incremental " << INCREMENTAL_FORMAT << '\n';
+  writeField(out, "options", optionsKey);
+  std::set<std::string> helpers;
+  for (auto& entry : methods) {
+    const GeneratedMethod& method = entry.second;
+    writeField(out, "method", method.symbol);
+    for (auto& dependency : method.dependencies)
+      writeField(out, "depends", dependency.second + ' ' + dependency.first);
+    for (auto& clone : method.clones)
+      writeField(out, "clone", cloneText(clone));
+    for (auto& name : method.thunkNames) {
+      writeField(out, "thunk", name);
+      helpers.insert(name);
+    }
+    writeField(out, "code", method.code);
+  }
+  for (auto& name : helpers)
+    writeField(out, "helper", name + '\n' + thunks.at(name));
+  return out.str();
+}
+
+std::string IncrementalState::digest(const std::string& name,
+                                     CodeGenerator* generator) {
+  // The clones change from round to round, and the method's share
+  // of the clone limit with the round.
+  if (name == "clones") {
+    std::string text = std::to_string(generator->cloneBudget) + '\n';
+    for (auto& symbol : generator->specializedSymbols) text += symbol + '\n';
+    return contentHash(text);
+  }
+  auto found = digests.find(name);
+  if (found != digests.end()) return found->second;
+
+  size_t first = name.find(' '), second = name.find(' ', first + 1);
+  std::string kind = name.substr(0, first);
+  std::string className = name.substr(first + 1, second - first - 1);
+  std::string methodName =
+      second == std::string::npos ? "" : name.substr(second + 1);
+  std::string text;
+  auto classInfo = generator->classTable->find(className);
+  if (classInfo == generator->classTable->end()) {
+    text = "missing";
+  } else if (kind == "class") {
+    const ClassInfo& info = classInfo->second;
+    text = info.superClassName + ' ' + std::to_string(info.membersSize) + '\n' +
+           variablesText(info.members.get());
+    for (auto& method : *info.methods)
+      text += method.first + ' ' + signatureText(method.second) + '\n';
+  } else {
+    auto methodInfo = classInfo->second.methods->find(methodName);
+    auto node = generator->methodNodes.find(className + "_" + methodName);
+    if (methodInfo == classInfo->second.methods->end()) {
+      text = "missing";
+    } else {
+      const MethodInfo& info = methodInfo->second;
+      text = signatureText(info) + ' ' + std::to_string(info.localsSize) +
+             ' ' + std::to_string(info.pure) + '\n' +
+             variablesText(info.variables.get());
+    }
+    if (node != generator->methodNodes.end()) {
+      TreeText tree;
+      tree.lines = lines;
+      node->second->accept(&tree);
+      text += tree.text;
+    }
+  }
+  return digests[name] = contentHash(text);
+}
+
+bool IncrementalState::reuse(const Specialization& method,
+                             CodeGenerator* generator,
+                             GeneratedMethod& result) {
+  auto found = previous.find(method.symbol);
+  if (found == previous.end()) return false;
+  GeneratedMethod& last = found->second;
+  for (auto& dependency : last.dependencies) {
+    if (digest(dependency.first, generator) != dependency.second)
+      return false;
+  }
+  for (auto& name : last.thunkNames) {
+    if (!previousThunks.count(name)) return false;
+  }
+  for (auto& clone : last.clones) {
+    auto node = generator->methodNodes.find(clone.className + "_" +
+                                            clone.methodName);
+    if (node == generator->methodNodes.end()) return false;
+    clone.method = node->second;
+  }
+
+  for (auto& name : last.thunkNames)
+    thunks[name] = generator->thunks[name] = previousThunks.at(name);
+  result = last;
+  methods[method.symbol] = std::move(last);
+  previous.erase(found);
+  reused++;
+  return true;
+}
+
+void IncrementalState::record(GeneratedMethod& method,
+                              CodeGenerator* generator) {
+  for (auto& dependency : method.dependencies)
+    dependency.second = digest(dependency.first, generator);
+  for (auto& name : method.thunkNames)
+    thunks[name] = generator->thunks.at(name);
+  methods[method.symbol] = method;
+  generated++;
+}
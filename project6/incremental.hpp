@@ -0,0 +1,77 @@
+#ifndef __INCREMENTAL_HPP
+#define __INCREMENTAL_HPP
+
+#include "ast.hpp"
+#include "codegeneration.hpp"
+#include "typecheck.hpp"
+
+#include <map>
+#include <string>
+
+// Incremental compilation (--incremental=file). The file keeps the
+// code generated for each method (and specialized clone) of the
+// last compilation along with what that code was generated from,
+// each as a digest:
+//
+//   method Class name  the method's tree and its entry in the class
+//                      table (locals, parameters, return type and
+//                      purity), for the method itself and for every
+//                      callee specialize() looked at
+//   class Class        the layout of a class the method used: its
+//                      superclass, members and method signatures
+//   clones             the clones generated before the method's
+//                      round and its share of the clone limit,
+//                      which decide whether it may request more
+//                      (see CodeGenerator::generateRound)
+//
+// A method whose dependencies all have the same digests as before
+// is not generated again; its code, the clones it requested and
+// the helper routines it calls are taken from the file, and the
+// output is put together from old and new methods as usual. Line
+// numbers are only part of the trees with -g and --profile-alloc,
+// so moving a method does not regenerate it otherwise.
+//
+// The file is thrown away when the options change. Profiles and
+// ahead-of-time evaluation number or run the whole program, so
+// with them every method is generated.
+
+class IncrementalState {
+private:
+  // The digests of the current program by dependency name,
+  // computed the first time they are asked for.
+  std::map<std::string, std::string> digests;
+  // The methods of the last compilation by symbol, and the helper
+  // routines by name.
+  std::map<std::string, GeneratedMethod> previous;
+  std::map<std::string, std::string> previousThunks;
+
+public:
+  // What the options of the compilation are, and whether line
+  // numbers matter to the code.
+  std::string optionsKey;
+  bool lines = false;
+
+  // The methods of this compilation, which are written out.
+  std::map<std::string, GeneratedMethod> methods;
+  std::map<std::string, std::string> thunks;
+  int reused = 0;
+  int generated = 0;
+
+  // Reads the state of the last compilation. A state made with
+  // other options, or which is not a whole state, is ignored.
+  void read(const std::string& text);
+  std::string write();
+
+  // Returns the digest of a dependency in the program being
+  // generated.
+  std::string digest(const std::string& name, CodeGenerator* generator);
+
+  // Finds the code of the last compilation for a method, if none
+  // of what it depends on has changed.
+  bool reuse(const Specialization& method, CodeGenerator* generator,
+             GeneratedMethod& result);
+  // Fills in the digests of a method just generated, and keeps it.
+  void record(GeneratedMethod& method, CodeGenerator* generator);
+};
+
+#endif
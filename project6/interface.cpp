@@ -0,0 +1,105 @@
+#include "interface.hpp"
+
+#include <cstdio>
+#include <sstream>
+
+static std::string typeName(CompoundType type) {
+  switch (type.baseType) {
+    case bt_integer:
+      return "integer";
+    case bt_boolean:
+      return "boolean";
+    case bt_none:
+      return "none";
+    default:
+      return type.objectClassName;
+  }
+}
+
+static CompoundType parseType(std::string name) {
+  if (name == "integer") return CompoundType{bt_integer, ""};
+  if (name == "boolean") return CompoundType{bt_boolean, ""};
+  if (name == "none") return CompoundType{bt_none, ""};
+  return CompoundType{bt_object, name};
+}
+
+std::string writeInterface(ClassTable* classTable, ProgramNode* program) {
+  std::vector<std::string> classNames;
+  for (auto classNode : *program->class_list)
+    classNames.push_back(classNode->identifier_1->name);
+  return writeInterface(classTable, classNames);
+}
+
+std::string writeInterface(ClassTable* classTable,
+                           const std::vector<std::string>& classNames) {
+  std::ostringstream out;
+  for (auto& className : classNames) {
+    ClassInfo classInfo = classTable->at(className);
+    out << "class " << className << " "
+        << (classInfo.superClassName.empty() ? "-" : classInfo.superClassName)
+        << " " << classInfo.membersSize << std::endl;
+    for (auto& member : *classInfo.members)
+      out << "member " << member.first << " " << typeName(member.second.type)
+          << " " << member.second.offset << " " << member.second.size
+          << std::endl;
+    for (auto& method : *classInfo.methods) {
+      out << "method " << method.first << " "
+          << typeName(method.second.returnType) << " " << method.second.pure;
+      for (auto& parameter : *method.second.parameters)
+        out << " " << typeName(parameter);
+      out << std::endl;
+    }
+  }
+  return out.str();
+}
+
+void readInterface(const std::string& text, ClassTable* classTable) {
+  std::istringstream lines(text);
+  std::string line;
+  ClassInfo* classInfo = NULL;
+  while (std::getline(lines, line)) {
+    std::istringstream fields(line);
+    std::string kind, name;
+    if (!(fields >> kind) || kind[0] == '#') continue;
+    fields >> name;
+
+    if (kind == "class") {
+      std::string superClassName;
+      int membersSize = 0;
+      fields >> superClassName >> membersSize;
+      (*classTable)[name] =
+          ClassInfo{superClassName == "-" ? "" : superClassName,
+                    std::make_shared<MethodTable>(),
+                    std::make_shared<VariableTable>(), membersSize};
+      classInfo = &classTable->at(name);
+    } else if (kind == "member" && classInfo) {
+      std::string type;
+      VariableInfo var;
+      fields >> type >> var.offset >> var.size;
+      var.type = parseType(type);
+      (*classInfo->members)[name] = var;
+    } else if (kind == "method" && classInfo) {
+      std::string type;
+      MethodInfo method{CompoundType{}, std::make_shared<VariableTable>(),
+                        std::make_shared<std::list<CompoundType> >(), 0,
+                        false};
+      fields >> type >> method.pure;
+      method.returnType = parseType(type);
+      while (fields >> type) method.parameters->push_back(parseType(type));
+      (*classInfo->methods)[name] = method;
+    } else {
+      throw CompileError("Malformed interface line: " + line);
+    }
+  }
+}
+
+std::string contentHash(const std::string& text) {
+  unsigned long long hash = 14695981039346656037ull;
+  for (unsigned char c : text) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", hash);
+  return hex;
+}
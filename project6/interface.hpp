@@ -0,0 +1,33 @@
+#ifndef __INTERFACE_HPP
+#define __INTERFACE_HPP
+
+#include "ast.hpp"
+#include "typecheck.hpp"
+
+#include <string>
+
+// Interface files (.langi) hold what other source files need to
+// know about the classes of a file to be compiled against it: the
+// class table entries of those classes, without the method bodies
+// or their local variables. The format is one line per entry:
+//
+//   class <name> <superclass or -> <members size>
+//   member <name> <type> <offset> <size>
+//   method <name> <return type> <pure> <parameter types...>
+//
+// where a type is integer, boolean, none or a class name. Member
+// and method lines belong to the class before them.
+
+// Returns the interface of the classes declared by a program.
+std::string writeInterface(ClassTable* classTable, ProgramNode* program);
+std::string writeInterface(ClassTable* classTable,
+                           const std::vector<std::string>& classNames);
+
+// Adds the classes of an interface to a class table. Lines starting
+// with # are ignored.
+void readInterface(const std::string& text, ClassTable* classTable);
+
+// Returns a 64-bit FNV-1a hash of text, as 16 hex digits.
+std::string contentHash(const std::string& text);
+
+#endif
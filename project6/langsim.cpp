@@ -0,0 +1,61 @@
+#include "x86sim.hpp"
+#include "error.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+// Runs the assembly the compiler generated for a program, printing
+// what it prints, followed on stderr by the counts of the run:
+//
+//   ./lang < program.lang > program.s
+//   ./langsim [--limit=<instructions>] [--stack=<KB>] [--quiet] program.s
+//
+// With no file, the assembly is read from stdin. --quiet leaves out
+// the methods.
+int main(int argc, char** argv) {
+    SimulatorOptions options;
+    options.stepLimit = 100000000000LL;
+    options.stackSize = 64 << 20;
+    bool quiet = false;
+    std::string file;
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--limit=", 8)) {
+            options.stepLimit = atoll(argv[i] + 8);
+        } else if (!strncmp(argv[i], "--stack=", 8)) {
+            options.stackSize = atoi(argv[i] + 8) << 10;
+        } else if (!strcmp(argv[i], "--quiet")) {
+            quiet = true;
+        } else if (argv[i][0] != '-' && file.empty()) {
+            file = argv[i];
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::ostringstream text;
+    if (file.empty()) {
+        text << std::cin.rdbuf();
+    } else {
+        std::ifstream input(file, std::ios::binary);
+        if (!input) {
+            std::cerr << "Cannot read " << file << std::endl;
+            return 1;
+        }
+        text << input.rdbuf();
+    }
+
+    Simulation simulation;
+    try {
+        simulation = simulate(text.str(), std::cout, options);
+    } catch (const CompileError& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    std::cout.flush();
+    if (quiet) simulation.methods.clear();
+    printSimulation(simulation, std::cerr);
+    return 0;
+}
@@ -1,32 +1,280 @@
-#include "ast.hpp"
-#include "typecheck.hpp"
-#include "codegeneration.hpp"
-#include "parser.hpp"
+#include "cache.hpp"
+#include "compiler.hpp"
+#include "incremental.hpp"
+#include "interface.hpp"
+#include "options.hpp"
+#include "profile.hpp"
+#include "server.hpp"
+#include "timereport.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <vector>
 
 extern int yydebug;
-extern int yyparse();
 
-ASTNode* astRoot;
+static bool readFile(const std::string& name, std::string& text) {
+    std::ifstream file(name, std::ios::binary);
+    if (!file) return false;
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    text = contents.str();
+    return true;
+}
 
-int main(void) {
+int main(int argc, char** argv) {
     yydebug = 0; // Set this to 1 if you want the parser to output debug information and parse process
-    
-    astRoot = NULL;
-    
-    yyparse();
-    
-    if (astRoot) {
-        TypeCheck* typecheck = new TypeCheck();
-        astRoot->accept(typecheck);
-        ClassTable* classTable = typecheck->classTable;
-        if (classTable) {
-            // Uncomment the following line to print the class table after it is generated
-            //print(*classTable);
-            CodeGenerator* codegen = new CodeGenerator();
-            codegen->classTable = classTable;
-            astRoot->accept(codegen);
+
+    CompilerOptions options;
+    std::vector<std::string> files;
+    std::string optionText;
+    std::unique_ptr<Profile> profile;
+    std::unique_ptr<TimeReport> timeReport;
+    std::string serverSocket, connectSocket;
+    std::string cacheDirectory;
+    long long cacheBytes = 256LL << 20;
+    std::string incrementalFile;
+    std::vector<std::string> arguments;
+    std::string profileText;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            files.push_back(argv[i]);
+            continue;
+        }
+        if (!strcmp(argv[i], "--time-report")) {
+            timeReport.reset(new TimeReport());
+            continue;
+        }
+        if (!strcmp(argv[i], "--server")) {
+            serverSocket = "lang.sock";
+            continue;
+        }
+        if (!strncmp(argv[i], "--server=", 9)) {
+            serverSocket = argv[i] + 9;
+            continue;
+        }
+        if (!strncmp(argv[i], "--connect=", 10)) {
+            connectSocket = argv[i] + 10;
+            continue;
+        }
+        if (!strncmp(argv[i], "--cache-dir=", 12)) {
+            cacheDirectory = argv[i] + 12;
+            continue;
+        }
+        if (!strncmp(argv[i], "--cache-size=", 13)) {
+            cacheBytes = atoll(argv[i] + 13) << 20;
+            continue;
+        }
+        if (!strncmp(argv[i], "--incremental=", 14)) {
+            incrementalFile = argv[i] + 14;
+            continue;
+        }
+        // The output does not depend on -j, --no-stream or
+        // --time-report, so they are left out of the interface stamps.
+        if (strncmp(argv[i], "-j", 2) && strcmp(argv[i], "--no-stream"))
+            optionText += std::string(argv[i]) + " ";
+        if (!strncmp(argv[i], "--profile-use=", 14)) {
+            // The profile is part of the stamps of separately
+            // compiled files, as it changes their output.
+            std::string text;
+            if (!readFile(argv[i] + 14, text)) {
+                std::cerr << "Cannot read " << argv[i] + 14 << std::endl;
+                return 1;
+            }
+            if (!profile) profile.reset(new Profile());
+            try {
+                readProfile(text, *profile);
+            } catch (const CompileError& error) {
+                std::cerr << error.what() << std::endl;
+                return 1;
+            }
+            optionText += text;
+            profileText += text;
+        } else if (setOption(options, argv[i])) {
+            arguments.push_back(argv[i]);
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    if (!serverSocket.empty()) return runServer(serverSocket);
+
+    std::string error = checkOptions(options);
+    if (error.empty() && files.size() > 1 &&
+        (options.profileGenerate || options.profileTimers)) {
+        // The counters and timers need a single table for the
+        // runtime to find.
+        error = "--profile and --profile-generate take a single program";
+    }
+    if (!error.empty()) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    if (!incrementalFile.empty() && !files.empty()) {
+        // Separate compilation already skips the files which have
+        // not changed.
+        std::cerr << "--incremental takes a single program on stdin"
+                  << std::endl;
+        return 1;
+    }
+
+    if (!connectSocket.empty()) {
+        if (!files.empty()) {
+            std::cerr << "--connect takes a single program on stdin" << std::endl;
+            return 1;
+        }
+        std::ostringstream source;
+        source << std::cin.rdbuf();
+        return runClient(connectSocket, arguments, profileText, source.str());
+    }
+
+    // The cache keys cover what the output depends on, as the
+    // interface stamps do, and the compiler itself.
+    std::unique_ptr<CompilationCache> cache;
+    std::string version;
+    if (!cacheDirectory.empty()) {
+        // Without the compiler's version, entries made by another
+        // compiler could be taken for its own.
+        version = CompilationCache::compilerVersion(argv[0]);
+        if (version.empty())
+            std::cerr << "Cannot find the compiler, not using the cache"
+                      << std::endl;
+        else
+            cache.reset(new CompilationCache(cacheDirectory, cacheBytes));
+    }
+
+    CompileContext context;
+    context.profile = profile.get();
+    context.timeReport = timeReport.get();
+    std::unique_ptr<IncrementalState> incremental;
+    if (!incrementalFile.empty()) {
+        incremental.reset(new IncrementalState());
+        incremental->optionsKey = contentHash(optionText);
+        std::string text;
+        if (readFile(incrementalFile, text)) incremental->read(text);
+        context.incremental = incremental.get();
+    }
+    if (files.empty()) {
+        std::ostringstream input;
+        input << std::cin.rdbuf();
+        std::string source = input.str();
+        std::string key;
+        CacheEntry entry;
+        bool cached = false;
+        if (cache) {
+            if (timeReport) timeReport->begin("cache");
+            key = source + '\0' + optionText + '\0' + version;
+            cached = cache->find(key, entry);
+        }
+        if (!cached) {
+            CompileResult result = compile(source, options, context);
+            if (!result.success) {
+                std::cerr << result.error << std::endl;
+                return 1;
+            }
+            entry.output = std::move(result.output);
+            entry.interface = std::move(result.interface);
+            if (cache) {
+                if (timeReport) timeReport->begin("cache");
+                cache->store(key, entry);
+            }
+            if (incremental) {
+                if (timeReport) timeReport->begin("incremental");
+                std::ofstream(incrementalFile, std::ios::binary)
+                    << incremental->write();
+            }
+        }
+        if (timeReport) timeReport->begin("output");
+        std::cout << entry.output;
+        if (timeReport) {
+            timeReport->end();
+            timeReport->print(std::cerr);
+            if (incremental) {
+                std::cerr << "Methods: " << incremental->reused
+                          << " reused, " << incremental->generated
+                          << " generated" << std::endl;
+            }
+        }
+        return 0;
+    }
+
+    // Separate compilation: each file is compiled against the
+    // interfaces of the files before it, and skipped when neither
+    // its source, the options nor those interfaces have changed
+    // since the output was last written.
+    options.separateCompilation = true;
+    if (options.emit == emit_c) {
+        std::cerr << "--emit=c takes a single program on stdin" << std::endl;
+        return 1;
+    }
+    ClassTable imports;
+    context.imports = &imports;
+    std::string importedInterfaces;
+    for (auto& file : files) {
+        std::string source;
+        if (!readFile(file, source)) {
+            std::cerr << "Cannot read " << file << std::endl;
+            return 1;
+        }
+        std::string base = file;
+        if (base.size() > 5 && base.compare(base.size() - 5, 5, ".lang") == 0)
+            base.resize(base.size() - 5);
+        std::string outputName =
+            base + (options.emit == emit_object ? ".o" : ".s");
+        std::string interfaceName = base + ".langi";
+        std::string stamp = "# lang interface " +
+            contentHash(source + '\0' + optionText + '\0' + importedInterfaces);
+
+        std::string interface, output;
+        bool upToDate = readFile(interfaceName, interface) &&
+            readFile(outputName, output) &&
+            interface.compare(0, stamp.size() + 1, stamp + "\n") == 0;
+        if (!upToDate) {
+            std::string key;
+            CacheEntry entry;
+            bool cached = false;
+            if (cache) {
+                if (timeReport) timeReport->begin("cache");
+                key = source + '\0' + optionText + '\0' +
+                      importedInterfaces + '\0' + file + '\0' + version;
+                cached = cache->find(key, entry);
+            }
+            if (!cached) {
+                context.sourceFile = file;
+                CompileResult result = compile(source, options, context);
+                if (!result.success) {
+                    std::cerr << result.error << std::endl;
+                    return 1;
+                }
+                entry.output = std::move(result.output);
+                entry.interface = std::move(result.interface);
+                if (cache) {
+                    if (timeReport) timeReport->begin("cache");
+                    cache->store(key, entry);
+                }
+            }
+            if (timeReport) timeReport->begin("output");
+            std::ofstream(outputName, std::ios::binary) << entry.output;
+            interface = stamp + "\n" + entry.interface;
+            std::ofstream(interfaceName) << interface;
+            if (timeReport) timeReport->end();
+        }
+
+        try {
+            readInterface(interface, &imports);
+        } catch (const CompileError& error) {
+            std::cerr << file << ": " << error.what() << std::endl;
+            return 1;
         }
+        importedInterfaces += interface.substr(interface.find('\n') + 1);
     }
 
+    if (timeReport) timeReport->print(std::cerr);
     return 0;
 }
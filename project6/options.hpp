@@ -0,0 +1,125 @@
+#ifndef __OPTIONS_HPP
+#define __OPTIONS_HPP
+
+// Defines what the compiler writes to its output.
+typedef enum {
+  emit_assembly,  // AT&T assembly text (--emit=asm, the default)
+  emit_object,    // an ELF32 relocatable object (--emit=obj)
+  emit_c          // C source (--emit=c), see cgeneration.hpp
+} EmitKind;
+
+// Defines the options which control how the compiler lays out
+// objects and generates code. The main file fills these in
+// from the command line and hands a copy to each visitor.
+typedef struct compileroptions {
+  // Compact object layout (--compact-layout). Boolean members
+  // are packed into single bytes placed after all word-sized
+  // members of their class, and accessed with movzbl/movb.
+  bool compactLayout = false;
+
+  // Function specialization (--specialize, or -O1 and above).
+  // Calls whose arguments fold to constants are redirected to a
+  // clone of the callee with those parameters replaced by their
+  // values, when the callee is small or the call is in a loop.
+  bool specialize = false;
+  // The largest callee (in statements, counting nested ones)
+  // that is specialized at a call site outside of any loop.
+  int specializeStatementLimit = 12;
+  // The most clones generated for the whole program. What is left
+  // of it after each round is shared out among the methods of the
+  // next one (see CodeGenerator::generateRound).
+  int specializeCloneLimit = 64;
+
+  // Ahead-of-time evaluation (--aot-eval). Main.main is run at
+  // compile time within a budget of evaluation steps and bytes
+  // allocated (--aot-steps=N, --aot-memory=N). If it finishes,
+  // the program is replaced by a single write of its output.
+  // Otherwise normal code is generated, and with --aot-prefix
+  // the leading statements of Main.main which did finish are
+  // replaced by their output and the values they computed.
+  bool aotEvaluate = false;
+  bool aotFoldPrefix = false;
+  long long aotStepBudget = 10000000;
+  long long aotMemoryBudget = 64 << 20;
+
+  // Memoization of pure methods (--memoize, or -O2 and above).
+  // Each pure method with parameters gets a direct-mapped table
+  // of previous results keyed by its arguments (--memo-size=N
+  // entries, rounded up to a power of two). Profiling turns it
+  // off (see checkOptions).
+  bool memoize = false;
+  int memoTableSize = 1024;
+
+  // Optimize for size (-Os). Methods whose code is identical
+  // (ignoring comments and label numbers) are emitted once, with
+  // the others as aliases of it, and comparisons and loads of
+  // far members of this call shared helper routines instead of
+  // being expanded at every use. It turns off specialization and
+  // memoization, which grow the code, whatever order the options
+  // come in (see checkOptions).
+  bool optimizeSize = false;
+
+  // The optimization level (-O0, -O1, -O2), which checkOptions
+  // turns into the optimizations it includes.
+  int optimizationLevel = 0;
+
+  // The output format. Objects are encoded by the built-in
+  // assembler (see x86asm.hpp) and link with tester.c as the
+  // assembly does. C is left to the C compiler to optimize, so
+  // the options above which transform the generated assembly do
+  // not apply to it (the layout options do).
+  EmitKind emit = emit_assembly;
+
+  // Separate compilation (more than one source file on the command
+  // line). Every method symbol is made global so the other files
+  // can call it, and only one file needs a Main class.
+  bool separateCompilation = false;
+
+  // Profile-guided optimization. With --profile-generate, the
+  // program counts method calls and which way its branches go, and
+  // writes them to a profile at exit (see profile.hpp). With
+  // --profile-use=file, the profile decides which branch of an
+  // if/else falls through, moves code which never ran out of line
+  // and methods which were never called after the rest, lets calls
+  // to hot methods be specialized whatever their size and unrolls
+  // hot while loops with bodies of up to unrollStatementLimit
+  // statements.
+  bool profileGenerate = false;
+  int unrollStatementLimit = 8;
+
+  // Execution profiling (--profile). Every method is timed with
+  // rdtsc from its prologue to its epilogue, and the runtime in
+  // profile_runtime.c prints the cycles spent in each method and
+  // the calls between methods when the program exits.
+  bool profileTimers = false;
+
+  // Allocation profiling (--profile-alloc). Objects are allocated
+  // through the runtime in profile_runtime.c, which counts the
+  // objects and bytes allocated at each new, and prints them by
+  // class and by site (method and source line) when the program
+  // exits.
+  bool profileAllocations = false;
+
+  // Source line information (-g). The generated assembly maps its
+  // code to the lines of the source file with .file and .loc, for
+  // the assembler to turn into debugging information. The built-in
+  // assembler leaves it out.
+  bool debugLines = false;
+
+  // Class-at-a-time compilation (on unless --no-stream). Each class
+  // is type checked and its methods generated as soon as it has
+  // been parsed, and its tree deleted, so the memory a compilation
+  // needs grows with its largest class and its output rather than
+  // with the whole program. The options above which need the whole
+  // tree (specialization, ahead-of-time evaluation, profiles and C)
+  // keep it until the end instead. The output is the same either
+  // way.
+  bool streaming = true;
+
+  // The number of threads methods are generated on (-jN), with 0
+  // for one per processor. Each method is generated on its own,
+  // so the output is the same for any number.
+  int jobs = 0;
+} CompilerOptions;
+
+#endif
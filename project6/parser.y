@@ -3,16 +3,62 @@
     #include <stdlib.h>
     #include <iostream>
 
-    #include "ast.hpp"
-    
     #define YYDEBUG 1
     #define YYINITDEPTH 10000
-    int yylex(void);
-    void yyerror(const char *);
-    
-    extern ASTNode* astRoot;
 %}
 
+%code requires {
+    #include <functional>
+    #include <string>
+
+    #include "ast.hpp"
+
+    #ifndef YY_TYPEDEF_YY_SCANNER_T
+    #define YY_TYPEDEF_YY_SCANNER_T
+    typedef void* yyscan_t;
+    #endif
+
+    // Defines what a parse leaves behind: the tree, or the first
+    // error it ran into, and the number of lines it read. The
+    // scanner and the parser keep all their state in it and in the
+    // scanner, so any number of parses can run at once.
+    //
+    // The nodes belong to the ASTArena current during the parse.
+    //
+    // If classParsed is set, each class is handed to it as soon as
+    // it has been parsed instead of being added to the tree, whose
+    // program then has no classes.
+    typedef struct parsestate {
+        ASTNode* root = NULL;
+        std::string error;
+        int lines = 0;
+        std::function<void(ClassNode*)> classParsed;
+    } ParseState;
+}
+
+%code provides {
+    int yylex(YYSTYPE* yylval, yyscan_t scanner);
+
+    // Records an error at a line, unless there already is one.
+    void parseError(ParseState* state, int line, const char* message);
+
+    // Parses the source of a program (defined in lexer.l). Returns
+    // false if there is an error.
+    bool parseProgram(const std::string& source, ParseState& state);
+}
+
+%code {
+    int yyget_lineno(yyscan_t scanner);
+    void yyerror(yyscan_t scanner, ParseState* state, const char* message);
+
+    static IdentifierNode* identifier(char* name);
+    static ClassNode* classNode(char* name, char* superClassName, ClassNode* body);
+    static void addClass(ParseState* state, std::vector<ClassNode*>* classes, ClassNode* node);
+}
+
+%define api.pure full
+%lex-param   { yyscan_t scanner }
+%parse-param { yyscan_t scanner } { ParseState* state }
 %define parse.error verbose
 
 /* Tokens */
@@ -22,6 +68,7 @@
 %token T_BOOLEAN T_INTEGER T_NONE
 %token T_PLUS T_MINUS T_MULT T_DIV T_OPENPAREN T_CLOSEDPAREN
 %token T_ID T_NUMBER
+%token T_ERROR  /* returned by the scanner after an error */
 
 /* Precedence */
 %left T_OR
@@ -64,15 +111,15 @@
 /* Bison Grammar Specification */
 %%
 
-Start         : Classes { $$ = new ProgramNode($1); astRoot = $$; }
+Start         : Classes { $$ = new ProgramNode($1); state->root = $$; }
               ;
 
-Classes       : Classes Class { $$ = $1; $$->push_back($2); }
-              | Class         { $$ = new std::list<ClassNode*>(); $$->push_back($1); }
+Classes       : Classes Class { $$ = $1; addClass(state, $$, $2); }
+              | Class         { $$ = new std::vector<ClassNode*>(); addClass(state, $$, $1); }
               ;
 
-Class         : T_ID T_OPENCURLY ClassBody T_CLOSEDCURLY                { $$ = new ClassNode(new IdentifierNode($1), NULL, $3->declaration_list, $3->method_list); }
-              | T_ID T_EXTENDS T_ID T_OPENCURLY ClassBody T_CLOSEDCURLY { $$ = new ClassNode(new IdentifierNode($1), new IdentifierNode($3), $5->declaration_list, $5->method_list); }
+Class         : T_ID T_OPENCURLY ClassBody T_CLOSEDCURLY                { $$ = classNode($1, NULL, $3); }
+              | T_ID T_EXTENDS T_ID T_OPENCURLY ClassBody T_CLOSEDCURLY { $$ = classNode($1, $3, $5); }
               ;
 
 ClassBody     : Declarations Methods  { $$ = new ClassNode(NULL, NULL, $1, $2); }
@@ -82,32 +129,32 @@ ClassBody     : Declarations Methods  { $$ = new ClassNode(NULL, NULL, $1, $2);
               ;
 
 Methods       : Methods Method  { $$ = $1; $$->push_back($2); }
-              | Method          { $$ = new std::list<MethodNode*>(); $$->push_back($1); }
+              | Method          { $$ = new std::vector<MethodNode*>(); $$->push_back($1); }
               ;
 
-Method        : T_ID T_OPENPAREN Parameters T_CLOSEDPAREN T_ARROW Type T_OPENCURLY MethodBody T_CLOSEDCURLY { $$ = new MethodNode(new IdentifierNode($1), $3, $6, $8); }
+Method        : T_ID T_OPENPAREN Parameters T_CLOSEDPAREN T_ARROW Type T_OPENCURLY MethodBody T_CLOSEDCURLY { $$ = new MethodNode(identifier($1), $3, $6, $8); }
               ;
 
 Parameters    : Parameters Parameter  { $$ = $1; $$->push_back($2); }
-              | %empty                { $$ = new std::list<ParameterNode*>(); }
+              | %empty                { $$ = new std::vector<ParameterNode*>(); }
               ;
 
-Parameter     : Type T_ID         { $$ = new ParameterNode($1, new IdentifierNode($2)); }
-              | Type T_ID T_COMMA { $$ = new ParameterNode($1, new IdentifierNode($2)); }
+Parameter     : Type T_ID         { $$ = new ParameterNode($1, identifier($2)); }
+              | Type T_ID T_COMMA { $$ = new ParameterNode($1, identifier($2)); }
               ;
 
 MethodBody    : Declarations Statements Return  { $$ = new MethodBodyNode($1, $2, $3); }
               | Declarations Statements         { $$ = new MethodBodyNode($1, $2, NULL); }
-              | Declarations Return             { $$ = new MethodBodyNode($1, new std::list<StatementNode*>(), $2); }
-              | Declarations                    { $$ = new MethodBodyNode($1, new std::list<StatementNode*>(), NULL); }
-              | Statements Return               { $$ = new MethodBodyNode(new std::list<DeclarationNode*>(), $1, $2); }
-              | Statements                      { $$ = new MethodBodyNode(new std::list<DeclarationNode*>(), $1, NULL); }
-              | Return                          { $$ = new MethodBodyNode(new std::list<DeclarationNode*>(), new std::list<StatementNode*>(), $1); }
-              | %empty                          { $$ = new MethodBodyNode(new std::list<DeclarationNode*>(), new std::list<StatementNode*>(), NULL); }
+              | Declarations Return             { $$ = new MethodBodyNode($1, new std::vector<StatementNode*>(), $2); }
+              | Declarations                    { $$ = new MethodBodyNode($1, new std::vector<StatementNode*>(), NULL); }
+              | Statements Return               { $$ = new MethodBodyNode(new std::vector<DeclarationNode*>(), $1, $2); }
+              | Statements                      { $$ = new MethodBodyNode(new std::vector<DeclarationNode*>(), $1, NULL); }
+              | Return                          { $$ = new MethodBodyNode(new std::vector<DeclarationNode*>(), new std::vector<StatementNode*>(), $1); }
+              | %empty                          { $$ = new MethodBodyNode(new std::vector<DeclarationNode*>(), new std::vector<StatementNode*>(), NULL); }
               ;
 
 Declarations  : Declarations Declaration  { $$ = $1; $$->push_back($2); }
-              | Declaration               { $$ = new std::list<DeclarationNode*>(); $$->push_back($1); }
+              | Declaration               { $$ = new std::vector<DeclarationNode*>(); $$->push_back($1); }
               ;
 
 Declaration   : Type Ids T_SEMICOLON {$$ = new DeclarationNode($1, $2); }
@@ -116,15 +163,15 @@ Declaration   : Type Ids T_SEMICOLON {$$ = new DeclarationNode($1, $2); }
 Type          : T_BOOLEAN { $$ = new BooleanTypeNode(); }
               | T_INTEGER { $$ = new IntegerTypeNode(); }
               | T_NONE    { $$ = new NoneNode(); }
-              | T_ID      { $$ = new ObjectTypeNode(new IdentifierNode($1)); }
+              | T_ID      { $$ = new ObjectTypeNode(identifier($1)); }
               ;
 
-Ids           : Ids T_COMMA T_ID  { $$ = $1; $$->push_back(new IdentifierNode($3)); }
-              | T_ID              { $$ = new std::list<IdentifierNode*>(); $$->push_back(new IdentifierNode($1)); }
+Ids           : Ids T_COMMA T_ID  { $$ = $1; $$->push_back(identifier($3)); }
+              | T_ID              { $$ = new std::vector<IdentifierNode*>(); $$->push_back(identifier($1)); }
               ;
 
 Statements    : Statements Statement  { $$ = $1; $$->push_back($2); }
-              | Statement             { $$ = new std::list<StatementNode*>(); $$->push_back($1); }
+              | Statement             { $$ = new std::vector<StatementNode*>(); $$->push_back($1); }
               ;
 
 Statement     : Assignment              { $$ = $1; }
@@ -138,12 +185,12 @@ Statement     : Assignment              { $$ = $1; }
 Return        : T_RETURN Expression T_SEMICOLON { $$ = new ReturnStatementNode($2); }
               ;
 
-Assignment    : T_ID T_ASSIGN Expression T_SEMICOLON            { $$ = new AssignmentNode(new IdentifierNode($1), NULL, $3); }
-              | T_ID T_DOT T_ID T_ASSIGN Expression T_SEMICOLON { $$ = new AssignmentNode(new IdentifierNode($1), new IdentifierNode($3), $5); }
+Assignment    : T_ID T_ASSIGN Expression T_SEMICOLON            { $$ = new AssignmentNode(identifier($1), NULL, $3); }
+              | T_ID T_DOT T_ID T_ASSIGN Expression T_SEMICOLON { $$ = new AssignmentNode(identifier($1), identifier($3), $5); }
               ;
 
-MethodCall    : T_ID T_OPENPAREN Arguments T_CLOSEDPAREN            { $$ = new MethodCallNode(new IdentifierNode($1), NULL, $3); }
-              | T_ID T_DOT T_ID T_OPENPAREN Arguments T_CLOSEDPAREN { $$ = new MethodCallNode(new IdentifierNode($1), new IdentifierNode($3), $5); }
+MethodCall    : T_ID T_OPENPAREN Arguments T_CLOSEDPAREN            { $$ = new MethodCallNode(identifier($1), NULL, $3); }
+              | T_ID T_DOT T_ID T_OPENPAREN Arguments T_CLOSEDPAREN { $$ = new MethodCallNode(identifier($1), identifier($3), $5); }
               ;
 
 IfElse        : T_IF Expression Block               { $$ = new IfElseNode($2, $3, NULL); }
@@ -163,11 +210,11 @@ Print         : T_PRINT Expression T_SEMICOLON  { $$ = new PrintNode($2); }
               ;
 
 Arguments     : Arguments_  { $$ = $1; }
-              | %empty      { $$ = new std::list<ExpressionNode*>(); }                                 
+              | %empty      { $$ = new std::vector<ExpressionNode*>(); }                                 
               ;
 
 Arguments_    : Arguments T_COMMA Expression  { $$->push_back($3); }        
-              | Expression                    { $$ = new std::list<ExpressionNode*>(); $$->push_back($1); }                   
+              | Expression                    { $$ = new std::vector<ExpressionNode*>(); $$->push_back($1); }                   
               ;
 
 Expression    : Expression T_PLUS Expression                    { $$ = new PlusNode($1, $3); }
@@ -181,22 +228,47 @@ Expression    : Expression T_PLUS Expression                    { $$ = new PlusN
               | Expression T_OR Expression                      { $$ = new OrNode($1, $3); }
               | T_NOT Expression                                { $$ = new NotNode($2); }
               | T_MINUS Expression %prec T_NOT                  { $$ = new NegationNode($2); }
-              | T_ID                                            { $$ = new VariableNode(new IdentifierNode($1)); }
-              | T_ID T_DOT T_ID                                 { $$ = new MemberAccessNode(new IdentifierNode($1), new IdentifierNode($3)); }
+              | T_ID                                            { $$ = new VariableNode(identifier($1)); }
+              | T_ID T_DOT T_ID                                 { $$ = new MemberAccessNode(identifier($1), identifier($3)); }
               | MethodCall                                      { $$ = $1; }
               | T_OPENPAREN Expression T_CLOSEDPAREN            { $$ = $2; }
               | T_NUMBER                                        { $$ = new IntegerLiteralNode(new IntegerNode($1)); }
               | T_TRUE                                          { $$ = new BooleanLiteralNode(new IntegerNode($1)); }
               | T_FALSE                                         { $$ = new BooleanLiteralNode(new IntegerNode($1)); }
-              | T_NEW T_ID                                      { $$ = new NewNode(new IdentifierNode($2), new std::list<ExpressionNode*>()); }
-              | T_NEW T_ID T_OPENPAREN Arguments T_CLOSEDPAREN  { $$ = new NewNode(new IdentifierNode($2), $4); }
+              | T_NEW T_ID                                      { $$ = new NewNode(identifier($2), new std::vector<ExpressionNode*>()); }
+              | T_NEW T_ID T_OPENPAREN Arguments T_CLOSEDPAREN  { $$ = new NewNode(identifier($2), $4); }
               ;
 
 %%
 
-extern int yylineno;
+void parseError(ParseState* state, int line, const char* message) {
+  if (state->error.empty())
+    state->error = std::string(message) + " at line " + std::to_string(line);
+}
+
+void yyerror(yyscan_t scanner, ParseState* state, const char* message) {
+  parseError(state, yyget_lineno(scanner), message);
+}
+
+// The scanner copies the text of each identifier, which is copied
+// again into its node.
+static IdentifierNode* identifier(char* name) {
+  IdentifierNode* node = new IdentifierNode(name);
+  free(name);
+  return node;
+}
+
+// Makes a class of the members and methods collected in body.
+static ClassNode* classNode(char* name, char* superClassName, ClassNode* body) {
+  body->identifier_1 = identifier(name);
+  body->identifier_2 = superClassName ? identifier(superClassName) : NULL;
+  body->lineno = currentLineno;
+  return body;
+}
 
-void yyerror(const char *s) {
-  fprintf(stderr, "%s at line %d\n", s, yylineno);
-  exit(1);
+static void addClass(ParseState* state, std::vector<ClassNode*>* classes, ClassNode* node) {
+  if (state->classParsed)
+    state->classParsed(node);
+  else
+    classes->push_back(node);
 }
@@ -0,0 +1,67 @@
+#include "profile.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+static void addBranches(std::vector<StatementNode*>* statements,
+                        std::vector<StatementNode*>& branches) {
+  if (!statements) return;
+  for (auto stmt : *statements) {
+    if (auto ifElse = dynamic_cast<IfElseNode*>(stmt)) {
+      branches.push_back(stmt);
+      addBranches(ifElse->statement_list_1, branches);
+      addBranches(ifElse->statement_list_2, branches);
+    } else if (auto loop = dynamic_cast<WhileNode*>(stmt)) {
+      branches.push_back(stmt);
+      addBranches(loop->statement_list, branches);
+    } else if (auto loop = dynamic_cast<DoWhileNode*>(stmt)) {
+      branches.push_back(stmt);
+      addBranches(loop->statement_list, branches);
+    }
+  }
+}
+
+std::vector<StatementNode*> profiledBranches(MethodNode* method) {
+  std::vector<StatementNode*> branches;
+  addBranches(method->methodbody->statement_list, branches);
+  return branches;
+}
+
+void readProfile(const std::string& text, Profile& profile) {
+  std::istringstream lines(text);
+  std::string line;
+  long long mostCalls = 0;
+  while (std::getline(lines, line)) {
+    std::istringstream fields(line);
+    std::string kind, symbol;
+    if (!(fields >> kind) || kind[0] == '#') continue;
+    fields >> symbol;
+
+    if (kind == "method") {
+      long long calls = 0;
+      fields >> calls;
+      profile.calls[symbol] += calls;
+      mostCalls = std::max(mostCalls, profile.calls[symbol]);
+    } else if (kind == "branch") {
+      std::string number;
+      long long taken = 0, notTaken = 0;
+      fields >> number >> taken >> notTaken;
+      BranchCount& count = profile.branches[symbol + " " + number];
+      count.taken += taken;
+      count.notTaken += notTaken;
+    } else {
+      throw CompileError("Malformed profile line: " + line);
+    }
+  }
+  profile.hotCalls = std::max(1LL, mostCalls / 100);
+}
+
+long long callCount(Profile* profile, const std::string& symbol) {
+  auto calls = profile->calls.find(symbol);
+  return calls == profile->calls.end() ? 0 : calls->second;
+}
+
+bool hotMethod(Profile* profile, const std::string& symbol) {
+  return callCount(profile, symbol) >= profile->hotCalls;
+}
@@ -0,0 +1,50 @@
+#ifndef __PROFILE_HPP
+#define __PROFILE_HPP
+
+#include "ast.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Profiles record how often each method was called and which way
+// each branch (the condition of an if/else, while or do-while)
+// went in runs of a program built with --profile-generate. The
+// runtime in profile_runtime.c writes them at exit, one line per
+// counter:
+//
+//   method <Class_method> <calls>
+//   branch <Class_method> <n> <taken> <not taken>
+//
+// where the branches of a method are numbered in source order (see
+// profiledBranches), and a branch is taken when its condition is
+// true. The counts of several runs are appended to the same file
+// and add up. --profile-use=file reads them back to guide code
+// generation.
+
+typedef struct branchcount {
+  long long taken;
+  long long notTaken;
+} BranchCount;
+
+typedef struct profile {
+  std::map<std::string, long long> calls;
+  // Branches by method symbol and number, e.g. "Main_main 0".
+  std::map<std::string, BranchCount> branches;
+  // The fewest calls for a method to count as hot: 1% of the
+  // calls to the most called method.
+  long long hotCalls;
+} Profile;
+
+// Returns the branches of a method in the order they are numbered.
+std::vector<StatementNode*> profiledBranches(MethodNode* method);
+
+// Adds the counts in the text of a profile file to a profile.
+// Lines starting with # are ignored.
+void readProfile(const std::string& text, Profile& profile);
+
+// Returns how often a method was called in the profile.
+long long callCount(Profile* profile, const std::string& symbol);
+bool hotMethod(Profile* profile, const std::string& symbol);
+
+#endif
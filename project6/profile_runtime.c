@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The runtime for programs built with --profile-generate or
+// --profile, linked in with tester.c:
+//
+//   gcc -m32 -o program tester.c program.s profile_runtime.c
+//
+// With --profile-generate, the generated code counts into a table
+// of entries, one for each method and one for each branch in it,
+// which is written out (see profile.hpp) when the program exits.
+// The profile is appended to lang.profile, or to the file named by
+// LANG_PROFILE_FILE, so the counts of several runs add up.
+//
+// With --profile, every method calls __lang_profile_enter with its
+// number on entry and __lang_profile_exit on return, which time it
+// with rdtsc. A report of the cycles spent in each method and the
+// calls between them is printed to stderr when the program exits.
+//
+// With --profile-alloc, objects are allocated by __lang_allocate,
+// which counts them in the record of their allocation site. The
+// objects and bytes allocated by class and by site are printed to
+// stderr when the program exits.
+
+// Defines a counter entry. A method counts its calls in counts[0];
+// a branch counts how often it was taken in counts[0] and how
+// often its condition was evaluated in counts[1].
+typedef struct profileentry {
+  const char* name;
+  int isBranch;
+  unsigned counts[2];
+} ProfileEntry;
+
+// Defined by the generated code. They are weak so the runtime can
+// be linked with a program built without profiling.
+extern int __lang_profile_size __attribute__((weak));
+extern ProfileEntry __lang_profile_entries[] __attribute__((weak));
+extern int __lang_timer_size __attribute__((weak));
+extern const char* __lang_timer_names[] __attribute__((weak));
+
+__attribute__((destructor)) static void writeProfile(void) {
+  if (!&__lang_profile_size) return;
+
+  const char* name = getenv("LANG_PROFILE_FILE");
+  FILE* file = fopen(name ? name : "lang.profile", "a");
+  if (!file) {
+    perror("lang.profile");
+    return;
+  }
+  for (int i = 0; i < __lang_profile_size; i++) {
+    ProfileEntry* entry = &__lang_profile_entries[i];
+    if (entry->isBranch)
+      fprintf(file, "branch %s %u %u\n", entry->name, entry->counts[0],
+              entry->counts[1] - entry->counts[0]);
+    else
+      fprintf(file, "method %s %u\n", entry->name, entry->counts[0]);
+  }
+  fclose(file);
+}
+
+static unsigned long long readTimer(void) {
+  unsigned low, high;
+  __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+  return (unsigned long long)high << 32 | low;
+}
+
+// Defines the totals for a method. Inclusive cycles are only added
+// when its outermost call returns, so recursion is not counted
+// twice.
+typedef struct methodtimer {
+  unsigned long long calls;
+  unsigned long long selfCycles;
+  unsigned long long inclusiveCycles;
+  int active;
+} MethodTimer;
+
+// Defines a call in progress, on the shadow stack.
+typedef struct frame {
+  int method;
+  unsigned long long start;
+  unsigned long long childCycles;
+} Frame;
+
+// Defines the calls from one method to another. The caller of the
+// first method called (Main_main) is -1.
+typedef struct arc {
+  int caller;
+  int callee;
+  unsigned long long calls;
+} Arc;
+
+static MethodTimer* timers;
+static Frame* frames;
+static int depth, maxDepth;
+static Arc* arcs;
+static int arcCount, arcCapacity;
+
+// Arcs are kept in an open addressing hash table, which is doubled
+// when it is half full.
+static Arc* findArc(int caller, int callee) {
+  if (2 * (arcCount + 1) > arcCapacity) {
+    Arc* old = arcs;
+    int oldCapacity = arcCapacity;
+    arcCapacity = arcCapacity ? 2 * arcCapacity : 256;
+    arcs = calloc(arcCapacity, sizeof(Arc));
+    arcCount = 0;
+    for (int i = 0; i < oldCapacity; i++)
+      if (old[i].calls) *findArc(old[i].caller, old[i].callee) = old[i];
+    free(old);
+  }
+  unsigned hash = (unsigned)caller * 31 + (unsigned)callee;
+  for (int i = hash & (arcCapacity - 1);; i = (i + 1) & (arcCapacity - 1)) {
+    Arc* arc = &arcs[i];
+    if (!arc->calls) {
+      arc->caller = caller;
+      arc->callee = callee;
+      arcCount++;
+      return arc;
+    }
+    if (arc->caller == caller && arc->callee == callee) return arc;
+  }
+}
+
+void __lang_profile_enter(int method) {
+  if (!timers) timers = calloc(__lang_timer_size, sizeof(MethodTimer));
+  if (depth == maxDepth) {
+    maxDepth = maxDepth ? 2 * maxDepth : 1024;
+    frames = realloc(frames, maxDepth * sizeof(Frame));
+  }
+  findArc(depth ? frames[depth - 1].method : -1, method)->calls++;
+  timers[method].calls++;
+  timers[method].active++;
+  frames[depth].method = method;
+  frames[depth].childCycles = 0;
+  frames[depth++].start = readTimer();
+}
+
+void __lang_profile_exit(void) {
+  unsigned long long now = readTimer();
+  Frame* frame = &frames[--depth];
+  MethodTimer* timer = &timers[frame->method];
+  unsigned long long cycles = now - frame->start;
+  timer->selfCycles += cycles - frame->childCycles;
+  if (!--timer->active) timer->inclusiveCycles += cycles;
+  if (depth) frames[depth - 1].childCycles += cycles;
+}
+
+static int bySelfCycles(const void* a, const void* b) {
+  unsigned long long x = timers[*(const int*)a].selfCycles;
+  unsigned long long y = timers[*(const int*)b].selfCycles;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static int byCalls(const void* a, const void* b) {
+  unsigned long long x = ((const Arc*)a)->calls;
+  unsigned long long y = ((const Arc*)b)->calls;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+__attribute__((destructor)) static void printReport(void) {
+  if (!timers) return;
+
+  unsigned long long total = 0;
+  int* order = malloc(__lang_timer_size * sizeof(int));
+  for (int i = 0; i < __lang_timer_size; i++) {
+    order[i] = i;
+    total += timers[i].selfCycles;
+  }
+  qsort(order, __lang_timer_size, sizeof(int), bySelfCycles);
+
+  fprintf(stderr, "Flat profile:\n\n");
+  fprintf(stderr, "%6s %16s %16s %12s  %s\n", "%self", "self cycles",
+          "inclusive", "calls", "method");
+  for (int i = 0; i < __lang_timer_size; i++) {
+    MethodTimer* timer = &timers[order[i]];
+    if (!timer->calls) continue;
+    fprintf(stderr, "%6.2f %16llu %16llu %12llu  %s\n",
+            total ? 100.0 * timer->selfCycles / total : 0.0,
+            timer->selfCycles, timer->inclusiveCycles, timer->calls,
+            __lang_timer_names[order[i]]);
+  }
+
+  // The table is no longer needed as one, so its arcs are moved to
+  // the front to be sorted.
+  int count = 0;
+  for (int i = 0; i < arcCapacity; i++)
+    if (arcs[i].calls) arcs[count++] = arcs[i];
+  qsort(arcs, count, sizeof(Arc), byCalls);
+
+  fprintf(stderr, "\nCall graph:\n\n");
+  fprintf(stderr, "%12s  %s\n", "calls", "caller -> callee");
+  for (int i = 0; i < count; i++) {
+    const char* caller = arcs[i].caller < 0
+                             ? "<program>"
+                             : __lang_timer_names[arcs[i].caller];
+    fprintf(stderr, "%12llu  %s -> %s\n", arcs[i].calls, caller,
+            __lang_timer_names[arcs[i].callee]);
+  }
+  free(order);
+}
+
+// Defines the record the generated code keeps for each new. Sites
+// are linked into a list the first time they allocate.
+typedef struct allocationsite {
+  struct allocationsite* next;
+  unsigned objects;
+  unsigned long long bytes;
+  const char* className;
+  const char* method;
+  int line;
+} AllocationSite;
+
+static AllocationSite* sites;
+
+void* __lang_allocate(int size, AllocationSite* site) {
+  if (!site->objects++) {
+    site->next = sites;
+    sites = site;
+  }
+  site->bytes += size;
+  return malloc(size);
+}
+
+// Defines the totals for a class or a site. Clones of a method have
+// their own records for the same site, which are added together.
+typedef struct allocationtotal {
+  const char* className;
+  const char* method;
+  int line;
+  unsigned long long objects;
+  unsigned long long bytes;
+} AllocationTotal;
+
+static int sameSite(AllocationTotal* total, AllocationSite* site,
+                    int byClass) {
+  if (strcmp(total->className, site->className)) return 0;
+  return byClass ||
+         (total->line == site->line && !strcmp(total->method, site->method));
+}
+
+static int byBytes(const void* a, const void* b) {
+  unsigned long long x = ((const AllocationTotal*)a)->bytes;
+  unsigned long long y = ((const AllocationTotal*)b)->bytes;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static int addTotals(AllocationTotal* totals, int byClass) {
+  int count = 0;
+  for (AllocationSite* site = sites; site; site = site->next) {
+    int i = 0;
+    while (i < count && !sameSite(&totals[i], site, byClass)) i++;
+    if (i == count) {
+      totals[count].className = site->className;
+      totals[count].method = site->method;
+      totals[count].line = site->line;
+      totals[count].objects = totals[count].bytes = 0;
+      count++;
+    }
+    totals[i].objects += site->objects;
+    totals[i].bytes += site->bytes;
+  }
+  qsort(totals, count, sizeof(AllocationTotal), byBytes);
+  return count;
+}
+
+__attribute__((destructor)) static void printAllocations(void) {
+  if (!sites) return;
+
+  int size = 0;
+  for (AllocationSite* site = sites; site; site = site->next) size++;
+  AllocationTotal* totals = malloc(size * sizeof(AllocationTotal));
+
+  int count = addTotals(totals, 1);
+  fprintf(stderr, "Allocations by class:\n\n");
+  fprintf(stderr, "%16s %12s  %s\n", "bytes", "objects", "class");
+  for (int i = 0; i < count; i++)
+    fprintf(stderr, "%16llu %12llu  %s\n", totals[i].bytes,
+            totals[i].objects, totals[i].className);
+
+  count = addTotals(totals, 0);
+  fprintf(stderr, "\nAllocations by site:\n\n");
+  fprintf(stderr, "%16s %12s  %s\n", "bytes", "objects", "class at site");
+  for (int i = 0; i < count; i++)
+    fprintf(stderr, "%16llu %12llu  %s at %s line %d\n", totals[i].bytes,
+            totals[i].objects, totals[i].className, totals[i].method,
+            totals[i].line);
+  free(totals);
+}
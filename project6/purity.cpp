@@ -0,0 +1,166 @@
+#include "purity.hpp"
+
+static bool isValueType(CompoundType type) {
+  return type.baseType == bt_integer || type.baseType == bt_boolean;
+}
+
+// Only methods with integer and boolean parameters, locals and
+// return values can be pure. Constructors always return none.
+bool PurityCheck::isCandidate(MethodInfo& methodInfo) {
+  if (!isValueType(methodInfo.returnType)) return false;
+  for (auto& variable : *methodInfo.variables)
+    if (!isValueType(variable.second.type)) return false;
+  return true;
+}
+
+// The methods of other source files keep the purity recorded in
+// their interface files.
+void PurityCheck::checkClasses(std::vector<ClassNode*>* classes) {
+  for (auto classNode : *classes)
+    for (auto& method :
+         *classTable->at(classNode->identifier_1->name).methods)
+      method.second.pure = isCandidate(method.second);
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto classNode : *classes) {
+      currentClassName = classNode->identifier_1->name;
+      if (!classNode->method_list) continue;
+      for (auto method : *classNode->method_list) {
+        currentMethodInfo =
+            &classTable->at(currentClassName).methods->at(method->identifier->name);
+        if (!currentMethodInfo->pure) continue;
+
+        pure = true;
+        dispatch(method->methodbody);
+        if (!pure) {
+          currentMethodInfo->pure = false;
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+void PurityCheck::visitProgramNode(ProgramNode* node) {
+  checkClasses(node->class_list);
+}
+
+void PurityCheck::visitClassNode(ClassNode* node) {}
+
+void PurityCheck::visitMethodNode(MethodNode* node) {}
+
+void PurityCheck::visitMethodBodyNode(MethodBodyNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitParameterNode(ParameterNode* node) {}
+
+void PurityCheck::visitDeclarationNode(DeclarationNode* node) {}
+
+void PurityCheck::visitReturnStatementNode(ReturnStatementNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitAssignmentNode(AssignmentNode* node) {
+  if (node->identifier_2 ||
+      !currentMethodInfo->variables->count(node->identifier_1->name))
+    pure = false;
+  dispatch(node->expression);
+}
+
+void PurityCheck::visitCallNode(CallNode* node) { visit_children(node); }
+
+void PurityCheck::visitIfElseNode(IfElseNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitWhileNode(WhileNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitDoWhileNode(DoWhileNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitPrintNode(PrintNode* node) { pure = false; }
+
+void PurityCheck::visitPlusNode(PlusNode* node) { visit_children(node); }
+
+void PurityCheck::visitMinusNode(MinusNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitTimesNode(TimesNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitDivideNode(DivideNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitGreaterNode(GreaterNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitGreaterEqualNode(GreaterEqualNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitEqualNode(EqualNode* node) {
+  visit_children(node);
+}
+
+void PurityCheck::visitAndNode(AndNode* node) { visit_children(node); }
+
+void PurityCheck::visitOrNode(OrNode* node) { visit_children(node); }
+
+void PurityCheck::visitNotNode(NotNode* node) { visit_children(node); }
+
+void PurityCheck::visitNegationNode(NegationNode* node) {
+  visit_children(node);
+}
+
+// Pure methods have no object locals, so a call through a
+// variable (foo.bar()) is always through a member.
+void PurityCheck::visitMethodCallNode(MethodCallNode* node) {
+  visit_children(node);
+  if (node->identifier_2) {
+    pure = false;
+    return;
+  }
+
+  std::string methodName = node->identifier_1->name;
+  ClassInfo classInfo = classTable->at(currentClassName);
+  while (!classInfo.methods->count(methodName))
+    classInfo = classTable->at(classInfo.superClassName);
+  if (!classInfo.methods->at(methodName).pure) pure = false;
+}
+
+void PurityCheck::visitMemberAccessNode(MemberAccessNode* node) {
+  pure = false;
+}
+
+void PurityCheck::visitVariableNode(VariableNode* node) {
+  if (!currentMethodInfo->variables->count(node->identifier->name))
+    pure = false;
+}
+
+void PurityCheck::visitIntegerLiteralNode(IntegerLiteralNode* node) {}
+
+void PurityCheck::visitBooleanLiteralNode(BooleanLiteralNode* node) {}
+
+void PurityCheck::visitNewNode(NewNode* node) { pure = false; }
+
+void PurityCheck::visitIntegerTypeNode(IntegerTypeNode* node) {}
+
+void PurityCheck::visitBooleanTypeNode(BooleanTypeNode* node) {}
+
+void PurityCheck::visitObjectTypeNode(ObjectTypeNode* node) {}
+
+void PurityCheck::visitNoneNode(NoneNode* node) {}
+
+void PurityCheck::visitIdentifierNode(IdentifierNode* node) {}
+
+void PurityCheck::visitIntegerNode(IntegerNode* node) {}
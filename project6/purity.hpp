@@ -0,0 +1,74 @@
+#ifndef __PURITY_HPP
+#define __PURITY_HPP
+
+#include "ast.hpp"
+#include "typecheck.hpp"
+
+// This defines the PurityCheck visitor, which runs after the
+// TypeCheck visitor and marks the methods whose result depends
+// only on their arguments (the pure flag in their MethodInfo).
+// A method is pure if:
+//   - its parameters, locals and return value are all integers
+//     or booleans,
+//   - it does not read or write any members, allocate objects
+//     or print, and
+//   - it only calls pure methods.
+//
+// Every candidate starts out pure and the bodies are checked
+// again until nothing changes, so recursive methods are pure
+// unless something else in them is not.
+class PurityCheck final : public Visitor, public StaticVisitor<PurityCheck> {
+private:
+  std::string currentClassName;
+  MethodInfo* currentMethodInfo;
+  bool pure;
+
+  bool isCandidate(MethodInfo& methodInfo);
+
+public:
+  ClassTable* classTable;
+
+  // Marks the methods of classes. The methods of the classes
+  // before them must have been marked already, as those are all
+  // they can call.
+  void checkClasses(std::vector<ClassNode*>* classes);
+
+  virtual void visitProgramNode(ProgramNode* node);
+  virtual void visitClassNode(ClassNode* node);
+  virtual void visitMethodNode(MethodNode* node);
+  virtual void visitMethodBodyNode(MethodBodyNode* node);
+  virtual void visitParameterNode(ParameterNode* node);
+  virtual void visitDeclarationNode(DeclarationNode* node);
+  virtual void visitReturnStatementNode(ReturnStatementNode* node);
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitIfElseNode(IfElseNode* node);
+  virtual void visitWhileNode(WhileNode* node);
+  virtual void visitDoWhileNode(DoWhileNode* node);
+  virtual void visitPrintNode(PrintNode* node);
+  virtual void visitPlusNode(PlusNode* node);
+  virtual void visitMinusNode(MinusNode* node);
+  virtual void visitTimesNode(TimesNode* node);
+  virtual void visitDivideNode(DivideNode* node);
+  virtual void visitGreaterNode(GreaterNode* node);
+  virtual void visitGreaterEqualNode(GreaterEqualNode* node);
+  virtual void visitEqualNode(EqualNode* node);
+  virtual void visitAndNode(AndNode* node);
+  virtual void visitOrNode(OrNode* node);
+  virtual void visitNotNode(NotNode* node);
+  virtual void visitNegationNode(NegationNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+  virtual void visitIntegerLiteralNode(IntegerLiteralNode* node);
+  virtual void visitBooleanLiteralNode(BooleanLiteralNode* node);
+  virtual void visitNewNode(NewNode* node);
+  virtual void visitIntegerTypeNode(IntegerTypeNode* node);
+  virtual void visitBooleanTypeNode(BooleanTypeNode* node);
+  virtual void visitObjectTypeNode(ObjectTypeNode* node);
+  virtual void visitNoneNode(NoneNode* node);
+  virtual void visitIdentifierNode(IdentifierNode* node);
+  virtual void visitIntegerNode(IntegerNode* node);
+};
+
+#endif
@@ -35,8 +35,16 @@ def runTests():
 		asm = f + ".s"
 		outfile = open(asm, 'w')
 
+		# Tests of errors which need their own files give the
+		# arguments of lang in a leading comment.
+		args = []
+		first = infile.readline()
+		if (first.startswith("/* langtest:")):
+			args = first[len("/* langtest:"):].partition("*/")[0].split()
+		infile.seek(0)
+
 		print("./lang < " + f + ":")
-		p = Popen(["./lang"], stdin=infile, stdout=outfile, stderr=PIPE)
+		p = Popen(["./lang"] + args, stdin=infile, stdout=outfile, stderr=PIPE)
 		(out, err) = p.communicate()
 
 		try:
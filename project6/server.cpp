@@ -0,0 +1,417 @@
+#include "server.hpp"
+#include "compiler.hpp"
+#include "interface.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// The most output the result cache holds.
+#define RESULT_CACHE_BYTES (64 << 20)
+// The most a request may send, in all its fields.
+#define REQUEST_BYTES (64 << 20)
+// The most imports and profiles each the server keeps parsed.
+#define PARSED_CACHE_ENTRIES 64
+// The fewest connections served at once, whatever the processors.
+#define MIN_WORKERS 4
+// The most accepted connections waiting for a worker.
+#define QUEUED_CONNECTIONS 256
+
+// Reads and writes the fields of requests and replies on a socket.
+class Connection {
+private:
+  int fd;
+
+public:
+  explicit Connection(int fd) : fd(fd) {}
+  ~Connection() { close(fd); }
+
+  bool readBytes(char* data, size_t size) {
+    while (size > 0) {
+      ssize_t count = read(fd, data, size);
+      if (count <= 0) return false;
+      data += count;
+      size -= count;
+    }
+    return true;
+  }
+
+  bool writeBytes(const char* data, size_t size) {
+    while (size > 0) {
+      ssize_t count = write(fd, data, size);
+      if (count <= 0) return false;
+      data += count;
+      size -= count;
+    }
+    return true;
+  }
+
+  // Why the connection is being closed, if the client should be
+  // told.
+  std::string error;
+
+  // Reads a field of at most limit bytes, returning false at the end
+  // of the connection or on a malformed or oversized field.
+  bool readField(std::string& name, std::string& value, size_t limit) {
+    std::string line;
+    char c;
+    while (readBytes(&c, 1) && c != '\n') {
+      line += c;
+      if (line.size() > 256) return false;
+    }
+    size_t space = line.find(' ');
+    if (space == std::string::npos) return false;
+    name = line.substr(0, space);
+    char* end;
+    unsigned long long size = strtoull(line.c_str() + space + 1, &end, 10);
+    if (*end || end == line.c_str() + space + 1) return false;
+    if (size > limit) {
+      error = "Request too large: field " + name;
+      return false;
+    }
+    value.resize(size);
+    return size == 0 || readBytes(&value[0], size);
+  }
+
+  bool writeField(const std::string& name, const std::string& value) {
+    std::string line = name + " " + std::to_string(value.size()) + "\n";
+    return writeBytes(line.data(), line.size()) &&
+           writeBytes(value.data(), value.size());
+  }
+};
+
+// Parsed texts by the text itself, up to PARSED_CACHE_ENTRIES of them.
+// Adding one more drops the least recently used, which lives on
+// while requests still hold it.
+template <class T>
+class ParsedCache {
+private:
+  std::map<std::string, std::pair<std::shared_ptr<T>, long long> > entries;
+  long long clock = 0;
+
+public:
+  std::shared_ptr<T> find(const std::string& key) {
+    auto found = entries.find(key);
+    if (found == entries.end()) return std::shared_ptr<T>();
+    found->second.second = ++clock;
+    return found->second.first;
+  }
+
+  // Returns the entry for the key, which is value unless another
+  // thread added one first.
+  std::shared_ptr<T> add(const std::string& key, std::shared_ptr<T> value) {
+    std::shared_ptr<T> found = find(key);
+    if (found) return found;
+    if (entries.size() >= PARSED_CACHE_ENTRIES) {
+      auto oldest = entries.begin();
+      for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+        if (entry->second.second < oldest->second.second) oldest = entry;
+      }
+      entries.erase(oldest);
+    }
+    entries[key] = std::make_pair(value, ++clock);
+    return value;
+  }
+};
+
+// A result of the cache, with the request it answers and the hash
+// the request is indexed by.
+typedef struct cachedresult {
+  std::string key;
+  std::string request;
+  CompileResult result;
+
+  size_t bytes() const {
+    return request.size() + result.output.size() + result.interface.size();
+  }
+} CachedResult;
+
+// The caches the server keeps warm between requests, shared by the
+// threads serving connections.
+class ServerCache {
+private:
+  std::mutex mutex;
+  ParsedCache<ClassTable> imports;
+  ParsedCache<Profile> profiles;
+  // Results by the hash of their request, the most recently used
+  // first. A result is only used for the very request it answers,
+  // so requests with the same hash never share one.
+  std::list<CachedResult> results;
+  std::map<std::string, std::list<CachedResult>::iterator> resultIndex;
+  size_t resultBytes = 0;
+
+public:
+  std::shared_ptr<ClassTable> classes(const std::string& text);
+  std::shared_ptr<Profile> profile(const std::string& text);
+  bool findResult(const std::string& request, CompileResult& result);
+  void addResult(const std::string& request, const CompileResult& result);
+};
+
+// Returns the class table of the interfaces in text, reading them
+// the first time they are asked for.
+std::shared_ptr<ClassTable> ServerCache::classes(const std::string& text) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<ClassTable> found = imports.find(text);
+    if (found) return found;
+  }
+  std::shared_ptr<ClassTable> table(new ClassTable());
+  readInterface(text, table.get());
+  std::lock_guard<std::mutex> lock(mutex);
+  return imports.add(text, table);
+}
+
+std::shared_ptr<Profile> ServerCache::profile(const std::string& text) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<Profile> found = profiles.find(text);
+    if (found) return found;
+  }
+  std::shared_ptr<Profile> profile(new Profile());
+  readProfile(text, *profile);
+  std::lock_guard<std::mutex> lock(mutex);
+  return profiles.add(text, profile);
+}
+
+bool ServerCache::findResult(const std::string& request,
+                             CompileResult& result) {
+  std::string key = contentHash(request);
+  std::lock_guard<std::mutex> lock(mutex);
+  auto found = resultIndex.find(key);
+  if (found == resultIndex.end() || found->second->request != request)
+    return false;
+  results.splice(results.begin(), results, found->second);
+  result = found->second->result;
+  return true;
+}
+
+void ServerCache::addResult(const std::string& request,
+                            const CompileResult& result) {
+  std::string key = contentHash(request);
+  std::lock_guard<std::mutex> lock(mutex);
+  if (resultIndex.count(key)) return;
+  results.push_front(CachedResult{key, request, result});
+  resultIndex[key] = results.begin();
+  resultBytes += results.front().bytes();
+  while (resultBytes > RESULT_CACHE_BYTES && results.size() > 1) {
+    resultBytes -= results.back().bytes();
+    resultIndex.erase(results.back().key);
+    results.pop_back();
+  }
+}
+
+// Compiles the program of a request, or finds it in the cache.
+static CompileResult serveRequest(ServerCache& cache,
+                                  const std::vector<std::string>& arguments,
+                                  const std::string& profileText,
+                                  const std::string& importText,
+                                  const std::string& file,
+                                  const std::string& source) {
+  CompileResult result;
+  CompilerOptions options;
+  std::string request = source + '\0' + file + '\0' + importText + '\0' +
+                        profileText;
+  for (const std::string& argument : arguments) {
+    if (!setOption(options, argument)) {
+      result.error = "Unknown option: " + argument;
+      return result;
+    }
+    request += '\0' + argument;
+  }
+  result.error = checkOptions(options);
+  if (!result.error.empty()) return result;
+
+  if (cache.findResult(request, result)) return result;
+  CompileContext context;
+  std::shared_ptr<ClassTable> imports;
+  std::shared_ptr<Profile> profile;
+  try {
+    if (!importText.empty()) imports = cache.classes(importText);
+    if (!profileText.empty()) profile = cache.profile(profileText);
+  } catch (const CompileError& error) {
+    result.error = error.what();
+    return result;
+  }
+  context.imports = imports.get();
+  context.profile = profile.get();
+  if (!file.empty()) context.sourceFile = file;
+  result = compile(source, options, context);
+  cache.addResult(request, result);
+  return result;
+}
+
+static void serveRequests(ServerCache& cache, Connection& connection) {
+  std::vector<std::string> arguments;
+  std::string profileText, importText, file;
+  std::string name, value;
+  size_t requestBytes = 0;
+  while (connection.readField(name, value, REQUEST_BYTES - requestBytes)) {
+    requestBytes += value.size();
+    if (name == "option") {
+      arguments.push_back(value);
+    } else if (name == "profile") {
+      profileText += value;
+    } else if (name == "import") {
+      importText += value;
+    } else if (name == "file") {
+      file = value;
+    } else if (name == "source") {
+      CompileResult result = serveRequest(cache, arguments, profileText,
+                                          importText, file, value);
+      bool sent = result.success ? connection.writeField("ok", result.output)
+                                 : connection.writeField("error", result.error);
+      if (!sent) return;
+      arguments.clear();
+      profileText.clear();
+      importText.clear();
+      file.clear();
+      requestBytes = 0;
+    } else {
+      connection.writeField("error", "Unknown request field: " + name);
+      return;
+    }
+  }
+  if (!connection.error.empty()) connection.writeField("error", connection.error);
+}
+
+// Serves a connection on a worker thread. Nothing thrown may leave
+// the thread, which would end the server.
+static void serveConnection(ServerCache& cache, int fd) {
+  Connection connection(fd);
+  try {
+    serveRequests(cache, connection);
+  } catch (const std::exception& error) {
+    connection.writeField("error", std::string("Internal server error: ") +
+                                       error.what());
+  }
+}
+
+// The accepted connections waiting for a worker. Accepting waits
+// while the queue is full, leaving further clients in the listen
+// backlog.
+class ConnectionQueue {
+private:
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<int> fds;
+
+public:
+  void push(int fd) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&]() { return fds.size() < QUEUED_CONNECTIONS; });
+    fds.push_back(fd);
+    changed.notify_all();
+  }
+
+  int pop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&]() { return !fds.empty(); });
+    int fd = fds.front();
+    fds.pop_front();
+    changed.notify_all();
+    return fd;
+  }
+};
+
+static bool socketAddress(const std::string& path, sockaddr_un& address) {
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) return false;
+  strcpy(address.sun_path, path.c_str());
+  return true;
+}
+
+int runServer(const std::string& socketPath) {
+  sockaddr_un address;
+  if (!socketAddress(socketPath, address)) {
+    std::cerr << "Socket path too long: " << socketPath << std::endl;
+    return 1;
+  }
+  // Only a socket left behind by an earlier server is removed.
+  struct stat info;
+  if (!lstat(socketPath.c_str(), &info)) {
+    if (!S_ISSOCK(info.st_mode)) {
+      std::cerr << socketPath << " exists and is not a socket" << std::endl;
+      return 1;
+    }
+    unlink(socketPath.c_str());
+  }
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) ||
+      listen(listener, 64)) {
+    std::cerr << "Cannot listen on " << socketPath << ": " << strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  // A client going away must not end the server.
+  signal(SIGPIPE, SIG_IGN);
+
+  // A fixed number of workers serve the connections, one processor
+  // each, so that many clients cannot start threads without bound.
+  // They live as long as the process, as do the cache and queue.
+  static ServerCache cache;
+  static ConnectionQueue queue;
+  int workers = std::max<int>(MIN_WORKERS, std::thread::hardware_concurrency());
+  for (int i = 0; i < workers; i++) {
+    std::thread([]() {
+      for (;;) serveConnection(cache, queue.pop());
+    }).detach();
+  }
+  for (;;) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      std::cerr << "accept: " << strerror(errno) << std::endl;
+      return 1;
+    }
+    queue.push(fd);
+  }
+}
+
+int runClient(const std::string& socketPath,
+              const std::vector<std::string>& options,
+              const std::string& profile, const std::string& source) {
+  sockaddr_un address;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (!socketAddress(socketPath, address) || fd < 0 ||
+      connect(fd, (sockaddr*)&address, sizeof(address))) {
+    std::cerr << "Cannot connect to " << socketPath << std::endl;
+    if (fd >= 0) close(fd);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  Connection connection(fd);
+  bool sent = true;
+  for (const std::string& option : options)
+    sent = sent && connection.writeField("option", option);
+  if (!profile.empty()) sent = sent && connection.writeField("profile", profile);
+  sent = sent && connection.writeField("source", source);
+
+  std::string name, value;
+  if (!sent || !connection.readField(name, value, std::string().max_size())) {
+    std::cerr << "The server on " << socketPath << " did not reply"
+              << std::endl;
+    return 1;
+  }
+  if (name != "ok") {
+    std::cerr << value << std::endl;
+    return 1;
+  }
+  std::cout << value;
+  return 0;
+}
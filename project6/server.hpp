@@ -0,0 +1,49 @@
+#ifndef __SERVER_HPP
+#define __SERVER_HPP
+
+#include <string>
+#include <vector>
+
+// The compile server (lang --server[=socket]) compiles programs
+// sent to it over a Unix domain socket (lang.sock by default), so
+// that a build issuing many small compilations pays for starting
+// the compiler once. Connections are served by a fixed pool of
+// threads, one per processor (at least 4), and may send any number
+// of requests each; further connections wait for a thread to be
+// free.
+//
+// A request is a sequence of fields, each a line with a name and
+// the length of its value, followed by that many bytes:
+//
+//   option <length>   a command line option, e.g. -O2
+//   profile <length>  the text of a profile, for --profile-use
+//   import <length>   the interface of a class the program uses
+//   file <length>     the name of the source file
+//   source <length>   the program, which ends the request
+//
+// and the reply is a single field, "ok" with the output or "error"
+// with the message. A request may send at most 64 MB in all; a
+// field which would go over is answered with an error, and the
+// connection closed.
+//
+// The server keeps what it has parsed between requests: the
+// imports and the profiles (the last 64 used of each), by their
+// text, and the results of the last compilations (up to 64 MB of
+// output), by everything the request sent. A request the same as
+// an earlier one is answered without compiling it again.
+
+// Serves requests on the socket until the process is killed. A
+// socket left at the path by an earlier server is replaced, but not
+// a file of any other kind. Returns the exit status if the socket
+// cannot be opened.
+int runServer(const std::string& socketPath);
+
+// Sends a program to the server on the socket, compiled with the
+// options (command line arguments) and the profile text, and
+// writes the output to stdout or the error to stderr. Returns the
+// exit status for lang --connect.
+int runClient(const std::string& socketPath,
+              const std::vector<std::string>& options,
+              const std::string& profile, const std::string& source);
+
+#endif
@@ -0,0 +1,528 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Runs the tests in tests/ in parallel and compares what they print
+// against output.txt, the way runtests.py and compare.py do:
+//
+//   ./langtest [-j <threads>] [--timeout=<seconds>] [--sim[=<langsim>]]
+//              [--link=<command>] [--golden=<file>] [--times]
+//              [--known-failure=<test>...] [tests...] [-- <compiler flags>]
+//
+// Every test is compiled with lang, linked with tester.c and run,
+// each step with the timeout. With --sim the assembly is run by
+// langsim instead, which needs no 32-bit C library. --link replaces
+// the gcc command; {exe} and {asm} in it stand for the program and
+// the output of lang (a .o with --emit=obj, a .c with --emit=c). The
+// tests are those named, by number or by file, or else all of
+// tests/*.lang. --times prints the compile, link and run time of
+// every test, slowest first. A test named with --known-failure fails
+// for a known bug: its failure is listed but does not fail the run.
+//
+// {state} in the compiler flags stands for a file of the test's own
+// (for --incremental=). A test whose flags have it is compiled
+// twice, and the second output, made from the state the first one
+// left, is run. When the test has a file named like it but ending in
+// .before instead of .lang, the first compilation is of that file,
+// as if the test had been edited from it since. A test which starts
+// with a comment
+//
+//   /* langtest: <arguments> */
+//
+// is compiled with those arguments instead of the flags, for the
+// tests of errors which need their own files.
+
+typedef struct processresult {
+  int status;          // exit status, or -1 if killed or not started
+  bool timedOut;
+  std::string out;
+  std::string err;
+  double seconds;
+} ProcessResult;
+
+typedef struct testcase {
+  std::string file;
+  std::string output;  // in the format of runtests.py
+  double compileSeconds;
+  double linkSeconds;
+  double runSeconds;
+  bool passed;
+} TestCase;
+
+typedef struct runneroptions {
+  std::string lang = "./lang";
+  std::string golden = "output.txt";
+  std::string link;
+  std::string langsim;
+  std::vector<std::string> flags;
+  std::set<std::string> knownFailures;
+  double timeout = 10;
+  int jobs = 0;
+  bool times = false;
+} RunnerOptions;
+
+// Held while creating pipes and forking, so that no child inherits
+// the pipes of another test before they are marked close-on-exec.
+static std::mutex forkMutex;
+
+static double since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static bool makePipe(int fds[2]) {
+  if (pipe(fds)) return false;
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  return true;
+}
+
+// Runs a command with the input on its stdin, collecting its stdout
+// and stderr. It is killed once it runs for longer than the timeout.
+static ProcessResult runProcess(const std::vector<std::string>& command,
+                                const std::string& input, double timeout) {
+  ProcessResult result = {-1, false, "", "", 0};
+  std::vector<char*> argv;
+  for (const std::string& arg : command)
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(NULL);
+
+  auto start = std::chrono::steady_clock::now();
+  int in[2], out[2], err[2];
+  pid_t pid;
+  {
+    std::lock_guard<std::mutex> lock(forkMutex);
+    if (!makePipe(in)) return result;
+    if (!makePipe(out)) {
+      close(in[0]); close(in[1]);
+      return result;
+    }
+    if (!makePipe(err)) {
+      close(in[0]); close(in[1]); close(out[0]); close(out[1]);
+      return result;
+    }
+    pid = fork();
+    if (pid == 0) {
+      // In a group of its own, so that a timeout kills whatever
+      // the command started too (gcc's assembler and linker).
+      setpgid(0, 0);
+      dup2(in[0], 0);
+      dup2(out[1], 1);
+      dup2(err[1], 2);
+      execvp(argv[0], argv.data());
+      _exit(127);
+    }
+  }
+  close(in[0]);
+  close(out[1]);
+  close(err[1]);
+  // Set in both processes, so the group exists whichever runs first.
+  if (pid > 0) setpgid(pid, pid);
+  if (pid < 0) {
+    close(in[1]); close(out[0]); close(err[0]);
+    return result;
+  }
+
+  fcntl(in[1], F_SETFL, O_NONBLOCK);
+  size_t written = 0;
+  if (input.empty()) {
+    close(in[1]);
+    in[1] = -1;
+  }
+  char buffer[1 << 16];
+  while (out[0] >= 0 || err[0] >= 0) {
+    double left = timeout - since(start);
+    if (left <= 0) {
+      result.timedOut = true;
+      kill(-pid, SIGKILL);
+      break;
+    }
+    struct pollfd fds[3];
+    int n = 0;
+    if (in[1] >= 0) fds[n++] = {in[1], POLLOUT, 0};
+    if (out[0] >= 0) fds[n++] = {out[0], POLLIN, 0};
+    if (err[0] >= 0) fds[n++] = {err[0], POLLIN, 0};
+    int ready = poll(fds, n, (int)(left * 1000) + 1);
+    if (ready < 0 && errno != EINTR) break;
+    if (ready <= 0) continue;
+    for (int i = 0; i < n; i++) {
+      if (!fds[i].revents) continue;
+      int fd = fds[i].fd;
+      if (fd == in[1]) {
+        ssize_t count = write(fd, input.data() + written, input.size() - written);
+        if (count > 0) written += count;
+        if (count < 0 && errno != EAGAIN) written = input.size();
+        if (written == input.size()) {
+          close(in[1]);
+          in[1] = -1;
+        }
+        continue;
+      }
+      ssize_t count = read(fd, buffer, sizeof(buffer));
+      if (count > 0) {
+        (fd == out[0] ? result.out : result.err).append(buffer, count);
+      } else if (count == 0 || errno != EINTR) {
+        close(fd);
+        (fd == out[0] ? out[0] : err[0]) = -1;
+      }
+    }
+  }
+  if (in[1] >= 0) close(in[1]);
+  if (out[0] >= 0) close(out[0]);
+  if (err[0] >= 0) close(err[0]);
+
+  int status;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+  if (!result.timedOut && WIFEXITED(status))
+    result.status = WEXITSTATUS(status);
+  result.seconds = since(start);
+  return result;
+}
+
+static bool readFile(const std::string& name, std::string& text) {
+  std::ifstream file(name, std::ios::binary);
+  if (!file) return false;
+  std::ostringstream buffer;
+  buffer << file.rdbuf();
+  text = buffer.str();
+  return true;
+}
+
+static bool writeFile(const std::string& name, const std::string& text) {
+  std::ofstream file(name, std::ios::binary);
+  file << text;
+  return (bool)file;
+}
+
+static std::string header(const std::string& file) {
+  return "./lang < " + file + ":";
+}
+
+// Reduces output to its non-empty lines, stripped, as compare.py
+// compares it, and without the "Output:" lines.
+static std::vector<std::string> normalize(const std::string& text) {
+  std::vector<std::string> lines;
+  std::istringstream input(text);
+  std::string line;
+  while (std::getline(input, line)) {
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos) continue;
+    line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+    if (line != "Output:") lines.push_back(line);
+  }
+  return lines;
+}
+
+// Splits the golden output into the output of each test, by the file
+// of the test.
+static std::map<std::string, std::string> readGolden(const std::string& text) {
+  std::map<std::string, std::string> golden;
+  std::istringstream input(text);
+  std::string line;
+  std::string* current = NULL;
+  while (std::getline(input, line)) {
+    if (line.compare(0, 9, "./lang < ") == 0 && line.back() == ':') {
+      current = &golden[line.substr(9, line.size() - 10)];
+    } else if (current) {
+      *current += line + "\n";
+    }
+  }
+  return golden;
+}
+
+// Orders the tests as runtests.py does: the good tests before the bad
+// ones, each by number.
+static bool testOrder(const std::string& a, const std::string& b) {
+  std::string baseA = a.substr(a.rfind('/') + 1);
+  std::string baseB = b.substr(b.rfind('/') + 1);
+  std::string endA = baseA.substr(baseA.find('.'));
+  std::string endB = baseB.substr(baseB.find('.'));
+  if (endA != endB) return endA > endB;
+  return atoi(baseA.c_str()) < atoi(baseB.c_str());
+}
+
+static std::vector<std::string> listTests() {
+  std::vector<std::string> tests;
+  DIR* dir = opendir("tests");
+  if (!dir) return tests;
+  while (struct dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name.size() > 5 && name.compare(name.size() - 5, 5, ".lang") == 0)
+      tests.push_back("tests/" + name);
+  }
+  closedir(dir);
+  std::sort(tests.begin(), tests.end(), testOrder);
+  return tests;
+}
+
+static std::vector<std::string> splitCommand(const std::string& command) {
+  std::vector<std::string> words;
+  std::istringstream input(command);
+  std::string word;
+  while (input >> word) words.push_back(word);
+  return words;
+}
+
+static std::string replaceAll(std::string text, const std::string& from,
+                              const std::string& to) {
+  for (size_t at = text.find(from); at != std::string::npos;
+       at = text.find(from, at + to.size()))
+    text.replace(at, from.size(), to);
+  return text;
+}
+
+// Returns the arguments of a test's leading langtest comment, or
+// the flags if it has none.
+static std::vector<std::string> testFlags(const std::string& source,
+                                          const RunnerOptions& options) {
+  const std::string start = "/* langtest:";
+  if (source.compare(0, start.size(), start) != 0) return options.flags;
+  size_t end = source.find("*/");
+  return splitCommand(source.substr(start.size(), end - start.size()));
+}
+
+// Compiles, links and runs a test in the directory, leaving what it
+// prints in test.output.
+static void runTest(TestCase& test, const RunnerOptions& options,
+                    const std::string& directory, int number) {
+  std::string source;
+  if (!readFile(test.file, source)) {
+    test.output = "Cannot read " + test.file + "\n";
+    return;
+  }
+  std::string base = directory + "/" + std::to_string(number);
+  std::string state = base + ".state";
+  std::string extension = ".s";
+  std::vector<std::string> command = {options.lang};
+  bool twice = false;
+  for (const std::string& flag : testFlags(source, options)) {
+    command.push_back(replaceAll(flag, "{state}", state));
+    twice |= command.back() != flag;
+    if (flag == "--emit=obj") extension = ".o";
+    if (flag == "--emit=c") extension = ".c";
+  }
+  std::string before;
+  if (!twice || !readFile(test.file.substr(0, test.file.size() - 5) + ".before",
+                          before))
+    before = source;
+  ProcessResult compiled = runProcess(command, before, options.timeout);
+  if (twice && !compiled.timedOut && compiled.status == 0)
+    compiled = runProcess(command, source, options.timeout);
+  if (twice) unlink(state.c_str());
+  test.compileSeconds = compiled.seconds;
+  if (compiled.timedOut) {
+    test.output = "Compiling timed out.\n";
+    return;
+  }
+  if (!compiled.err.empty()) {
+    std::vector<std::string> errors = normalize(compiled.err);
+    test.output = errors.size() > 1 ? "Multiple errors produced.\n"
+                                    : compiled.err + "\n";
+    return;
+  }
+
+  std::string asm_ = base + extension;
+  std::string exe = base;
+  if (!writeFile(asm_, compiled.out)) {
+    test.output = "Cannot write " + asm_ + "\n";
+    return;
+  }
+
+  ProcessResult ran;
+  if (!options.langsim.empty()) {
+    ran = runProcess({options.langsim, "--quiet", asm_}, "", options.timeout);
+  } else {
+    std::vector<std::string> link;
+    if (!options.link.empty()) {
+      link = splitCommand(replaceAll(replaceAll(options.link, "{exe}", exe),
+                                     "{asm}", asm_));
+    } else {
+      link = {"gcc", "-m32"};
+#ifdef __APPLE__
+      link.push_back("-Wl,-no_pie");
+#endif
+      link.insert(link.end(), {"-o", exe, "tester.c", asm_});
+    }
+    ProcessResult linked = runProcess(link, "", options.timeout);
+    test.linkSeconds = linked.seconds;
+    if (linked.status != 0) {
+      test.output = linked.timedOut ? "Linking timed out.\n"
+                                    : "Assembling and linking failed.\n";
+      unlink(asm_.c_str());
+      return;
+    }
+    ran = runProcess({exe}, "", options.timeout);
+    unlink(exe.c_str());
+  }
+  unlink(asm_.c_str());
+  test.runSeconds = ran.seconds;
+  if (ran.timedOut) {
+    test.output = "Timed out.\n";
+  } else if (ran.status != 0) {
+    test.output = "Exited with an error.\n";
+  } else {
+    test.output = "Output:\n" + ran.out + "\n";
+  }
+}
+
+// Returns the file of a test named by number or by file.
+static std::string testFile(const std::string& name) {
+  if (name.find_first_not_of("0123456789") == std::string::npos)
+    return "tests/" + name + ".good.lang";
+  return name;
+}
+
+int main(int argc, char** argv) {
+  // A test which exits without reading its input must not kill the
+  // runner as it writes the rest.
+  signal(SIGPIPE, SIG_IGN);
+  RunnerOptions options;
+  std::vector<std::string> tests;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--") {
+      options.flags.assign(argv + i + 1, argv + argc);
+      break;
+    } else if (arg == "-j" && i + 1 < argc) {
+      options.jobs = atoi(argv[++i]);
+    } else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2) {
+      options.jobs = atoi(arg.c_str() + 2);
+    } else if (arg.compare(0, 10, "--timeout=") == 0) {
+      options.timeout = atof(arg.c_str() + 10);
+    } else if (arg == "--sim") {
+      options.langsim = "./langsim";
+    } else if (arg.compare(0, 6, "--sim=") == 0) {
+      options.langsim = arg.substr(6);
+    } else if (arg.compare(0, 7, "--link=") == 0) {
+      options.link = arg.substr(7);
+    } else if (arg.compare(0, 7, "--lang=") == 0) {
+      options.lang = arg.substr(7);
+    } else if (arg.compare(0, 9, "--golden=") == 0) {
+      options.golden = arg.substr(9);
+    } else if (arg == "--times") {
+      options.times = true;
+    } else if (arg.compare(0, 16, "--known-failure=") == 0) {
+      options.knownFailures.insert(testFile(arg.substr(16)));
+    } else if (arg[0] != '-') {
+      tests.push_back(testFile(arg));
+    } else {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  if (access(options.lang.c_str(), X_OK)) {
+    std::cerr << "No `lang` executable." << std::endl;
+    return 1;
+  }
+  std::string goldenText;
+  if (!readFile(options.golden, goldenText)) {
+    std::cerr << "Cannot read " << options.golden << std::endl;
+    return 1;
+  }
+  std::map<std::string, std::string> golden = readGolden(goldenText);
+  if (tests.empty()) tests = listTests();
+  if (tests.empty()) {
+    std::cerr << "No tests." << std::endl;
+    return 1;
+  }
+
+  char directoryTemplate[] = "/tmp/langtest.XXXXXX";
+  if (!mkdtemp(directoryTemplate)) {
+    std::cerr << "Cannot create a temporary directory" << std::endl;
+    return 1;
+  }
+  std::string directory = directoryTemplate;
+
+  std::vector<TestCase> cases;
+  for (const std::string& file : tests)
+    cases.push_back({file, "", 0, 0, 0, false});
+  int jobs = options.jobs > 0 ? options.jobs
+                              : std::max(1u, std::thread::hardware_concurrency());
+  jobs = std::min(jobs, (int)cases.size());
+
+  // The workers take the next test until none are left.
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < jobs; i++) {
+    workers.push_back(std::thread([&]() {
+      for (size_t t = next++; t < cases.size(); t = next++)
+        runTest(cases[t], options, directory, (int)t);
+    }));
+  }
+  for (std::thread& worker : workers) worker.join();
+  double elapsed = since(start);
+  rmdir(directory.c_str());
+
+  std::vector<std::string> failed, known;
+  for (TestCase& test : cases) {
+    auto expected = golden.find(test.file);
+    test.passed = expected != golden.end() &&
+                  normalize(test.output) == normalize(expected->second);
+    if (!test.passed && options.knownFailures.count(test.file)) {
+      known.push_back(test.file);
+    } else if (!test.passed) {
+      failed.push_back(test.file);
+      std::cout << header(test.file) << std::endl;
+      std::cout << test.output;
+      if (expected == golden.end()) {
+        std::cout << "(not in " << options.golden << ")" << std::endl;
+      } else {
+        std::cout << "Expected:" << std::endl << expected->second;
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  if (options.times) {
+    std::vector<const TestCase*> slowest;
+    for (const TestCase& test : cases) slowest.push_back(&test);
+    std::sort(slowest.begin(), slowest.end(),
+              [](const TestCase* a, const TestCase* b) {
+                return a->compileSeconds + a->linkSeconds + a->runSeconds >
+                       b->compileSeconds + b->linkSeconds + b->runSeconds;
+              });
+    printf("%-24s %10s %10s %10s\n", "test", "compile ms", "link ms", "run ms");
+    for (const TestCase* test : slowest) {
+      printf("%-24s %10.1f %10.1f %10.1f%s\n", test->file.c_str(),
+             1000 * test->compileSeconds, 1000 * test->linkSeconds,
+             1000 * test->runSeconds, test->passed ? "" : "  FAILED");
+    }
+    printf("\n");
+  }
+
+  printf("%d/%d tests passed in %.2f seconds on %d threads.\n",
+         (int)(cases.size() - failed.size() - known.size()), (int)cases.size(),
+         elapsed, jobs);
+  if (!known.empty()) {
+    printf("Known failures:\n");
+    for (const std::string& file : known) printf(" %s\n", file.c_str());
+  }
+  if (!failed.empty()) {
+    printf("Failed tests:\n");
+    for (const std::string& file : failed) printf(" %s\n", file.c_str());
+    return 1;
+  }
+  return 0;
+}
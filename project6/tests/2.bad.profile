@@ -0,0 +1,2 @@
+method Main_main 1
+calls Main_main 1
@@ -0,0 +1,253 @@
+#include "timereport.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sys/resource.h>
+
+// Code generation allocates from several threads, so the counts are
+// atomic. The operators are not inlined, which would let GCC see
+// free called on memory from new and warn.
+static std::atomic<long long> allocationCount(0);
+static std::atomic<long long> allocationBytes(0);
+
+__attribute__((noinline)) void* operator new(std::size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  allocationBytes.fetch_add(size, std::memory_order_relaxed);
+  void* pointer = malloc(size ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+__attribute__((noinline)) void operator delete(void* pointer) noexcept {
+  free(pointer);
+}
+
+// std::stable_sort takes its buffer from the nothrow forms, which
+// must allocate as the others free.
+__attribute__((noinline)) void* operator new(std::size_t size,
+                                             const std::nothrow_t&) noexcept {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  allocationBytes.fetch_add(size, std::memory_order_relaxed);
+  return malloc(size ? size : 1);
+}
+
+__attribute__((noinline)) void operator delete(void* pointer,
+                                               const std::nothrow_t&) noexcept {
+  free(pointer);
+}
+
+// Counts the nodes of a tree by type.
+class NodeCounter : public Visitor {
+public:
+  std::map<std::string, long long>* nodes;
+
+  virtual void visitProgramNode(ProgramNode* node);
+  virtual void visitClassNode(ClassNode* node);
+  virtual void visitMethodNode(MethodNode* node);
+  virtual void visitMethodBodyNode(MethodBodyNode* node);
+  virtual void visitParameterNode(ParameterNode* node);
+  virtual void visitDeclarationNode(DeclarationNode* node);
+  virtual void visitReturnStatementNode(ReturnStatementNode* node);
+  virtual void visitAssignmentNode(AssignmentNode* node);
+  virtual void visitCallNode(CallNode* node);
+  virtual void visitIfElseNode(IfElseNode* node);
+  virtual void visitWhileNode(WhileNode* node);
+  virtual void visitDoWhileNode(DoWhileNode* node);
+  virtual void visitPrintNode(PrintNode* node);
+  virtual void visitPlusNode(PlusNode* node);
+  virtual void visitMinusNode(MinusNode* node);
+  virtual void visitTimesNode(TimesNode* node);
+  virtual void visitDivideNode(DivideNode* node);
+  virtual void visitGreaterNode(GreaterNode* node);
+  virtual void visitGreaterEqualNode(GreaterEqualNode* node);
+  virtual void visitEqualNode(EqualNode* node);
+  virtual void visitAndNode(AndNode* node);
+  virtual void visitOrNode(OrNode* node);
+  virtual void visitNotNode(NotNode* node);
+  virtual void visitNegationNode(NegationNode* node);
+  virtual void visitMethodCallNode(MethodCallNode* node);
+  virtual void visitMemberAccessNode(MemberAccessNode* node);
+  virtual void visitVariableNode(VariableNode* node);
+  virtual void visitIntegerLiteralNode(IntegerLiteralNode* node);
+  virtual void visitBooleanLiteralNode(BooleanLiteralNode* node);
+  virtual void visitNewNode(NewNode* node);
+  virtual void visitIntegerTypeNode(IntegerTypeNode* node);
+  virtual void visitBooleanTypeNode(BooleanTypeNode* node);
+  virtual void visitObjectTypeNode(ObjectTypeNode* node);
+  virtual void visitNoneNode(NoneNode* node);
+  virtual void visitIdentifierNode(IdentifierNode* node);
+  virtual void visitIntegerNode(IntegerNode* node);
+};
+
+// Every visit counts the node and goes on to its children.
+#define COUNT_NODE(Name)                                  \
+  void NodeCounter::visit##Name##Node(Name##Node* node) { \
+    (*nodes)[#Name]++;                                    \
+    node->visit_children(this);                           \
+  }
+
+COUNT_NODE(Program)
+COUNT_NODE(Class)
+COUNT_NODE(Method)
+COUNT_NODE(MethodBody)
+COUNT_NODE(Parameter)
+COUNT_NODE(Declaration)
+COUNT_NODE(ReturnStatement)
+COUNT_NODE(Assignment)
+COUNT_NODE(Call)
+COUNT_NODE(IfElse)
+COUNT_NODE(While)
+COUNT_NODE(DoWhile)
+COUNT_NODE(Print)
+COUNT_NODE(Plus)
+COUNT_NODE(Minus)
+COUNT_NODE(Times)
+COUNT_NODE(Divide)
+COUNT_NODE(Greater)
+COUNT_NODE(GreaterEqual)
+COUNT_NODE(Equal)
+COUNT_NODE(And)
+COUNT_NODE(Or)
+COUNT_NODE(Not)
+COUNT_NODE(Negation)
+COUNT_NODE(MethodCall)
+COUNT_NODE(MemberAccess)
+COUNT_NODE(Variable)
+COUNT_NODE(IntegerLiteral)
+COUNT_NODE(BooleanLiteral)
+COUNT_NODE(New)
+COUNT_NODE(IntegerType)
+COUNT_NODE(BooleanType)
+COUNT_NODE(ObjectType)
+COUNT_NODE(None)
+COUNT_NODE(Identifier)
+COUNT_NODE(Integer)
+
+#undef COUNT_NODE
+
+// Returns the peak resident set size in kilobytes. On Linux it is
+// read from /proc, as the ru_maxrss of a process started by fork and
+// exec can be that of its parent.
+static long long peakMemory() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line))
+    if (line.compare(0, 6, "VmHWM:") == 0) return atoll(line.c_str() + 6);
+
+  // ru_maxrss is in kilobytes on Linux and in bytes on macOS.
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+TimeReport::TimeReport()
+    : current(NULL), lines(0), classes(0), methods(0), members(0),
+      variables(0) {}
+
+void TimeReport::begin(const std::string& phase) {
+  end();
+  for (auto& time : phases)
+    if (time.name == phase) current = &time;
+  if (!current) {
+    phases.push_back(PhaseTime{phase, 0, 0, 0});
+    current = &phases.back();
+  }
+  startAllocations = allocationCount;
+  startBytes = allocationBytes;
+  start = std::chrono::steady_clock::now();
+}
+
+void TimeReport::end() {
+  if (!current) return;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  current->seconds += elapsed.count();
+  current->allocations += allocationCount - startAllocations;
+  current->bytes += allocationBytes - startBytes;
+  current = NULL;
+}
+
+void TimeReport::countNodes(ASTNode* root) {
+  NodeCounter counter;
+  counter.nodes = &nodes;
+  root->accept(&counter);
+}
+
+void TimeReport::countSymbols(ClassTable* classTable, ProgramNode* program) {
+  for (auto classNode : *program->class_list)
+    countSymbols(classTable, classNode->identifier_1->name);
+}
+
+void TimeReport::countSymbols(ClassTable* classTable,
+                              const std::string& className) {
+  ClassInfo& classInfo = classTable->at(className);
+  classes++;
+  members += classInfo.members->size();
+  for (auto& method : *classInfo.methods) {
+    methods++;
+    variables += method.second.variables->size();
+  }
+}
+
+void TimeReport::print(std::ostream& out) {
+  end();
+  char line[128];
+
+  out << "Time report:" << std::endl << std::endl;
+  snprintf(line, sizeof(line), "  %-12s %12s %12s %14s", "phase", "seconds",
+           "allocations", "bytes");
+  out << line << std::endl;
+  PhaseTime total{"total", 0, 0, 0};
+  for (auto& time : phases) {
+    total.seconds += time.seconds;
+    total.allocations += time.allocations;
+    total.bytes += time.bytes;
+  }
+  phases.push_back(total);
+  for (auto& time : phases) {
+    snprintf(line, sizeof(line), "  %-12s %12.6f %12lld %14lld",
+             time.name.c_str(), time.seconds, time.allocations, time.bytes);
+    out << line << std::endl;
+  }
+  phases.pop_back();
+  if (total.seconds > 0 && lines > 0) {
+    snprintf(line, sizeof(line), "  %.0f lines/second", lines / total.seconds);
+    out << line << std::endl;
+  }
+
+  // Node types are listed from the most common.
+  std::vector<std::pair<std::string, long long> > counts(nodes.begin(),
+                                                         nodes.end());
+  std::stable_sort(counts.begin(), counts.end(),
+                   [](const std::pair<std::string, long long>& a,
+                      const std::pair<std::string, long long>& b) {
+                     return a.second > b.second;
+                   });
+  long long totalNodes = 0;
+  out << std::endl << "AST nodes (" << lines << " lines):" << std::endl
+      << std::endl;
+  for (auto& count : counts) {
+    snprintf(line, sizeof(line), "  %12lld  %s", count.second,
+             count.first.c_str());
+    out << line << std::endl;
+    totalNodes += count.second;
+  }
+  snprintf(line, sizeof(line), "  %12lld  total", totalNodes);
+  out << line << std::endl;
+
+  out << std::endl << "Class table: " << classes << " classes, " << methods
+      << " methods, " << members << " members, " << variables
+      << " parameters and locals" << std::endl;
+
+  out << std::endl << "Peak RSS: " << peakMemory() << " KB" << std::endl;
+  out << "Allocations: " << allocationCount << " (" << allocationBytes
+      << " bytes)" << std::endl;
+}
@@ -0,0 +1,61 @@
+#ifndef __TIMEREPORT_HPP
+#define __TIMEREPORT_HPP
+
+#include "ast.hpp"
+#include "typecheck.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// The report printed by --time-report: the wall time and the
+// allocations of each phase of the compiler, the size of the
+// program and of its class table, and the peak memory use. Phases
+// with the same name add up, so a report covers all the files of a
+// separate compilation.
+//
+// Allocations are counted by the global operator new, which is
+// replaced in timereport.cpp and counts whether or not a report was
+// asked for.
+
+typedef struct phasetime {
+  std::string name;
+  double seconds;
+  long long allocations;
+  long long bytes;
+} PhaseTime;
+
+class TimeReport {
+private:
+  std::vector<PhaseTime> phases;
+  PhaseTime* current;
+  std::chrono::steady_clock::time_point start;
+  long long startAllocations;
+  long long startBytes;
+
+public:
+  long long lines;
+  std::map<std::string, long long> nodes;
+  long long classes;
+  long long methods;
+  long long members;
+  long long variables;
+
+  TimeReport();
+
+  // Ends the current phase, if any, and starts timing another.
+  void begin(const std::string& phase);
+  void end();
+
+  // Adds the nodes of a tree and the class table entries of the
+  // classes a program declares.
+  void countNodes(ASTNode* root);
+  void countSymbols(ClassTable* classTable, ProgramNode* program);
+  void countSymbols(ClassTable* classTable, const std::string& className);
+
+  void print(std::ostream& out);
+};
+
+#endif
@@ -3,80 +3,86 @@
 // Defines the function used to throw type errors. The possible
 // type errors are defined as an enumeration in the header file.
 void typeError(TypeErrorCode code) {
+  std::string message;
   switch (code) {
     case undefined_variable:
-      std::cerr << "Undefined variable." << std::endl;
+      message = "Undefined variable.";
       break;
     case undefined_method:
-      std::cerr << "Method does not exist." << std::endl;
+      message = "Method does not exist.";
       break;
     case undefined_class:
-      std::cerr << "Class does not exist." << std::endl;
+      message = "Class does not exist.";
       break;
     case undefined_member:
-      std::cerr << "Class member does not exist." << std::endl;
+      message = "Class member does not exist.";
       break;
     case not_object:
-      std::cerr << "Variable is not an object." << std::endl;
+      message = "Variable is not an object.";
       break;
     case expression_type_mismatch:
-      std::cerr << "Expression types do not match." << std::endl;
+      message = "Expression types do not match.";
       break;
     case argument_number_mismatch:
-      std::cerr << "Method called with incorrect number of arguments."
-                << std::endl;
+      message = "Method called with incorrect number of arguments.";
       break;
     case argument_type_mismatch:
-      std::cerr << "Method called with argument of incorrect type."
-                << std::endl;
+      message = "Method called with argument of incorrect type.";
       break;
     case while_predicate_type_mismatch:
-      std::cerr << "Predicate of while loop is not boolean." << std::endl;
+      message = "Predicate of while loop is not boolean.";
       break;
     case do_while_predicate_type_mismatch:
-      std::cerr << "Predicate of do while loop is not boolean." << std::endl;
+      message = "Predicate of do while loop is not boolean.";
       break;
     case if_predicate_type_mismatch:
-      std::cerr << "Predicate of if statement is not boolean." << std::endl;
+      message = "Predicate of if statement is not boolean.";
       break;
     case assignment_type_mismatch:
-      std::cerr << "Left and right hand sides of assignment types mismatch."
-                << std::endl;
+      message = "Left and right hand sides of assignment types mismatch.";
       break;
     case return_type_mismatch:
-      std::cerr << "Return statement type does not match declared return type."
-                << std::endl;
+      message = "Return statement type does not match declared return type.";
       break;
     case constructor_returns_type:
-      std::cerr << "Class constructor returns a value." << std::endl;
+      message = "Class constructor returns a value.";
       break;
     case no_main_class:
-      std::cerr << "The \"Main\" class was not found." << std::endl;
+      message = "The \"Main\" class was not found.";
       break;
     case main_class_members_present:
-      std::cerr << "The \"Main\" class has members." << std::endl;
+      message = "The \"Main\" class has members.";
       break;
     case no_main_method:
-      std::cerr << "The \"Main\" class does not have a \"main\" method."
-                << std::endl;
+      message = "The \"Main\" class does not have a \"main\" method.";
       break;
     case main_method_incorrect_signature:
-      std::cerr << "The \"main\" method of the \"Main\" class has an incorrect "
-                   "signature."
-                << std::endl;
+      message = "The \"main\" method of the \"Main\" class has an incorrect "
+                "signature.";
       break;
   }
-  exit(1);
+  throw CompileError(message);
 }
 
 // TypeCheck Visitor Functions: These are the functions you will
 // complete to build the symbol table and type check the program.
 // Not all functions must have code, many may be left empty.
 
+void TypeCheck::beginProgram() {
+  ownedClassTable.reset(new ClassTable(imports));
+  classTable = ownedClassTable.get();
+}
+
+void TypeCheck::endProgram() {
+  // Under separate compilation Main is in just one of the files.
+  if (!classTable->count("Main") && !options.separateCompilation)
+    typeError(no_main_class);
+}
+
 void TypeCheck::visitProgramNode(ProgramNode* node) {
-  classTable = new ClassTable();
-  node->visit_children(this);
-  if (!classTable->count("Main")) typeError(no_main_class);
+  beginProgram();
+  visit_children(node);
+  endProgram();
 }
 
 void TypeCheck::visitClassNode(ClassNode* node) {
@@ -89,8 +95,10 @@ void TypeCheck::visitClassNode(ClassNode* node) {
   // are members or local variables. (see visitDeclarationNode)
   currentLocalOffset = 0;
   currentMemberOffset = 0;
-  currentMethodTable = new MethodTable();
-  currentVariableTable = new VariableTable();
+  std::shared_ptr<MethodTable> methods(new MethodTable());
+  std::shared_ptr<VariableTable> members(new VariableTable());
+  currentMethodTable = methods.get();
+  currentVariableTable = members.get();
   currentClassName = node->identifier_1->name;
 
   if (currentClassName == "Main") {
@@ -105,34 +113,86 @@ void TypeCheck::visitClassNode(ClassNode* node) {
     if (!found_main_method) typeError(no_main_method);
   }
 
-  ClassInfo classInfo{superClassName, currentMethodTable, currentVariableTable,
-                      currentMemberOffset};
+  ClassInfo classInfo{superClassName, methods, members, currentMemberOffset};
   (*classTable)[currentClassName] = classInfo;
 
-  node->visit_children(this);
+  visit_children(node);
 
+  if (options.compactLayout) packMembers();
   (*classTable)[currentClassName].membersSize = currentMemberOffset;
 }
 
+void TypeCheck::packMembers() {
+  VariableTable* members = (*classTable)[currentClassName].members.get();
+
+  // Members were given consecutive words in declaration order,
+  // so sorting by offset recovers that order.
+  std::map<int, VariableInfo*> declared;
+  for (auto& member : *members) declared[member.second.offset] = &member.second;
+
+  currentMemberOffset = 0;
+  for (auto& member : declared) {
+    if (member.second->type.baseType == bt_boolean) continue;
+    member.second->offset = currentMemberOffset;
+    currentMemberOffset += 4;
+  }
+  for (auto& member : declared) {
+    if (member.second->type.baseType != bt_boolean) continue;
+    member.second->offset = currentMemberOffset;
+    member.second->size = 1;
+    currentMemberOffset += 1;
+  }
+
+  // Keep the members of subclasses word aligned.
+  currentMemberOffset = (currentMemberOffset + 3) & ~3;
+}
+
 void TypeCheck::visitMethodNode(MethodNode* node) {
   currentLocalOffset = -4;
   currentParameterOffset = 12;
-  currentVariableTable = new VariableTable();
+  std::shared_ptr<VariableTable> variables(new VariableTable());
+  currentVariableTable = variables.get();
 
-  node->visit_children(this);
+  dispatch(node->identifier);
+  if (node->parameter_list) {
+    for (auto param : *node->parameter_list) dispatch(param);
+  }
+  dispatch(node->type);
   node->basetype = node->type->basetype;
   node->objectClassName = node->type->objectClassName;
 
+  std::shared_ptr<std::list<CompoundType> > parameters(
+      new std::list<CompoundType>());
+  if (node->parameter_list) {
+    for (auto param : (*node->parameter_list)) {
+      CompoundType type{param->type->basetype, param->type->objectClassName};
+      parameters->push_back(type);
+    }
+  }
+
+  // Enter the signature before checking the body, so the method
+  // can call itself. The locals size is filled in afterwards.
+  CompoundType returnType{node->basetype, node->objectClassName};
+  MethodInfo methodInfo{returnType, variables, parameters, 0};
+  (*currentMethodTable)[node->identifier->name] = methodInfo;
+
+  dispatch(node->methodbody);
+
   if (node->methodbody->basetype != node->basetype ||
       node->methodbody->objectClassName != node->objectClassName) {
-    // Check superclass
+    // Check superclass, if an object is returned where one of
+    // another class is expected.
+    if (node->methodbody->basetype != bt_object ||
+        node->basetype != bt_object ||
+        !classTable->count(node->methodbody->objectClassName))
+      typeError(return_type_mismatch);
     std::string superClass =
         classTable->at(node->methodbody->objectClassName).superClassName;
-    while (!superClass.empty()) {
+    while (!superClass.empty() && classTable->count(superClass)) {
       if (superClass == node->objectClassName) break;
       superClass = classTable->at(superClass).superClassName;
     }
-    if (superClass.empty())
+    if (superClass != node->objectClassName)
       typeError(return_type_mismatch);
   }
   if (node->identifier->name == currentClassName && node->basetype != bt_none)
@@ -141,23 +201,12 @@ void TypeCheck::visitMethodNode(MethodNode* node) {
       node->basetype != bt_none)
     typeError(main_method_incorrect_signature);
 
-  auto parameters = new std::list<CompoundType>();
-  if (node->parameter_list) {
-    for (auto param : (*node->parameter_list)) {
-      CompoundType type{param->type->basetype, param->type->objectClassName};
-      parameters->push_back(type);
-    }
-  }
   int localsSize = -currentLocalOffset - 4;
-  CompoundType returnType{node->basetype, node->objectClassName};
-  MethodInfo methodInfo{returnType, currentVariableTable, parameters,
-                        localsSize};
-
-  (*currentMethodTable)[node->identifier->name] = methodInfo;
+  (*currentMethodTable)[node->identifier->name].localsSize = localsSize;
 }
 
 void TypeCheck::visitMethodBodyNode(MethodBodyNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   node->basetype =
       node->returnstatement ? node->returnstatement->basetype : bt_none;
   node->objectClassName =
@@ -165,7 +214,7 @@ void TypeCheck::visitMethodBodyNode(MethodBodyNode* node) {
 }
 
 void TypeCheck::visitParameterNode(ParameterNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   node->basetype = node->type->basetype;
   node->objectClassName = node->type->objectClassName;
 
@@ -177,7 +226,7 @@ void TypeCheck::visitParameterNode(ParameterNode* node) {
 }
 
 void TypeCheck::visitDeclarationNode(DeclarationNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   node->basetype = node->type->basetype;
   node->objectClassName = node->type->objectClassName;
 
@@ -200,13 +249,13 @@ void TypeCheck::visitDeclarationNode(DeclarationNode* node) {
 }
 
 void TypeCheck::visitReturnStatementNode(ReturnStatementNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   node->basetype = node->expression->basetype;
   node->objectClassName = node->expression->objectClassName;
 }
 
 void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   std::string varName = node->identifier_1->name;
   CompoundType type;
 
@@ -244,33 +293,33 @@ void TypeCheck::visitAssignmentNode(AssignmentNode* node) {
 }
 
 void TypeCheck::visitCallNode(CallNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   node->basetype = node->methodcall->basetype;
   node->objectClassName = node->methodcall->objectClassName;
 }
 
 void TypeCheck::visitIfElseNode(IfElseNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression->basetype != bt_boolean)
     typeError(if_predicate_type_mismatch);
 }
 
 void TypeCheck::visitWhileNode(WhileNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression->basetype != bt_boolean)
     typeError(while_predicate_type_mismatch);
 }
 
 void TypeCheck::visitDoWhileNode(DoWhileNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression->basetype != bt_boolean)
     typeError(do_while_predicate_type_mismatch);
 }
 
-void TypeCheck::visitPrintNode(PrintNode* node) { node->visit_children(this); }
+void TypeCheck::visitPrintNode(PrintNode* node) { visit_children(node); }
 
 void TypeCheck::visitPlusNode(PlusNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression_1->basetype != bt_integer ||
       node->expression_2->basetype != bt_integer)
     typeError(expression_type_mismatch);
@@ -278,7 +327,7 @@ void TypeCheck::visitPlusNode(PlusNode* node) {
 }
 
 void TypeCheck::visitMinusNode(MinusNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression_1->basetype != bt_integer ||
       node->expression_2->basetype != bt_integer)
     typeError(expression_type_mismatch);
@@ -286,7 +335,7 @@ void TypeCheck::visitMinusNode(MinusNode* node) {
 }
 
 void TypeCheck::visitTimesNode(TimesNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression_1->basetype != bt_integer ||
       node->expression_2->basetype != bt_integer)
     typeError(expression_type_mismatch);
@@ -294,7 +343,7 @@ void TypeCheck::visitTimesNode(TimesNode* node) {
 }
 
 void TypeCheck::visitDivideNode(DivideNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression_1->basetype != bt_integer ||
       node->expression_2->basetype != bt_integer)
     typeError(expression_type_mismatch);
@@ -302,7 +351,7 @@ void TypeCheck::visitDivideNode(DivideNode* node) {
 }
 
 void TypeCheck::visitGreaterNode(GreaterNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression_1->basetype != bt_integer ||
       node->expression_2->basetype != bt_integer)
     typeError(expression_type_mismatch);
@@ -310,7 +359,7 @@ void TypeCheck::visitGreaterNode(GreaterNode* node) {
 }
 
 void TypeCheck::visitGreaterEqualNode(GreaterEqualNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression_1->basetype != bt_integer ||
       node->expression_2->basetype != bt_integer)
     typeError(expression_type_mismatch);
@@ -318,7 +367,7 @@ void TypeCheck::visitGreaterEqualNode(GreaterEqualNode* node) {
 }
 
 void TypeCheck::visitEqualNode(EqualNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression_1->basetype != node->expression_2->basetype ||
       (node->expression_1->basetype != bt_integer &&
        node->expression_1->basetype != bt_boolean))
@@ -327,7 +376,7 @@ void TypeCheck::visitEqualNode(EqualNode* node) {
 }
 
 void TypeCheck::visitAndNode(AndNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression_1->basetype != bt_boolean ||
       node->expression_2->basetype != bt_boolean)
     typeError(expression_type_mismatch);
@@ -335,7 +384,7 @@ void TypeCheck::visitAndNode(AndNode* node) {
 }
 
 void TypeCheck::visitOrNode(OrNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression_1->basetype != bt_boolean ||
       node->expression_2->basetype != bt_boolean)
     typeError(expression_type_mismatch);
@@ -343,20 +392,20 @@ void TypeCheck::visitOrNode(OrNode* node) {
 }
 
 void TypeCheck::visitNotNode(NotNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression->basetype != bt_boolean)
     typeError(expression_type_mismatch);
   node->basetype = bt_boolean;
 }
 
 void TypeCheck::visitNegationNode(NegationNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   if (node->expression->basetype != bt_integer)
     typeError(expression_type_mismatch);
   node->basetype = bt_integer;
 }
 
-void checkArguments(std::list<ExpressionNode*>* actual,
+void checkArguments(std::vector<ExpressionNode*>* actual,
                     std::list<CompoundType>* expected) {
   if (expected->size() != actual->size()) typeError(argument_number_mismatch);
   auto expected_iter = expected->begin();
@@ -369,7 +418,7 @@ void checkArguments(std::list<ExpressionNode*>* actual,
 }
 
 void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
-  node->visit_children(this);
+  visit_children(node);
 
   // (Default) Pattern: foo()
   std::string className = currentClassName;
@@ -378,7 +427,7 @@ void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
   // Pattern: foo.bar()
   if (node->identifier_2) {
     VariableNode varNode(node->identifier_1);
-    varNode.accept(this);
+    dispatch(&varNode);
     if (varNode.basetype != bt_object) typeError(not_object);
     className = varNode.objectClassName;
     methodName = node->identifier_2->name;
@@ -392,18 +441,18 @@ void TypeCheck::visitMethodCallNode(MethodCallNode* node) {
 
   MethodInfo methodInfo = classTable->at(className).methods->at(methodName);
 
-  checkArguments(node->expression_list, methodInfo.parameters);
+  checkArguments(node->expression_list, methodInfo.parameters.get());
 
   node->basetype = methodInfo.returnType.baseType;
   node->objectClassName = methodInfo.returnType.objectClassName;
 }
 
 void TypeCheck::visitMemberAccessNode(MemberAccessNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   std::string memberName = node->identifier_2->name;
 
   VariableNode varNode(node->identifier_1);
-  varNode.accept(this);
+  dispatch(&varNode);
 
   if (varNode.basetype != bt_object) typeError(not_object);
   std::string className = varNode.objectClassName;
@@ -421,7 +470,7 @@ void TypeCheck::visitMemberAccessNode(MemberAccessNode* node) {
 }
 
 void TypeCheck::visitVariableNode(VariableNode* node) {
-  node->visit_children(this);
+  visit_children(node);
   std::string varName = node->identifier->name;
   CompoundType type;
 
@@ -453,13 +502,13 @@ void TypeCheck::visitBooleanLiteralNode(BooleanLiteralNode* node) {
 void TypeCheck::visitNewNode(NewNode* node) {
   std::string className = node->identifier->name;
 
-  node->visit_children(this);
+  visit_children(node);
 
   if (!classTable->count(className)) typeError(undefined_class);
-  MethodTable* methodTable = (*classTable)[className].methods;
+  MethodTable* methodTable = (*classTable)[className].methods.get();
   if (methodTable->count(className)) {
     MethodInfo methodInfo = (*methodTable)[className];
-    checkArguments(node->expression_list, methodInfo.parameters);
+    checkArguments(node->expression_list, methodInfo.parameters.get());
   }
 
   node->basetype = bt_object;
@@ -2,10 +2,14 @@
 #define __TYPECHECK_HPP
 
 #include "ast.hpp"
+#include "error.hpp"
+#include "options.hpp"
 
 #include <cstdlib>
 #include <iostream>
+#include <list>
 #include <map>
+#include <memory>
 
 // Defines a compound type, which is a basetype as well as a
 // string representing the class name of an object type.
@@ -17,7 +21,8 @@ typedef struct compoundtype {
 // Defines the information for a variable. This will be the
 // data in the variable table (each variable will map to one
 // of these). Includes the type, the offset, and the size
-// (always 4 bytes or 1 word in our language).
+// (4 bytes or 1 word, except for boolean members which are
+// 1 byte under the compact layout).
 typedef struct variableinfo {
   CompoundType type;
   int offset;
@@ -32,14 +37,16 @@ typedef std::map<std::string, VariableInfo> VariableTable;
 // data in the method table (each method will map to one
 // of these). Includes return type, the variable table for
 // the method (which will have the paramters and locals),
-// a list of the types of the parameters, and the size of
+// a list of the types of the parameters, the size of
 // the local variables (used when allocating space in the
-// stack frame).
+// stack frame), and whether the method is pure (set by the
+// PurityCheck visitor, see purity.hpp).
 typedef struct methodinfo {
   CompoundType returnType;
-  VariableTable *variables;
-  std::list<CompoundType> *parameters;
+  std::shared_ptr<VariableTable> variables;
+  std::shared_ptr<std::list<CompoundType> > parameters;
   int localsSize;
+  bool pure;
 } MethodInfo;
 
 // Defines a method table. Maps from a string (method name)
@@ -54,13 +61,15 @@ typedef std::map<std::string, MethodInfo> MethodTable;
 // (which is used when allocating on the heap).
 typedef struct classinfo {
   std::string superClassName;
-  MethodTable *methods;
-  VariableTable *members;
+  std::shared_ptr<MethodTable> methods;
+  std::shared_ptr<VariableTable> members;
   int membersSize;
 } ClassInfo;
 
 // Defines a class table. Maps from a string (class name)
-// to a class info.
+// to a class info. The method and variable tables belong to
+// the class table; a copy of it (as a compilation's table is
+// of its imports) shares them.
 typedef std::map<std::string, ClassInfo> ClassTable;
 
 // This function will print the symbol table. The functions are
@@ -91,8 +100,8 @@ typedef enum {
   main_method_incorrect_signature
 } TypeErrorCode;
 
-// Declares a a function which will display type errors, then
-// terminate the program with an error status code. The
+// Declares a a function which will throw type errors as a
+// CompileError (see error.hpp) holding their message. The
 // possible type errors are defined as an enumeration above.
 void typeError(TypeErrorCode code);
 
@@ -100,7 +109,7 @@ void typeError(TypeErrorCode code);
 // and construct the symbol table. You will do all your
 // implementation of the symbol table construction in the
 // visitor functions for this visitor.
-class TypeCheck : public Visitor {
+class TypeCheck final : public Visitor, public StaticVisitor<TypeCheck> {
 public:
   // This member represents the main class table. You can
   // think of this as the "root" of the symbol table.
@@ -108,6 +117,8 @@ public:
   // NOTE: You will need to construct a new ClassTable
   // and set this pointer at the beginning of the TypeCheck
   // visitor pass over the AST.
+  //
+  // The table belongs to the visitor (see beginProgram).
   ClassTable* classTable;
   
   // These members allow you to keep track of the current
@@ -146,6 +157,32 @@ public:
   // This member allows you to keep track of the name of the
   // current class. This is necessary for type checking.
   std::string currentClassName;
+
+  // The options the compiler was invoked with. The main file
+  // sets this before visiting the AST.
+  CompilerOptions options;
+
+  // The classes of other source files, read from their interface
+  // files (see interface.hpp). The class table starts out as a
+  // copy of these.
+  ClassTable imports;
+
+  // Reassigns the member offsets of the current class for the
+  // compact layout: word-sized members first, then one byte
+  // per boolean member, with the total rounded up to a word.
+  void packMembers();
+
+  // Begin and end the check of a program. visitProgramNode visits
+  // its classes in between, and a compilation which hands over the
+  // classes one at a time as they are parsed (see compiler.cpp)
+  // visits each of them itself.
+  void beginProgram();
+  void endProgram();
+
+private:
+  std::unique_ptr<ClassTable> ownedClassTable;
+
+public:
   
   // All the visitor functions. You will need to write
   // appropriate implementation in the typecheck.cpp file.
@@ -0,0 +1,834 @@
+#include "x86asm.hpp"
+#include "error.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+
+// ELF constants (see the System V ABI, and its i386 supplement).
+#define ET_REL 1
+#define EM_386 3
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_NOBITS 8
+#define SHT_REL 9
+#define SHF_WRITE 1
+#define SHF_ALLOC 2
+#define SHF_EXECINSTR 4
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_FUNC 2
+#define R_386_32 1
+#define R_386_PC32 2
+
+static void error(int lineno, std::string message) {
+  throw CompileError("Assembler error at line " + std::to_string(lineno) +
+                     ": " + message);
+}
+
+static std::string trim(const std::string& s) {
+  size_t start = s.find_first_not_of(" \t");
+  if (start == std::string::npos) return "";
+  size_t end = s.find_last_not_of(" \t");
+  return s.substr(start, end - start + 1);
+}
+
+static bool isSymbolChar(char c) {
+  return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$';
+}
+
+static Register parseRegister(std::string name, int& size, int lineno) {
+  static const char* words[] = {"eax", "ecx", "edx", "ebx",
+                                "esp", "ebp", "esi", "edi"};
+  static const char* bytes[] = {"al", "cl", "dl", "bl"};
+  for (int i = 0; i < 8; i++)
+    if (name == words[i]) {
+      size = 4;
+      return (Register)i;
+    }
+  for (int i = 0; i < 4; i++)
+    if (name == bytes[i]) {
+      size = 1;
+      return (Register)i;
+    }
+  error(lineno, "unknown register %" + name);
+  return reg_none;
+}
+
+// Parses a displacement or immediate: numbers and at most one
+// symbol, added or subtracted (e.g. 12, -4, printstr, memo+8).
+static void parseExpression(std::string text, Operand& op, int lineno) {
+  op.value = 0;
+  size_t i = 0;
+  int sign = 1;
+  while (i < text.size()) {
+    if (text[i] == '+' || text[i] == '-') {
+      if (text[i] == '-') sign = -sign;
+      i++;
+      continue;
+    }
+    size_t end = i;
+    while (end < text.size() && isSymbolChar(text[end])) end++;
+    if (end == i) error(lineno, "bad expression " + text);
+    std::string term = text.substr(i, end - i);
+    if (isdigit((unsigned char)term[0])) {
+      op.value += sign * (int)strtoul(term.c_str(), NULL, 0);
+    } else {
+      if (!op.symbol.empty() || sign < 0)
+        error(lineno, "bad expression " + text);
+      op.symbol = term;
+    }
+    sign = 1;
+    i = end;
+  }
+}
+
+static Operand parseOperand(std::string text, int lineno) {
+  Operand op = {op_memory, reg_none, 4, 0, "", false};
+  if (text[0] == '*') {
+    op.indirect = true;
+    text = trim(text.substr(1));
+  }
+
+  if (text[0] == '%') {
+    op.kind = op_register;
+    op.reg = parseRegister(text.substr(1), op.size, lineno);
+  } else if (text[0] == '$') {
+    op.kind = op_immediate;
+    parseExpression(text.substr(1), op, lineno);
+  } else {
+    size_t paren = text.find('(');
+    parseExpression(text.substr(0, paren), op, lineno);
+    if (paren != std::string::npos) {
+      size_t close = text.find(')', paren);
+      std::string base = trim(text.substr(paren + 1, close - paren - 1));
+      if (close == std::string::npos || base[0] != '%' ||
+          base.find(',') != std::string::npos)
+        error(lineno, "unsupported addressing mode " + text);
+      int size;
+      op.reg = parseRegister(base.substr(1), size, lineno);
+    }
+  }
+  return op;
+}
+
+std::vector<AsmLine> parseAssembly(const std::string& text) {
+  std::vector<AsmLine> lines;
+  std::istringstream input(text);
+  std::string raw;
+  int lineno = 0;
+
+  while (std::getline(input, raw)) {
+    lineno++;
+
+    // Strip the comment, if any, outside of string literals.
+    bool quoted = false;
+    for (size_t i = 0; i < raw.size(); i++) {
+      if (raw[i] == '"' && (i == 0 || raw[i - 1] != '\\')) quoted = !quoted;
+      if (raw[i] == '#' && !quoted) {
+        raw.resize(i);
+        break;
+      }
+    }
+
+    AsmLine line;
+    line.lineno = lineno;
+    std::string rest = trim(raw);
+
+    // Labels: symbol characters followed by a colon.
+    for (;;) {
+      size_t end = 0;
+      while (end < rest.size() && isSymbolChar(rest[end])) end++;
+      if (end == 0 || end >= rest.size() || rest[end] != ':') break;
+      line.labels.push_back(rest.substr(0, end));
+      rest = trim(rest.substr(end + 1));
+    }
+
+    if (!rest.empty()) {
+      size_t end = rest.find_first_of(" \t");
+      std::string name = rest.substr(0, end);
+      std::string arguments =
+          end == std::string::npos ? "" : trim(rest.substr(end));
+
+      if (name[0] == '.') {
+        line.directive = name;
+        line.arguments = arguments;
+      } else {
+        line.mnemonic = name;
+        int depth = 0;
+        size_t start = 0;
+        for (size_t i = 0; i <= arguments.size(); i++) {
+          if (i < arguments.size() && arguments[i] == '(') depth++;
+          if (i < arguments.size() && arguments[i] == ')') depth--;
+          if (i == arguments.size() || (arguments[i] == ',' && !depth)) {
+            std::string operand = trim(arguments.substr(start, i - start));
+            if (!operand.empty())
+              line.operands.push_back(parseOperand(operand, lineno));
+            start = i + 1;
+          }
+        }
+      }
+    }
+
+    if (!line.labels.empty() || !line.directive.empty() ||
+        !line.mnemonic.empty())
+      lines.push_back(line);
+  }
+  return lines;
+}
+
+std::string parseString(const std::string& arguments, int lineno) {
+  std::string result;
+  if (arguments.size() < 2 || arguments[0] != '"' ||
+      arguments[arguments.size() - 1] != '"')
+    error(lineno, "expected a string");
+  for (size_t i = 1; i + 1 < arguments.size(); i++) {
+    char c = arguments[i];
+    if (c == '\\') {
+      c = arguments[++i];
+      if (c == 'n') c = '\n';
+      else if (c == 't') c = '\t';
+      else if (c == '0') c = '\0';
+    }
+    result += c;
+  }
+  return result;
+}
+
+// Defines a relocation: a reference at offset (in its section) to
+// a symbol, which the linker resolves.
+typedef struct relocation {
+  int offset;
+  std::string symbol;
+  int type;
+} Relocation;
+
+typedef struct section {
+  std::string name;
+  int type;
+  int flags;
+  std::string data;
+  int size;  // for .bss, which has no data
+  std::vector<Relocation> relocations;
+} Section;
+
+// Defines a symbol. Section is an index into the assembler's
+// sections, or -1 for symbols only referenced (undefined). The
+// type and size are those given by .type and .size.
+typedef struct symbol {
+  int section;
+  int value;
+  bool global;
+  bool function;
+  int size;
+} Symbol;
+
+// Defines a reference from a jump or call to a label, which is
+// resolved once all labels are known: a displacement of size 1
+// or 4 bytes at offset, in an instruction starting at start.
+// Jump is the number of the jump in the program, or -1 for calls
+// (which are never shortened).
+typedef struct fixup {
+  int section;
+  int start;
+  int offset;
+  std::string symbol;
+  int jump;
+  int size;
+} Fixup;
+
+// Condition codes, as encoded in jcc and setcc.
+int conditionCode(std::string condition) {
+  static const std::map<std::string, int> codes = {
+      {"o", 0},   {"no", 1},  {"b", 2},   {"c", 2},   {"nae", 2},
+      {"ae", 3},  {"nb", 3},  {"nc", 3},  {"e", 4},   {"z", 4},
+      {"ne", 5},  {"nz", 5},  {"be", 6},  {"na", 6},  {"a", 7},
+      {"nbe", 7}, {"s", 8},   {"ns", 9},  {"p", 10},  {"np", 11},
+      {"l", 12},  {"nge", 12}, {"ge", 13}, {"nl", 13}, {"le", 14},
+      {"ng", 14}, {"g", 15},  {"nle", 15}};
+  auto code = codes.find(condition);
+  return code == codes.end() ? -1 : code->second;
+}
+
+// The arithmetic instructions sharing the 00-3F opcode pattern,
+// by their /digit (also the opcode divided by 8).
+static int arithmeticCode(std::string mnemonic) {
+  static const std::map<std::string, int> codes = {
+      {"add", 0}, {"or", 1}, {"and", 4}, {"sub", 5}, {"xor", 6}, {"cmp", 7}};
+  auto code = codes.find(mnemonic);
+  return code == codes.end() ? -1 : code->second;
+}
+
+static bool fitsByte(const Operand& op) {
+  return op.symbol.empty() && op.value >= -128 && op.value <= 127;
+}
+
+class Assembler {
+private:
+  std::vector<Section> sections;
+  std::map<std::string, Symbol> symbols;
+  std::map<std::string, std::string> aliases;
+  int current;
+  int lineno;
+  int start;
+
+  std::vector<Fixup> fixups;
+
+  // The jumps (by number) whose target is close enough for the
+  // short form with an 8-bit displacement, found by relax().
+  std::vector<bool> shortJumps;
+  int jumps;
+
+  bool nextJumpIsShort() {
+    return jumps < (int)shortJumps.size() && shortJumps[jumps];
+  }
+
+  std::string& code() { return sections[current].data; }
+
+  void emit(int byte) { code() += (char)byte; }
+
+  void emit32(int value) {
+    for (int i = 0; i < 4; i++) emit((value >> (8 * i)) & 0xff);
+  }
+
+  void reference(const std::string& symbol, int type) {
+    if (!symbols.count(symbol)) symbols[symbol] = {-1, 0, false};
+    sections[current].relocations.push_back(
+        {(int)code().size(), symbol, type});
+  }
+
+  // Emits a 32-bit value, plus the address of its symbol if any.
+  void emitValue(const Operand& op) {
+    if (!op.symbol.empty()) reference(op.symbol, R_386_32);
+    emit32(op.value);
+  }
+
+  void emitImmediate(const Operand& op, int size) {
+    if (size == 1)
+      emit(op.value & 0xff);
+    else
+      emitValue(op);
+  }
+
+  // Emits the ModRM byte (and SIB and displacement) addressing rm,
+  // with reg (a register or an opcode extension) in the middle.
+  void modrm(int reg, const Operand& rm) {
+    if (rm.kind == op_register) {
+      emit(0xc0 | reg << 3 | rm.reg);
+      return;
+    }
+    if (rm.kind != op_memory) error(lineno, "expected a register or memory");
+    if (rm.reg == reg_none) {
+      emit(reg << 3 | 5);
+      emitValue(rm);
+      return;
+    }
+
+    int mod = 2;
+    if (rm.symbol.empty() && rm.value == 0 && rm.reg != reg_ebp)
+      mod = 0;
+    else if (fitsByte(rm))
+      mod = 1;
+    emit(mod << 6 | reg << 3 | rm.reg);
+    if (rm.reg == reg_esp) emit(0x24);
+    if (mod == 1) emit(rm.value & 0xff);
+    if (mod == 2) emitValue(rm);
+  }
+
+  // Emits the displacement to a label, relative to the end of the
+  // instruction: 8 bits for short jumps, otherwise 32 bits.
+  void relative(const Operand& target, bool jump, bool isShort) {
+    if (target.kind != op_memory || target.reg != reg_none || target.value)
+      error(lineno, "expected a label");
+    fixups.push_back({current, start, (int)code().size(), target.symbol,
+                      jump ? jumps++ : -1, isShort ? 1 : 4});
+    if (isShort)
+      emit(0);
+    else
+      emit32(-4);
+  }
+
+  void expect(const std::vector<Operand>& operands, size_t count) {
+    if (operands.size() != count) error(lineno, "wrong number of operands");
+  }
+
+  void instruction(const AsmLine& line);
+  void directive(const AsmLine& line);
+  void layout(const std::vector<AsmLine>& lines);
+  bool relax();
+  void resolve();
+
+public:
+
+  void assemble(const std::vector<AsmLine>& lines);
+  std::string object();
+};
+
+// Encodes the program with the current choice of short jumps,
+// until no more jumps can be shortened. Shortening a jump only
+// brings other labels closer, so every pass keeps the jumps made
+// short by the ones before it.
+void Assembler::assemble(const std::vector<AsmLine>& lines) {
+  do {
+    layout(lines);
+  } while (relax());
+  resolve();
+}
+
+// Encodes every line, placing the labels.
+void Assembler::layout(const std::vector<AsmLine>& lines) {
+  sections.clear();
+  sections.push_back({".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR});
+  sections.push_back({".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE});
+  sections.push_back({".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE});
+  symbols.clear();
+  aliases.clear();
+  fixups.clear();
+  current = 0;
+  jumps = 0;
+
+  for (auto& line : lines) {
+    lineno = line.lineno;
+    for (auto& label : line.labels) {
+      if (symbols.count(label) && symbols[label].section >= 0)
+        error(lineno, "symbol " + label + " is already defined");
+      Symbol& symbol = symbols[label];
+      symbol.section = current;
+      symbol.value = sections[current].data.size();
+    }
+    if (!line.directive.empty()) directive(line);
+    if (!line.mnemonic.empty()) {
+      start = code().size();
+      instruction(line);
+    }
+  }
+
+  // Aliases take the place of their targets.
+  for (size_t pass = 0; pass <= aliases.size(); pass++)
+    for (auto& alias : aliases) {
+      if (!symbols.count(alias.second) || symbols[alias.second].section < 0)
+        continue;
+      bool global = symbols[alias.first].global;
+      symbols[alias.first] = symbols[alias.second];
+      symbols[alias.first].global = global;
+    }
+  for (auto& alias : aliases)
+    if (symbols[alias.first].section < 0)
+      error(0, "cannot resolve .set " + alias.first + ", " + alias.second);
+}
+
+// Marks the long jumps whose displacement would fit in 8 bits in
+// their short (2 byte) form, returning whether there were any.
+bool Assembler::relax() {
+  shortJumps.resize(jumps);
+  bool changed = false;
+  for (auto& fixup : fixups) {
+    if (fixup.jump < 0 || fixup.size == 1 || !symbols.count(fixup.symbol))
+      continue;
+    Symbol& symbol = symbols[fixup.symbol];
+    int displacement = symbol.value - (fixup.start + 2);
+    // A label after the jump moves back with the end of the jump.
+    if (symbol.value > fixup.start)
+      displacement = symbol.value - (fixup.offset + 4);
+    if (symbol.section == fixup.section && displacement >= -128 &&
+        displacement <= 127) {
+      shortJumps[fixup.jump] = true;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+void Assembler::directive(const AsmLine& line) {
+  const std::string& name = line.directive;
+  if (name == ".text") {
+    current = 0;
+  } else if (name == ".data") {
+    current = 1;
+  } else if (name == ".bss") {
+    current = 2;
+  } else if (name == ".globl" || name == ".global") {
+    if (!symbols.count(line.arguments)) symbols[line.arguments] = {-1, 0, false};
+    symbols[line.arguments].global = true;
+  } else if (name == ".type" || name == ".size") {
+    size_t comma = line.arguments.find(',');
+    if (comma == std::string::npos)
+      error(lineno, "expected " + name + " name, value");
+    std::string label = trim(line.arguments.substr(0, comma));
+    std::string value = trim(line.arguments.substr(comma + 1));
+    if (!symbols.count(label)) symbols[label] = {-1, 0, false};
+    Symbol& symbol = symbols[label];
+    if (name == ".type")
+      symbol.function = value == "@function";
+    else if (value == ".-" + label && symbol.section == current)
+      symbol.size = code().size() - symbol.value;
+    else
+      symbol.size = atoi(value.c_str());
+  } else if (name == ".file" || name == ".loc") {
+    // Debugging information is not written.
+  } else if (name == ".long") {
+    std::istringstream values(line.arguments);
+    std::string value;
+    while (std::getline(values, value, ',')) {
+      Operand op = {op_immediate, reg_none, 4, 0, "", false};
+      parseExpression(trim(value), op, lineno);
+      emitValue(op);
+    }
+  } else if (name == ".ascii" || name == ".asciz") {
+    code() += parseString(line.arguments, lineno);
+    if (name == ".asciz") code() += '\0';
+  } else if (name == ".lcomm") {
+    // Word aligned, since the tables it declares hold words.
+    size_t comma = line.arguments.find(',');
+    if (comma == std::string::npos) error(lineno, "expected .lcomm name, size");
+    Section& bss = sections[2];
+    bss.size = (bss.size + 3) & ~3;
+    std::string label = trim(line.arguments.substr(0, comma));
+    symbols[label] = {2, bss.size, false};
+    bss.size += atoi(line.arguments.c_str() + comma + 1);
+  } else if (name == ".set") {
+    size_t comma = line.arguments.find(',');
+    if (comma == std::string::npos) error(lineno, "expected .set name, value");
+    aliases[trim(line.arguments.substr(0, comma))] =
+        trim(line.arguments.substr(comma + 1));
+  } else {
+    error(lineno, "unknown directive " + name);
+  }
+}
+
+void Assembler::instruction(const AsmLine& line) {
+  std::string mnemonic = line.mnemonic;
+  const std::vector<Operand>& ops = line.operands;
+
+  if (mnemonic == "cdq") {
+    expect(ops, 0);
+    emit(0x99);
+    return;
+  }
+  if (mnemonic == "ret") {
+    // ret $n also pops n bytes of arguments.
+    if (ops.size() == 1 && ops[0].kind == op_immediate) {
+      emit(0xc2);
+      emit(ops[0].value & 0xff);
+      emit(ops[0].value >> 8 & 0xff);
+      return;
+    }
+    expect(ops, 0);
+    emit(0xc3);
+    return;
+  }
+  if (mnemonic == "leave") {
+    expect(ops, 0);
+    emit(0xc9);
+    return;
+  }
+  if (mnemonic == "jmp" || mnemonic == "call") {
+    expect(ops, 1);
+    if (ops[0].indirect) {
+      emit(0xff);
+      modrm(mnemonic == "jmp" ? 4 : 2, ops[0]);
+    } else {
+      bool isShort = mnemonic == "jmp" && nextJumpIsShort();
+      emit(mnemonic == "call" ? 0xe8 : isShort ? 0xeb : 0xe9);
+      relative(ops[0], mnemonic == "jmp", isShort);
+    }
+    return;
+  }
+  if (mnemonic[0] == 'j' && conditionCode(mnemonic.substr(1)) >= 0) {
+    expect(ops, 1);
+    bool isShort = nextJumpIsShort();
+    if (isShort) {
+      emit(0x70 | conditionCode(mnemonic.substr(1)));
+    } else {
+      emit(0x0f);
+      emit(0x80 | conditionCode(mnemonic.substr(1)));
+    }
+    relative(ops[0], true, isShort);
+    return;
+  }
+  if (mnemonic.compare(0, 3, "set") == 0 &&
+      conditionCode(mnemonic.substr(3)) >= 0) {
+    expect(ops, 1);
+    emit(0x0f);
+    emit(0x90 | conditionCode(mnemonic.substr(3)));
+    modrm(0, ops[0]);
+    return;
+  }
+  if (mnemonic == "movzbl" || mnemonic == "movzx") {
+    expect(ops, 2);
+    emit(0x0f);
+    emit(0xb6);
+    modrm(ops[1].reg, ops[0]);
+    return;
+  }
+
+  // Everything else takes an optional size suffix (movl, movb).
+  int size = 0;
+  static const char* sized[] = {"push", "pop", "mov", "add", "or",
+                                "and", "sub", "xor", "cmp", "imul",
+                                "idiv", "neg", "not"};
+  bool known = false;
+  for (auto name : sized) {
+    if (mnemonic == name) known = true;
+    if (mnemonic.size() == strlen(name) + 1 &&
+        mnemonic.compare(0, strlen(name), name) == 0 &&
+        (mnemonic.back() == 'l' || mnemonic.back() == 'b')) {
+      size = mnemonic.back() == 'l' ? 4 : 1;
+      mnemonic = name;
+      known = true;
+    }
+  }
+  if (!known) error(lineno, "unknown instruction " + line.mnemonic);
+  for (auto& op : ops)
+    if (op.kind == op_register && !op.indirect) {
+      if (size && size != op.size) error(lineno, "operand size mismatch");
+      size = op.size;
+    }
+  if (!size) size = 4;
+  int wide = size == 4 ? 1 : 0;
+
+  if (mnemonic == "push") {
+    expect(ops, 1);
+    if (ops[0].kind == op_register) {
+      emit(0x50 + ops[0].reg);
+    } else if (ops[0].kind == op_immediate) {
+      emit(fitsByte(ops[0]) ? 0x6a : 0x68);
+      emitImmediate(ops[0], fitsByte(ops[0]) ? 1 : 4);
+    } else {
+      emit(0xff);
+      modrm(6, ops[0]);
+    }
+  } else if (mnemonic == "pop") {
+    expect(ops, 1);
+    if (ops[0].kind == op_register) {
+      emit(0x58 + ops[0].reg);
+    } else {
+      emit(0x8f);
+      modrm(0, ops[0]);
+    }
+  } else if (mnemonic == "mov") {
+    expect(ops, 2);
+    if (ops[0].kind == op_immediate && ops[1].kind == op_register) {
+      emit((wide ? 0xb8 : 0xb0) + ops[1].reg);
+      emitImmediate(ops[0], size);
+    } else if (ops[0].kind == op_immediate) {
+      emit(0xc6 | wide);
+      modrm(0, ops[1]);
+      emitImmediate(ops[0], size);
+    } else if (ops[0].kind == op_register) {
+      emit(0x88 | wide);
+      modrm(ops[0].reg, ops[1]);
+    } else if (ops[1].kind == op_register) {
+      emit(0x8a | wide);
+      modrm(ops[1].reg, ops[0]);
+    } else {
+      error(lineno, "mov between two memory operands");
+    }
+  } else if (arithmeticCode(mnemonic) >= 0) {
+    expect(ops, 2);
+    int code = arithmeticCode(mnemonic);
+    if (ops[0].kind == op_immediate && ops[1].kind == op_register &&
+        ops[1].reg == reg_eax && !(wide && fitsByte(ops[0]))) {
+      // The accumulator has its own form, without a ModRM byte.
+      emit(code << 3 | 4 | wide);
+      emitImmediate(ops[0], size);
+    } else if (ops[0].kind == op_immediate) {
+      bool shortForm = wide && fitsByte(ops[0]);
+      emit(!wide ? 0x80 : shortForm ? 0x83 : 0x81);
+      modrm(code, ops[1]);
+      emitImmediate(ops[0], shortForm ? 1 : size);
+    } else if (ops[0].kind == op_register) {
+      emit(code << 3 | wide);
+      modrm(ops[0].reg, ops[1]);
+    } else if (ops[1].kind == op_register) {
+      emit(code << 3 | 2 | wide);
+      modrm(ops[1].reg, ops[0]);
+    } else {
+      error(lineno, mnemonic + " between two memory operands");
+    }
+  } else if (mnemonic == "imul") {
+    if (!wide) error(lineno, "byte imul is not supported");
+    const Operand& dest = ops.back();
+    if (ops.size() < 2 || ops.size() > 3 || dest.kind != op_register)
+      error(lineno, "imul needs a register destination");
+    if (ops[0].kind == op_immediate) {
+      const Operand& source = ops.size() == 3 ? ops[1] : dest;
+      emit(fitsByte(ops[0]) ? 0x6b : 0x69);
+      modrm(dest.reg, source);
+      emitImmediate(ops[0], fitsByte(ops[0]) ? 1 : 4);
+    } else {
+      expect(ops, 2);
+      emit(0x0f);
+      emit(0xaf);
+      modrm(dest.reg, ops[0]);
+    }
+  } else {
+    // idiv, neg, not: the F6/F7 group.
+    expect(ops, 1);
+    emit(0xf6 | wide);
+    modrm(mnemonic == "idiv" ? 7 : mnemonic == "neg" ? 3 : 2, ops[0]);
+  }
+}
+
+// Resolves jumps and calls. References to labels in the same
+// section are patched in place; the others (to functions in other
+// objects) become PC-relative relocations.
+void Assembler::resolve() {
+  for (auto& fixup : fixups) {
+    Section& section = sections[fixup.section];
+    if (!symbols.count(fixup.symbol)) symbols[fixup.symbol] = {-1, 0, false};
+    Symbol& symbol = symbols[fixup.symbol];
+    if (symbol.section == fixup.section) {
+      int displacement = symbol.value - (fixup.offset + fixup.size);
+      for (int i = 0; i < fixup.size; i++)
+        section.data[fixup.offset + i] = (char)(displacement >> (8 * i));
+    } else {
+      section.relocations.push_back({fixup.offset, fixup.symbol, R_386_PC32});
+    }
+  }
+}
+
+static void put(std::string& out, unsigned value, int bytes) {
+  for (int i = 0; i < bytes; i++) out += (char)(value >> (8 * i));
+}
+
+static int addString(std::string& table, const std::string& s) {
+  int offset = table.size();
+  table += s;
+  table += '\0';
+  return offset;
+}
+
+// Writes the ELF object: the three sections, a relocation section
+// for each of them that needs one, then the symbol and string
+// tables. Local symbols come before global ones, as ELF requires.
+// Labels starting with .L are left out, as as does, unless a
+// relocation refers to them.
+std::string Assembler::object() {
+  std::set<std::string> relocated;
+  for (auto& section : sections)
+    for (auto& relocation : section.relocations)
+      relocated.insert(relocation.symbol);
+
+  std::string strtab(1, '\0');
+  std::string symtab(16, '\0');
+  std::map<std::string, int> symbolIndex;
+  int firstGlobal = 1;
+  for (int global = 0; global < 2; global++) {
+    if (global) firstGlobal = symbolIndex.size() + 1;
+    for (auto& entry : symbols) {
+      const Symbol& symbol = entry.second;
+      bool isGlobal = symbol.global || symbol.section < 0;
+      if (isGlobal != (bool)global) continue;
+      if (!isGlobal && !entry.first.compare(0, 2, ".L") &&
+          !relocated.count(entry.first))
+        continue;
+      int index = symbolIndex.size() + 1;
+      symbolIndex[entry.first] = index;
+      put(symtab, addString(strtab, entry.first), 4);
+      put(symtab, symbol.value, 4);
+      put(symtab, symbol.size, 4);
+      put(symtab, (isGlobal ? STB_GLOBAL : STB_LOCAL) << 4 |
+                      (symbol.function ? STT_FUNC : STT_NOTYPE),
+          1);
+      put(symtab, 0, 1);
+      // Section header indices start at 1 (0 is the null section).
+      put(symtab, symbol.section < 0 ? 0 : symbol.section + 1, 2);
+    }
+  }
+
+  typedef struct header {
+    std::string name;
+    int type, flags;
+    std::string data;
+    int size, link, info, align, entsize;
+  } Header;
+  std::vector<Header> headers;
+  headers.push_back({"", 0, 0, "", 0, 0, 0, 0, 0});
+  for (auto& section : sections)
+    headers.push_back({section.name, section.type, section.flags, section.data,
+                       section.type == SHT_NOBITS ? section.size
+                                                  : (int)section.data.size(),
+                       0, 0, 4, 0});
+
+  int symtabIndex = sections.size() + 1;
+  for (size_t i = 0; i < sections.size(); i++) {
+    if (sections[i].relocations.empty()) continue;
+    std::string rel;
+    for (auto& relocation : sections[i].relocations) {
+      put(rel, relocation.offset, 4);
+      put(rel, symbolIndex.at(relocation.symbol) << 8 | relocation.type, 4);
+    }
+    headers.push_back({".rel" + sections[i].name, SHT_REL, 0, rel,
+                       (int)rel.size(), 0, (int)i + 1, 4, 8});
+    symtabIndex++;
+  }
+  for (auto& header : headers)
+    if (header.type == SHT_REL) header.link = symtabIndex;
+
+  headers.push_back({".symtab", SHT_SYMTAB, 0, symtab, (int)symtab.size(),
+                     symtabIndex + 1, firstGlobal, 4, 16});
+  headers.push_back({".strtab", SHT_STRTAB, 0, strtab, (int)strtab.size(), 0,
+                     0, 1, 0});
+  std::string shstrtab(1, '\0');
+  std::vector<int> names;
+  for (auto& header : headers)
+    names.push_back(header.name.empty() ? 0 : addString(shstrtab, header.name));
+  names.push_back(addString(shstrtab, ".shstrtab"));
+  headers.push_back({".shstrtab", SHT_STRTAB, 0, shstrtab,
+                     (int)shstrtab.size(), 0, 0, 1, 0});
+
+  // The section contents follow the ELF header, each aligned.
+  std::string body;
+  std::vector<int> offsets;
+  for (auto& header : headers) {
+    while ((52 + body.size()) % 4) body += '\0';
+    offsets.push_back(52 + body.size());
+    if (header.type != SHT_NOBITS) body += header.data;
+  }
+  while ((52 + body.size()) % 4) body += '\0';
+
+  std::string elf("\x7f" "ELF\x01\x01\x01", 7);
+  elf.resize(16, '\0');
+  put(elf, ET_REL, 2);
+  put(elf, EM_386, 2);
+  put(elf, 1, 4);                      // version
+  put(elf, 0, 4);                      // entry
+  put(elf, 0, 4);                      // program headers
+  put(elf, 52 + body.size(), 4);       // section headers
+  put(elf, 0, 4);                      // flags
+  put(elf, 52, 2);                     // ELF header size
+  put(elf, 0, 2);
+  put(elf, 0, 2);
+  put(elf, 40, 2);                     // section header size
+  put(elf, headers.size(), 2);
+  put(elf, headers.size() - 1, 2);     // .shstrtab
+  elf += body;
+
+  for (size_t i = 0; i < headers.size(); i++) {
+    const Header& header = headers[i];
+    put(elf, names[i], 4);
+    put(elf, header.type, 4);
+    put(elf, header.flags, 4);
+    put(elf, 0, 4);
+    put(elf, i ? offsets[i] : 0, 4);
+    put(elf, header.size, 4);
+    put(elf, header.link, 4);
+    put(elf, header.info, 4);
+    put(elf, header.align, 4);
+    put(elf, header.entsize, 4);
+  }
+  return elf;
+}
+
+std::string assemble(const std::string& text) {
+  Assembler assembler;
+  assembler.assemble(parseAssembly(text));
+  return assembler.object();
+}
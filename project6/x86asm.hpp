@@ -0,0 +1,64 @@
+#ifndef __X86ASM_HPP
+#define __X86ASM_HPP
+
+#include <string>
+#include <vector>
+
+// Defines the 32-bit x86 registers, numbered as in their encoding.
+// The byte registers %al..%bl share the numbers of %eax..%ebx.
+typedef enum {
+  reg_eax, reg_ecx, reg_edx, reg_ebx, reg_esp, reg_ebp, reg_esi, reg_edi,
+  reg_none = -1
+} Register;
+
+// Defines the kinds of instruction operands.
+typedef enum {
+  op_register,   // %eax
+  op_immediate,  // $5, $printstr
+  op_memory      // 8(%ebp), (%ecx), printstr
+} OperandKind;
+
+// Defines an operand of an instruction. Immediates and memory
+// displacements are value plus the address of symbol, if any.
+// Register operands are 4 bytes unless they name a byte register.
+typedef struct operand {
+  OperandKind kind;
+  Register reg;
+  int size;
+  int value;
+  std::string symbol;
+  bool indirect;  // the target of jmp *%ecx or call *%ecx
+} Operand;
+
+// Defines one line of assembly: the labels defined on it, then
+// either a directive (".data") with its raw arguments, or an
+// instruction mnemonic with its operands in AT&T order (source
+// first). Comments and blank lines parse to nothing.
+typedef struct asmline {
+  std::vector<std::string> labels;
+  std::string directive;
+  std::string arguments;
+  std::string mnemonic;
+  std::vector<Operand> operands;
+  int lineno;
+} AsmLine;
+
+// Parses the AT&T syntax emitted by the CodeGenerator. Unknown
+// syntax throws a CompileError (see error.hpp) with its line number.
+std::vector<AsmLine> parseAssembly(const std::string& text);
+
+// Returns the number of a condition (e, ne, g, le...) as encoded in
+// jcc and setcc, or -1 if it is not one.
+int conditionCode(std::string condition);
+
+// Decodes the string argument of an .ascii or .asciz directive.
+std::string parseString(const std::string& arguments, int lineno);
+
+// Assembles the output of the CodeGenerator into an ELF32 i386
+// relocatable object (returned as its bytes). Labels become
+// symbols, global if declared with .globl. Calls to functions
+// which are not defined (printf, malloc, write) are left as
+// relocations for the linker.
+std::string assemble(const std::string& text);
+
+#endif
@@ -0,0 +1,658 @@
+#include "x86sim.hpp"
+#include "x86asm.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+// Code, data and the stack are in separate address ranges. Code
+// addresses are the numbers of the decoded instructions, and the
+// functions the simulator stands in for get addresses of their own,
+// so that calls through registers and tables work. The heap grows
+// from the end of the data.
+#define EXIT_ADDRESS 0x3effff00u
+#define EXTERNAL_BASE 0x3f000000u
+#define CODE_BASE 0x40000000u
+#define DATA_BASE 0x00100000u
+#define DATA_LIMIT 0x30000000u
+#define STACK_TOP 0xc0000000u
+
+typedef enum {
+  in_push, in_pop, in_mov, in_movzbl, in_add, in_sub, in_and, in_or,
+  in_xor, in_cmp, in_imul, in_idiv, in_neg, in_not, in_cdq, in_jmp,
+  in_jcc, in_call, in_ret, in_leave, in_setcc
+} Opcode;
+
+// The functions the simulator stands in for.
+static const char* externalNames[] = {
+    "printf", "malloc", "calloc", "free", "write", "__lang_allocate",
+    "__lang_profile_enter", "__lang_profile_exit"};
+
+typedef enum {
+  ext_printf, ext_malloc, ext_calloc, ext_free, ext_write, ext_allocate,
+  ext_profile_enter, ext_profile_exit, ext_count
+} External;
+
+// Defines a decoded instruction. Symbols in its operands have been
+// added to their values; target is the address of a direct jump or
+// call.
+typedef struct decoded {
+  Opcode opcode;
+  int condition;
+  int size;
+  std::vector<Operand> operands;
+  unsigned target;
+  int method;
+  int lineno;
+} Decoded;
+
+static void error(int lineno, std::string message) {
+  std::cerr << "Simulator error at line " << lineno << ": " << message
+            << std::endl;
+  exit(1);
+}
+
+class Simulator {
+private:
+  std::vector<Decoded> code;
+  std::vector<std::string> methodNames;
+  std::vector<ExecutionCounts> methodCounts;
+  std::map<std::string, unsigned> symbols;
+  std::vector<unsigned char> data;
+  std::vector<unsigned char> stack;
+  std::ostream& out;
+  SimulatorOptions options;
+  Simulation simulation;
+
+  unsigned regs[8];
+  bool zf, sf, of, cf;
+  const Decoded* current;
+  ExecutionCounts* counts;
+
+  void load(const std::vector<AsmLine>& lines);
+  Decoded decode(const AsmLine& line);
+  unsigned address(const std::string& symbol, int lineno);
+  void storeData(size_t offset, unsigned value);
+
+  unsigned char* memory(unsigned address, int size);
+  unsigned loadValue(unsigned address, int size);
+  void storeValue(unsigned address, int size, unsigned value);
+  unsigned read(const Operand& op, int size);
+  void write(const Operand& op, int size, unsigned value);
+  void push(unsigned value);
+  unsigned pop();
+  unsigned allocate(unsigned size);
+  std::string readString(unsigned address);
+
+  void setResultFlags(unsigned result, int size);
+  bool condition(int code);
+  void callExternal(int external);
+
+public:
+  Simulator(const std::string& text, std::ostream& out,
+            const SimulatorOptions& options);
+  Simulation run();
+};
+
+Simulator::Simulator(const std::string& text, std::ostream& out,
+                     const SimulatorOptions& options)
+    : stack(options.stackSize), out(out), options(options) {
+  simulation.total = ExecutionCounts{0, 0, 0, 0, 0, 0};
+  load(parseAssembly(text));
+}
+
+void Simulator::load(const std::vector<AsmLine>& lines) {
+  std::map<std::string, std::string> aliases;
+  std::vector<std::pair<size_t, std::string> > dataFixups;
+  int section = 0;
+  int method = -1;
+
+  for (auto& line : lines) {
+    // Labels in .text name the next instruction, and the others the
+    // next data.
+    for (auto& label : line.labels) {
+      if (symbols.count(label))
+        error(line.lineno, "label defined twice: " + label);
+      symbols[label] = section == 0 ? CODE_BASE + code.size()
+                                    : DATA_BASE + data.size();
+      if (section == 0 && label.compare(0, 2, ".L") != 0) {
+        method = methodNames.size();
+        methodNames.push_back(label);
+      }
+    }
+
+    const std::string& name = line.directive;
+    if (!line.mnemonic.empty()) {
+      if (section != 0) error(line.lineno, "instruction outside of .text");
+      if (method < 0) {
+        method = methodNames.size();
+        methodNames.push_back("<start>");
+      }
+      code.push_back(decode(line));
+      code.back().method = method;
+    } else if (name == ".text") {
+      section = 0;
+    } else if (name == ".data") {
+      section = 1;
+    } else if (name == ".bss") {
+      section = 2;
+    } else if (name == ".long") {
+      // Each value is a number or a symbol.
+      std::istringstream values(line.arguments);
+      std::string value;
+      while (std::getline(values, value, ',')) {
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t") + 1);
+        data.resize(data.size() + 4);
+        if (isdigit((unsigned char)value[0]) || value[0] == '-')
+          storeData(data.size() - 4, strtol(value.c_str(), NULL, 0));
+        else
+          dataFixups.push_back({data.size() - 4, value});
+      }
+    } else if (name == ".ascii" || name == ".asciz") {
+      std::string text = parseString(line.arguments, line.lineno);
+      data.insert(data.end(), text.begin(), text.end());
+      if (name == ".asciz") data.push_back(0);
+    } else if (name == ".lcomm") {
+      size_t comma = line.arguments.find(',');
+      if (comma == std::string::npos)
+        error(line.lineno, "expected .lcomm name, size");
+      data.resize((data.size() + 3) & ~3);
+      std::string label = line.arguments.substr(0, comma);
+      label.erase(label.find_last_not_of(" \t") + 1);
+      symbols[label] = DATA_BASE + data.size();
+      data.resize(data.size() + atoi(line.arguments.c_str() + comma + 1));
+    } else if (name == ".set") {
+      size_t comma = line.arguments.find(',');
+      if (comma == std::string::npos)
+        error(line.lineno, "expected .set name, value");
+      std::string alias = line.arguments.substr(0, comma);
+      std::string target = line.arguments.substr(comma + 1);
+      alias.erase(alias.find_last_not_of(" \t") + 1);
+      target.erase(0, target.find_first_not_of(" \t"));
+      aliases[alias] = target;
+    } else if (name == ".globl" || name == ".global" || name == ".type" ||
+               name == ".size" || name == ".file" || name == ".loc" ||
+               name.empty()) {
+      // Nothing to run.
+    } else {
+      error(line.lineno, "unknown directive " + name);
+    }
+  }
+
+  for (auto& alias : aliases) {
+    if (!symbols.count(alias.second))
+      error(0, "undefined symbol " + alias.second);
+    symbols[alias.first] = symbols[alias.second];
+  }
+  for (int i = 0; i < ext_count; i++)
+    if (!symbols.count(externalNames[i]))
+      symbols[externalNames[i]] = EXTERNAL_BASE + i;
+
+  // Symbols can only be added to values once they all have addresses.
+  for (auto& fixup : dataFixups)
+    storeData(fixup.first, address(fixup.second, 0));
+  for (auto& instruction : code)
+    for (auto& op : instruction.operands)
+      if (!op.symbol.empty()) {
+        op.value += address(op.symbol, instruction.lineno);
+        op.symbol.clear();
+      }
+  for (auto& instruction : code)
+    if (instruction.opcode == in_jmp || instruction.opcode == in_jcc ||
+        instruction.opcode == in_call)
+      if (!instruction.operands[0].indirect)
+        instruction.target = instruction.operands[0].value;
+
+  methodCounts.assign(methodNames.size(), ExecutionCounts{0, 0, 0, 0, 0, 0});
+}
+
+void Simulator::storeData(size_t offset, unsigned value) {
+  for (int i = 0; i < 4; i++) data[offset + i] = value >> (8 * i);
+}
+
+unsigned Simulator::address(const std::string& symbol, int lineno) {
+  auto found = symbols.find(symbol);
+  if (found == symbols.end()) error(lineno, "undefined symbol " + symbol);
+  return found->second;
+}
+
+Decoded Simulator::decode(const AsmLine& line) {
+  Decoded decoded = {in_push, -1, 0, line.operands, 0, 0, line.lineno};
+  std::string mnemonic = line.mnemonic;
+  size_t count = 1;
+
+  static std::map<std::string, Opcode> fixed = {
+      {"cdq", in_cdq},   {"ret", in_ret},   {"leave", in_leave},
+      {"jmp", in_jmp},   {"call", in_call}, {"movzbl", in_movzbl},
+      {"movzx", in_movzbl}};
+  static std::map<std::string, Opcode> sized = {
+      {"push", in_push}, {"pop", in_pop}, {"mov", in_mov},   {"add", in_add},
+      {"sub", in_sub},   {"and", in_and}, {"or", in_or},     {"xor", in_xor},
+      {"cmp", in_cmp},   {"imul", in_imul}, {"idiv", in_idiv},
+      {"neg", in_neg},   {"not", in_not}};
+
+  if (fixed.count(mnemonic)) {
+    decoded.opcode = fixed[mnemonic];
+    count = decoded.opcode == in_cdq || decoded.opcode == in_ret ||
+                    decoded.opcode == in_leave
+                ? 0
+                : decoded.opcode == in_movzbl ? 2 : 1;
+  } else if (mnemonic[0] == 'j' && conditionCode(mnemonic.substr(1)) >= 0) {
+    decoded.opcode = in_jcc;
+    decoded.condition = conditionCode(mnemonic.substr(1));
+  } else if (mnemonic.compare(0, 3, "set") == 0 &&
+             conditionCode(mnemonic.substr(3)) >= 0) {
+    decoded.opcode = in_setcc;
+    decoded.condition = conditionCode(mnemonic.substr(3));
+    decoded.size = 1;
+  } else {
+    // Everything else takes an optional size suffix (movl, movb).
+    char suffix = mnemonic.back();
+    if (!sized.count(mnemonic) && (suffix == 'l' || suffix == 'b') &&
+        sized.count(mnemonic.substr(0, mnemonic.size() - 1))) {
+      decoded.size = suffix == 'l' ? 4 : 1;
+      mnemonic.pop_back();
+    }
+    if (!sized.count(mnemonic))
+      error(line.lineno, "unknown instruction " + line.mnemonic);
+    decoded.opcode = sized[mnemonic];
+    for (auto& op : line.operands)
+      if (op.kind == op_register) decoded.size = op.size;
+    count = decoded.opcode == in_push || decoded.opcode == in_pop ||
+                    decoded.opcode == in_idiv || decoded.opcode == in_neg ||
+                    decoded.opcode == in_not
+                ? 1
+                : 2;
+    if (decoded.opcode == in_imul && line.operands.size() == 3) count = 3;
+  }
+  if (decoded.opcode == in_ret && line.operands.size() == 1 &&
+      line.operands[0].kind == op_immediate)
+    count = 1;
+  if (line.operands.size() != count)
+    error(line.lineno, "wrong number of operands for " + line.mnemonic);
+  if (!decoded.size) decoded.size = 4;
+  return decoded;
+}
+
+unsigned char* Simulator::memory(unsigned address, int size) {
+  if (address >= DATA_BASE && address - DATA_BASE + size <= data.size())
+    return &data[address - DATA_BASE];
+  if (address >= STACK_TOP - stack.size() && address <= STACK_TOP - size)
+    return &stack[address - (STACK_TOP - stack.size())];
+  char hex[16];
+  snprintf(hex, sizeof(hex), "0x%08x", address);
+  error(current->lineno, std::string("access to ") + hex + " in " +
+                             methodNames[current->method] +
+                             (address < STACK_TOP && address >
+                              STACK_TOP - stack.size() - 4096
+                                  ? " (stack overflow)"
+                                  : ""));
+  return NULL;
+}
+
+unsigned Simulator::loadValue(unsigned address, int size) {
+  counts->loads++;
+  unsigned char* bytes = memory(address, size);
+  unsigned value = 0;
+  for (int i = size - 1; i >= 0; i--) value = value << 8 | bytes[i];
+  return value;
+}
+
+void Simulator::storeValue(unsigned address, int size, unsigned value) {
+  counts->stores++;
+  unsigned char* bytes = memory(address, size);
+  for (int i = 0; i < size; i++) bytes[i] = value >> (8 * i);
+}
+
+// Byte registers are the low bytes of %eax..%ebx.
+unsigned Simulator::read(const Operand& op, int size) {
+  switch (op.kind) {
+    case op_register:
+      return size == 4 ? regs[op.reg] : regs[op.reg] & 0xff;
+    case op_immediate:
+      return size == 4 ? op.value : op.value & 0xff;
+    default:
+      return loadValue(op.value + (op.reg == reg_none ? 0 : regs[op.reg]),
+                       size);
+  }
+}
+
+void Simulator::write(const Operand& op, int size, unsigned value) {
+  if (op.kind == op_register) {
+    regs[op.reg] = size == 4 ? value : (regs[op.reg] & ~0xffu) | (value & 0xff);
+  } else if (op.kind == op_memory) {
+    storeValue(op.value + (op.reg == reg_none ? 0 : regs[op.reg]), size,
+               value);
+  } else {
+    error(current->lineno, "write to an immediate");
+  }
+}
+
+void Simulator::push(unsigned value) {
+  regs[reg_esp] -= 4;
+  storeValue(regs[reg_esp], 4, value);
+}
+
+unsigned Simulator::pop() {
+  unsigned value = loadValue(regs[reg_esp], 4);
+  regs[reg_esp] += 4;
+  return value;
+}
+
+// Allocates zeroed memory from the heap, 8-byte aligned.
+unsigned Simulator::allocate(unsigned size) {
+  size_t start = (data.size() + 7) & ~(size_t)7;
+  if (start + size > DATA_LIMIT - DATA_BASE)
+    error(current->lineno, "out of memory in " + methodNames[current->method]);
+  data.resize(start + size);
+  return DATA_BASE + start;
+}
+
+std::string Simulator::readString(unsigned address) {
+  std::string text;
+  for (char c; (c = *memory(address, 1)); address++) text += c;
+  return text;
+}
+
+void Simulator::setResultFlags(unsigned result, int size) {
+  unsigned mask = size == 4 ? 0xffffffffu : 0xffu;
+  zf = (result & mask) == 0;
+  sf = result & (size == 4 ? 0x80000000u : 0x80u);
+}
+
+bool Simulator::condition(int code) {
+  bool result;
+  switch (code >> 1) {
+    case 0: result = of; break;
+    case 1: result = cf; break;
+    case 2: result = zf; break;
+    case 3: result = cf || zf; break;
+    case 4: result = sf; break;
+    case 6: result = sf != of; break;
+    case 7: result = zf || sf != of; break;
+    default:
+      error(current->lineno, "parity is not simulated");
+      return false;
+  }
+  return code & 1 ? !result : result;
+}
+
+// Runs a C library or profiling runtime function. Its arguments are
+// on the stack, as they are when it is called, less the return
+// address.
+void Simulator::callExternal(int external) {
+  simulation.externalCalls[externalNames[external]]++;
+  unsigned esp = regs[reg_esp];
+  auto argument = [&](int i) { return loadValue(esp + 4 * i, 4); };
+  switch (external) {
+    case ext_printf: {
+      std::string format = readString(argument(0));
+      std::string text;
+      int next = 1;
+      char buffer[32];
+      for (size_t i = 0; i < format.size(); i++) {
+        if (format[i] != '%' || i + 1 == format.size()) {
+          text += format[i];
+          continue;
+        }
+        char conversion = format[++i];
+        if (conversion == '%') {
+          text += '%';
+        } else if (conversion == 's') {
+          text += readString(argument(next++));
+        } else if (conversion == 'c') {
+          text += (char)argument(next++);
+        } else if (conversion == 'd' || conversion == 'u' || conversion == 'x') {
+          const char* spec =
+              conversion == 'd' ? "%d" : conversion == 'u' ? "%u" : "%x";
+          snprintf(buffer, sizeof(buffer), spec, argument(next++));
+          text += buffer;
+        } else {
+          error(current->lineno, std::string("printf conversion %") +
+                                     conversion + " is not simulated");
+        }
+      }
+      out << text;
+      regs[reg_eax] = text.size();
+      break;
+    }
+    case ext_malloc:
+    case ext_allocate:
+      regs[reg_eax] = allocate(argument(0));
+      break;
+    case ext_calloc:
+      regs[reg_eax] = allocate(argument(0) * argument(1));
+      break;
+    case ext_write: {
+      unsigned start = argument(1), length = argument(2);
+      std::string text;
+      for (unsigned i = 0; i < length; i++) text += *memory(start + i, 1);
+      (argument(0) == 2 ? std::cerr : out) << text;
+      regs[reg_eax] = length;
+      break;
+    }
+    default:
+      // free and the timers of --profile do nothing here.
+      break;
+  }
+}
+
+Simulation Simulator::run() {
+  for (int i = 0; i < 8; i++) regs[i] = 0;
+  zf = sf = of = cf = false;
+  regs[reg_esp] = STACK_TOP - 16;
+  regs[reg_ebp] = regs[reg_esp];
+
+  unsigned start = address("Main_main", 0);
+  if (start < CODE_BASE || start >= CODE_BASE + code.size())
+    error(0, "Main_main is not code");
+  size_t ip = start - CODE_BASE;
+  current = &code[ip];
+  counts = &methodCounts[current->method];
+  counts->calls++;
+  push(EXIT_ADDRESS);
+
+  long long steps = 0;
+  for (;;) {
+    if (ip >= code.size()) error(code.back().lineno, "ran past the end of the code");
+    const Decoded& in = code[ip];
+    current = &in;
+    counts = &methodCounts[in.method];
+    counts->instructions++;
+    if (++steps > options.stepLimit)
+      error(in.lineno, "more than " + std::to_string(options.stepLimit) +
+                           " instructions executed");
+
+    const std::vector<Operand>& ops = in.operands;
+    int size = in.size;
+    unsigned mask = size == 4 ? 0xffffffffu : 0xffu;
+    unsigned sign = size == 4 ? 0x80000000u : 0x80u;
+    unsigned target = 0;
+    bool jump = false;
+    size_t next = ip + 1;
+
+    switch (in.opcode) {
+      case in_push:
+        push(read(ops[0], 4));
+        break;
+      case in_pop:
+        write(ops[0], 4, pop());
+        break;
+      case in_mov:
+        write(ops[1], size, read(ops[0], size));
+        break;
+      case in_movzbl:
+        write(ops[1], 4, read(ops[0], 1));
+        break;
+      case in_add:
+      case in_sub:
+      case in_cmp: {
+        unsigned a = read(ops[1], size), b = read(ops[0], size);
+        unsigned result = in.opcode == in_add ? a + b : a - b;
+        setResultFlags(result, size);
+        if (in.opcode == in_add) {
+          cf = (result & mask) < (a & mask);
+          of = ~(a ^ b) & (a ^ result) & sign;
+        } else {
+          cf = (a & mask) < (b & mask);
+          of = (a ^ b) & (a ^ result) & sign;
+        }
+        if (in.opcode != in_cmp) write(ops[1], size, result);
+        break;
+      }
+      case in_and:
+      case in_or:
+      case in_xor: {
+        unsigned a = read(ops[1], size), b = read(ops[0], size);
+        unsigned result =
+            in.opcode == in_and ? a & b : in.opcode == in_or ? a | b : a ^ b;
+        setResultFlags(result, size);
+        cf = of = false;
+        write(ops[1], size, result);
+        break;
+      }
+      case in_imul: {
+        const Operand& source = ops.size() == 3 ? ops[1] : ops.back();
+        long long product =
+            (long long)(int)read(ops[0], 4) * (int)read(source, 4);
+        setResultFlags((unsigned)product, 4);
+        cf = of = product != (int)product;
+        write(ops.back(), 4, (unsigned)product);
+        break;
+      }
+      case in_idiv: {
+        int divisor = read(ops[0], 4);
+        long long dividend =
+            (long long)((unsigned long long)regs[reg_edx] << 32 | regs[reg_eax]);
+        if (divisor == 0)
+          error(in.lineno, "division by zero in " + methodNames[in.method]);
+        long long quotient = dividend / divisor;
+        if (quotient != (int)quotient)
+          error(in.lineno, "division overflow in " + methodNames[in.method]);
+        regs[reg_eax] = (unsigned)quotient;
+        regs[reg_edx] = (unsigned)(dividend % divisor);
+        break;
+      }
+      case in_neg: {
+        unsigned a = read(ops[0], size);
+        unsigned result = -a;
+        setResultFlags(result, size);
+        cf = (a & mask) != 0;
+        of = (a & mask) == sign;
+        write(ops[0], size, result);
+        break;
+      }
+      case in_not:
+        write(ops[0], size, ~read(ops[0], size));
+        break;
+      case in_cdq:
+        regs[reg_edx] = (int)regs[reg_eax] < 0 ? 0xffffffffu : 0;
+        break;
+      case in_setcc:
+        write(ops[0], 1, condition(in.condition));
+        break;
+      case in_jcc:
+        counts->branches++;
+        if (condition(in.condition)) {
+          counts->takenBranches++;
+          target = in.target;
+          jump = true;
+        }
+        break;
+      case in_jmp:
+        target = ops[0].indirect ? read(ops[0], 4) : in.target;
+        jump = true;
+        break;
+      case in_call:
+        target = ops[0].indirect ? read(ops[0], 4) : in.target;
+        if (target >= EXTERNAL_BASE && target < EXTERNAL_BASE + ext_count) {
+          callExternal(target - EXTERNAL_BASE);
+          break;
+        }
+        push(CODE_BASE + next);
+        jump = true;
+        if (target >= CODE_BASE && target < CODE_BASE + code.size())
+          methodCounts[code[target - CODE_BASE].method].calls++;
+        break;
+      case in_ret:
+        target = pop();
+        if (!ops.empty()) regs[reg_esp] += ops[0].value;
+        if (target == EXIT_ADDRESS) {
+          for (auto& method : methodCounts) {
+            simulation.total.instructions += method.instructions;
+            simulation.total.loads += method.loads;
+            simulation.total.stores += method.stores;
+            simulation.total.branches += method.branches;
+            simulation.total.takenBranches += method.takenBranches;
+            simulation.total.calls += method.calls;
+          }
+          for (size_t i = 0; i < methodNames.size(); i++)
+            if (methodCounts[i].instructions)
+              simulation.methods[methodNames[i]] = methodCounts[i];
+          return simulation;
+        }
+        jump = true;
+        break;
+      case in_leave:
+        regs[reg_esp] = regs[reg_ebp];
+        regs[reg_ebp] = pop();
+        break;
+    }
+
+    if (jump) {
+      if (target < CODE_BASE || target >= CODE_BASE + code.size()) {
+        char hex[16];
+        snprintf(hex, sizeof(hex), "0x%08x", target);
+        error(in.lineno, std::string("jump to ") + hex + " in " +
+                             methodNames[in.method]);
+      }
+      next = target - CODE_BASE;
+    }
+    ip = next;
+  }
+}
+
+Simulation simulate(const std::string& text, std::ostream& out,
+                    const SimulatorOptions& options) {
+  Simulator simulator(text, out, options);
+  return simulator.run();
+}
+
+void printSimulation(const Simulation& simulation, std::ostream& out) {
+  const ExecutionCounts& total = simulation.total;
+  char line[160];
+  out << "Instructions: " << total.instructions << std::endl;
+  out << "Loads:        " << total.loads << std::endl;
+  out << "Stores:       " << total.stores << std::endl;
+  out << "Branches:     " << total.branches << " (" << total.takenBranches
+      << " taken)" << std::endl;
+  out << "Calls:        " << total.calls << std::endl;
+  for (auto& call : simulation.externalCalls)
+    out << "  to " << call.first << ": " << call.second << std::endl;
+
+  std::vector<std::pair<std::string, ExecutionCounts> > methods(
+      simulation.methods.begin(), simulation.methods.end());
+  std::stable_sort(methods.begin(), methods.end(),
+                   [](const std::pair<std::string, ExecutionCounts>& a,
+                      const std::pair<std::string, ExecutionCounts>& b) {
+                     return a.second.instructions > b.second.instructions;
+                   });
+  out << std::endl;
+  snprintf(line, sizeof(line), "%14s %7s %12s %12s %12s %10s  %s",
+           "instructions", "%", "loads", "stores", "branches", "calls",
+           "method");
+  out << line << std::endl;
+  for (auto& method : methods) {
+    const ExecutionCounts& counts = method.second;
+    snprintf(line, sizeof(line), "%14lld %7.2f %12lld %12lld %12lld %10lld  %s",
+             counts.instructions,
+             100.0 * counts.instructions / std::max(1LL, total.instructions),
+             counts.loads, counts.stores, counts.branches, counts.calls,
+             method.first.c_str());
+    out << line << std::endl;
+  }
+}
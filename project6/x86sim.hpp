@@ -0,0 +1,55 @@
+#ifndef __X86SIM_HPP
+#define __X86SIM_HPP
+
+#include <iostream>
+#include <map>
+#include <string>
+
+// The simulator runs the assembly emitted by the CodeGenerator
+// without assembling it, counting what it executes. It covers the
+// instructions the CodeGenerator emits and the data directives of
+// the assembler (see x86asm.hpp), and stands in for the C library
+// functions the generated code calls: printf (%d, %s, %c, %u, %x),
+// malloc, calloc, free and write, and for the profiling runtime.
+// Programs start at Main_main and stop when it returns.
+//
+// Every run of the same assembly executes the same instructions, so
+// the counts can be compared between builds where timings cannot.
+// Errors (an unknown instruction, an access outside of memory, a
+// division by zero, running past the step limit) are reported on
+// stderr and exit.
+
+// Defines the counts of a method, or of a whole program. Loads and
+// stores include the stack accesses of push, pop, call and ret.
+typedef struct executioncounts {
+  long long instructions;
+  long long loads;
+  long long stores;
+  long long branches;       // conditional jumps
+  long long takenBranches;
+  long long calls;          // calls made to the method
+} ExecutionCounts;
+
+typedef struct simulation {
+  ExecutionCounts total;
+  // By the label of the method (or thunk, or memoized body) the
+  // instructions belong to.
+  std::map<std::string, ExecutionCounts> methods;
+  // Calls to the C library and the profiling runtime, by name.
+  std::map<std::string, long long> externalCalls;
+} Simulation;
+
+typedef struct simulatoroptions {
+  long long stepLimit;
+  int stackSize;
+} SimulatorOptions;
+
+// Runs assembly text, writing what the program prints to out.
+Simulation simulate(const std::string& text, std::ostream& out,
+                    const SimulatorOptions& options);
+
+// Prints the counts of a run, with the methods by the instructions
+// they executed.
+void printSimulation(const Simulation& simulation, std::ostream& out);
+
+#endif